@@ -0,0 +1,150 @@
+'use strict';
+
+// The data layout that every suite uses, and that native/bench.c reproduces byte for byte,
+// so that the native numbers are a baseline for the same B-trees.
+
+var path = require('path');
+var rimraf = require('rimraf');
+var mkdirp = require('mkdirp');
+
+var benchmark = require('benchmark');
+var lmdb = require('..');
+
+var benchDataPath = path.resolve(__dirname, './benchdata');
+var VALUE_SIZE = 32;
+var DUPS_PER_KEY = 16;
+
+// Keys are the hex strings of the big-endian doubles 0..count-1, stored as string keys (UTF-16 with a zero terminator)
+function makeKey(i) {
+  var key = Buffer.alloc(8);
+  key.writeDoubleBE(i);
+  return key.toString('hex');
+}
+
+// Values are filled by a xorshift32 generator seeded with the index, so that every run stores the same data
+function makeValue(i, size) {
+  var value = Buffer.alloc(size || VALUE_SIZE);
+  var x = (i + 1) >>> 0;
+  for (var j = 0; j < value.length; j++) {
+    x ^= x << 13; x >>>= 0;
+    x ^= x >>> 17;
+    x ^= x << 5; x >>>= 0;
+    value[j] = x & 0xff;
+  }
+  return value;
+}
+
+function cleanup() {
+  rimraf.sync(benchDataPath);
+  return mkdirp(benchDataPath);
+}
+
+function openEnv(options) {
+  var env = new lmdb.Env();
+  env.open(Object.assign({
+    path: benchDataPath,
+    maxDbs: 10,
+    maxReaders: 126,
+    mapSize: 16 * 1024 * 1024 * 1024
+  }, options));
+  return env;
+}
+
+// Fills the 'strings', 'binary' and 'uint32' DBs with the same values under the three key types, and the 'dups' DB
+function fill(env, count) {
+  var dbis = {
+    strings: env.openDbi({ name: 'strings', create: true }),
+    binary: env.openDbi({ name: 'binary', create: true, keyIsBuffer: true }),
+    uint32: env.openDbi({ name: 'uint32', create: true, keyIsUint32: true }),
+    dups: env.openDbi({ name: 'dups', create: true, dupSort: true, dupFixed: true, keyIsUint32: true })
+  };
+  var keys = [];
+  var binaryKeys = [];
+  var txn = env.beginTxn();
+  for (var i = 0; i < count; i++) {
+    var key = makeKey(i);
+    var value = makeValue(i);
+    keys.push(key);
+    binaryKeys.push(Buffer.from(key, 'hex'));
+    txn.putBinary(dbis.strings, key, value);
+    txn.putBinary(dbis.binary, binaryKeys[i], value);
+    txn.putBinary(dbis.uint32, i, value);
+  }
+  var dupKeys = Math.ceil(count / DUPS_PER_KEY);
+  for (var i = 0; i < dupKeys; i++) {
+    for (var j = 0; j < DUPS_PER_KEY; j++) {
+      txn.putBinary(dbis.dups, i, makeValue(i * DUPS_PER_KEY + j, 8));
+    }
+  }
+  txn.commit();
+  return { dbis: dbis, keys: keys, binaryKeys: binaryKeys, dupKeys: dupKeys };
+}
+
+// Cycles through the keys in a scattered order, so that reads don't just walk the pages in order
+function indexes(count) {
+  var i = 0;
+  return function() {
+    i = (i + 7919) % count;
+    return i;
+  };
+}
+
+// Runs cases with benchmark.js and resolves with their results. Each case is
+// { name, fn, defer, ops }, where ops is the number of operations of a call, and fn takes
+// the deferred of benchmark.js when defer is set. hooks.before runs before each case and hooks.after after it.
+function measure(suiteName, cases, hooks) {
+  hooks = hooks || {};
+  return new Promise(function(resolve, reject) {
+    var suite = new benchmark.Suite(suiteName);
+    var results = [];
+    var opsPerCall = {};
+    cases.forEach(function(benchCase) {
+      opsPerCall[benchCase.name] = benchCase.ops || 1;
+      suite.add(benchCase.name, benchCase.fn, {
+        defer: !!benchCase.defer,
+        onStart: hooks.before,
+        onComplete: hooks.after
+      });
+    });
+    suite.on('cycle', function(event) {
+      var target = event.target;
+      var ops = opsPerCall[target.name];
+      console.log(suiteName + ': ' + String(target) + (ops > 1 ? ' (' + ops + ' ops per call)' : ''));
+      results.push(result(suiteName, target.name, target.hz * ops, {
+        rme: target.stats.rme,
+        samples: target.stats.sample.length,
+        opsPerCall: ops
+      }));
+    });
+    suite.on('error', function(event) {
+      reject(event.target.error);
+    });
+    suite.on('complete', function() {
+      resolve(results);
+    });
+    suite.run({ async: true });
+  });
+}
+
+// A result as it appears in the JSON output
+function result(suiteName, name, opsPerSec, extra) {
+  return Object.assign({
+    suite: suiteName,
+    name: name,
+    opsPerSec: opsPerSec
+  }, extra);
+}
+
+module.exports = {
+  benchDataPath: benchDataPath,
+  VALUE_SIZE: VALUE_SIZE,
+  DUPS_PER_KEY: DUPS_PER_KEY,
+  makeKey: makeKey,
+  makeValue: makeValue,
+  cleanup: cleanup,
+  openEnv: openEnv,
+  fill: fill,
+  indexes: indexes,
+  measure: measure,
+  result: result
+};
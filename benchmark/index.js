@@ -1,115 +1,132 @@
 'use strict';
 
-var crypto = require('crypto');
+// Runs the benchmark suite. Usage:
+//
+//   node benchmark [--suites reads,cursors,dupsort,writes,batch,threads,mixed,latency] [--count 1000000]
+//                  [--threads <CPUs>] [--duration 2000] [--no-sync] [--native] [--json results.json]
+//                  [--map-populate] [--huge-pages] [--lock-branch-pages]
+//
+// --native also runs the baseline in benchmark/native (build it first with `make -C benchmark/native`),
+// and --json writes every result to a file, to compare the results of two builds.
+// --map-populate, --huge-pages and --lock-branch-pages open the environment with the options of the
+// memory map of the same names, the latency suite shows their effect on random reads.
+
+var fs = require('fs');
+var os = require('os');
 var path = require('path');
-var testDirPath = path.resolve(__dirname, './benchdata');
-
-var rimraf = require('rimraf');
-var mkdirp = require('mkdirp');
-var benchmark = require('benchmark');
-var suite = new benchmark.Suite();
+var execFileSync = require('child_process').execFileSync;
 
 var lmdb = require('..');
-
-var env;
-var dbi;
-var keys = [];
-var total = 1000000;
-
-function cleanup(done) {
-  // cleanup previous test directory
-  rimraf(testDirPath, function(err) {
-    if (err) {
-      return done(err);
+var common = require('./common');
+
+var allSuites = ['reads', 'cursors', 'dupsort', 'writes', 'batch', 'threads', 'mixed', 'latency'];
+
+function parseArgs(argv) {
+  var args = {
+    suites: allSuites,
+    count: 1000000,
+    threads: os.cpus().length,
+    duration: 2000,
+    sync: true,
+    native: false,
+    json: null,
+    mapPopulate: false,
+    hugePages: false,
+    lockBranchPages: false
+  };
+  for (var i = 0; i < argv.length; i++) {
+    switch (argv[i]) {
+      case '--suites': args.suites = argv[++i].split(','); break;
+      case '--count': args.count = parseInt(argv[++i], 10); break;
+      case '--threads': args.threads = parseInt(argv[++i], 10); break;
+      case '--duration': args.duration = parseInt(argv[++i], 10); break;
+      case '--no-sync': args.sync = false; break;
+      case '--native': args.native = true; break;
+      case '--json': args.json = argv[++i]; break;
+      case '--map-populate': args.mapPopulate = true; break;
+      case '--huge-pages': args.hugePages = true; break;
+      case '--lock-branch-pages': args.lockBranchPages = true; break;
+      default: throw new Error('Unknown argument ' + argv[i]);
     }
-    // setup clean directory
-    mkdirp(testDirPath).then(() => {
-      done();
-    }, error => done(error));
-  });
-}
-
-function setup() {
-  env = new lmdb.Env();
-  env.open({
-    path: testDirPath,
-    maxDbs: 10,
-    mapSize: 16 * 1024 * 1024 * 1024
-  });
-  dbi = env.openDbi({
-    name: 'benchmarks',
-    create: true
-  });
-
-  var txn = env.beginTxn();
-  var c = 0;
-  while(c < total) {
-    var key = new Buffer(new Array(8));
-    key.writeDoubleBE(c);
-    keys.push(key.toString('hex'));
-    txn.putBinary(dbi, key.toString('hex'), crypto.randomBytes(32));
-    c++;
   }
-  txn.commit();
+  args.suites.forEach(function(name) {
+    if (allSuites.indexOf(name) < 0) {
+      throw new Error('Unknown suite ' + name + ', the suites are ' + allSuites.join(', '));
+    }
+  });
+  return args;
 }
 
-var txn;
-var c = 0;
-
-function getIndex() {
-  if (c < total - 1) {
-    c++;
-  } else {
-    c = 0;
+function runNative(args) {
+  var binary = path.resolve(__dirname, 'native/lmdb-bench');
+  if (!fs.existsSync(binary)) {
+    throw new Error('The native baseline isn\'t built, run make -C benchmark/native');
   }
-  return c;
-}
-
-function getBinary() {
-  var data = txn.getBinary(dbi, keys[getIndex()]);
-}
-
-function getBinaryUnsafe() {
-  var data = txn.getBinaryUnsafe(dbi, keys[getIndex()]);
+  console.log('native: filling and measuring...');
+  var output = execFileSync(binary, [
+    common.benchDataPath, String(args.count), String(args.duration)
+  ].concat(args.sync ? [] : ['nosync']), { encoding: 'utf8' });
+  var results = JSON.parse(output);
+  results.forEach(function(result) {
+    console.log('native: ' + result.name + ' x ' + Math.round(result.opsPerSec).toLocaleString() + ' ops/sec');
+  });
+  return results;
 }
 
-function getString() {
-  var data = txn.getString(dbi, keys[getIndex()]);
-}
+var args = parseArgs(process.argv.slice(2));
+var results = [];
 
-function getStringUnsafe() {
-  var data = txn.getStringUnsafe(dbi, keys[getIndex()]);
-}
-
-cleanup(function(err) {
-  if (err) {
-    throw err;
+common.cleanup().then(function() {
+  if (args.native) {
+    results = results.concat(runNative(args));
+    return common.cleanup();
   }
-
-  setup();
-
-  suite.add('getBinary', getBinary);
-  suite.add('getBinaryUnsafe', getBinaryUnsafe);
-  suite.add('getString', getString);
-  suite.add('getStringUnsafe', getStringUnsafe);
-
-  suite.on('start', function() {
-    txn = env.beginTxn();
-  });
-
-  suite.on('cycle', function(event) {
-    txn.abort();
-    txn = env.beginTxn();
-    console.log(String(event.target));
+}).then(function() {
+  var env = common.openEnv({
+    noSync: !args.sync,
+    mapPopulate: args.mapPopulate,
+    hugePages: args.hugePages,
+    lockBranchPages: args.lockBranchPages
   });
-
-  suite.on('complete', function () {
-    txn.abort();
-    dbi.close();
+  console.log('Filling ' + args.count + ' entries...');
+  var ctx = {
+    env: env,
+    data: common.fill(env, args.count),
+    count: args.count,
+    threads: args.threads,
+    duration: args.duration
+  };
+
+  return args.suites.reduce(function(previous, name) {
+    return previous.then(function() {
+      return require('./suites/' + name)(ctx);
+    }).then(function(suiteResults) {
+      results = results.concat(suiteResults);
+    });
+  }, Promise.resolve()).then(function() {
+    Object.keys(ctx.data.dbis).forEach(function(name) {
+      ctx.data.dbis[name].close();
+    });
     env.close();
-    console.log('Fastest is ' + this.filter('fastest').map('name'));
   });
-
-  suite.run();
-
+}).then(function() {
+  if (args.json) {
+    fs.writeFileSync(args.json, JSON.stringify({
+      date: new Date().toISOString(),
+      node: process.version,
+      lmdb: lmdb.version,
+      platform: process.platform + ' ' + process.arch,
+      cpus: os.cpus().length,
+      count: args.count,
+      sync: args.sync,
+      mapPopulate: args.mapPopulate,
+      hugePages: args.hugePages,
+      lockBranchPages: args.lockBranchPages,
+      results: results
+    }, null, 2));
+    console.log('Wrote ' + results.length + ' results to ' + args.json);
+  }
+}).catch(function(error) {
+  console.error(error);
+  process.exitCode = 1;
 });
@@ -0,0 +1,324 @@
+/* bench.c - baseline for the benchmark suite of node-lmdb
+ *
+ * Fills an environment with the data layout of benchmark/common.js and
+ * measures the same operations as the JS suites directly with liblmdb,
+ * which is what the binding can be compared against.
+ *
+ * Usage: lmdb-bench <directory> <count> <milliseconds per case>
+ * Prints the results as a JSON array on stdout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "lmdb.h"
+
+#define VALUE_SIZE	32
+#define DUPS_PER_KEY	16
+#define SCAN_LENGTH	1000
+#define TXN_SIZE	1000
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+/* Same as makeKey: the hex string of the big-endian double, as UTF-16 with a zero terminator */
+#define KEY_CHARS	16
+typedef struct { uint16_t c[KEY_CHARS + 1]; } string_key;
+
+static MDB_env *env;
+static MDB_dbi strings, binary, uint32, dups;
+static string_key *keys;
+static unsigned char (*binaryKeys)[8];
+static unsigned int count, dupKeys;
+static double duration;
+static int first = 1;
+
+static void make_key(unsigned int i, string_key *key, unsigned char *bin)
+{
+	static const char hex[] = "0123456789abcdef";
+	union { double d; uint64_t u; } v;
+	int j;
+	v.d = i;
+	for (j = 0; j < 8; j++) {
+		bin[j] = (unsigned char)(v.u >> (56 - j * 8));
+		key->c[j * 2] = hex[bin[j] >> 4];
+		key->c[j * 2 + 1] = hex[bin[j] & 15];
+	}
+	key->c[KEY_CHARS] = 0;
+}
+
+/* Same as makeValue: xorshift32 seeded with the index */
+static void make_value(unsigned int i, unsigned char *value, size_t size)
+{
+	uint32_t x = i + 1;
+	size_t j;
+	for (j = 0; j < size; j++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		value[j] = x & 0xff;
+	}
+}
+
+/* Same as indexes */
+static unsigned int next_index(unsigned int *i, unsigned int n)
+{
+	*i = (*i + 7919) % n;
+	return *i;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *suite, const char *name, double ops, double seconds)
+{
+	printf("%s\n  { \"suite\": \"%s\", \"name\": \"%s\", \"opsPerSec\": %.1f }",
+		first ? "[" : ",", suite, name, ops / seconds);
+	first = 0;
+}
+
+static void fill(void)
+{
+	MDB_txn *txn;
+	MDB_val key, data;
+	unsigned char value[VALUE_SIZE], dup[8];
+	unsigned int i, j, k;
+	int rc;
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, "strings", MDB_CREATE, &strings));
+	E(mdb_dbi_open(txn, "binary", MDB_CREATE, &binary));
+	E(mdb_dbi_open(txn, "uint32", MDB_CREATE|MDB_INTEGERKEY, &uint32));
+	E(mdb_dbi_open(txn, "dups", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERKEY, &dups));
+	for (i = 0; i < count; i++) {
+		make_key(i, &keys[i], binaryKeys[i]);
+		make_value(i, value, VALUE_SIZE);
+		data.mv_size = VALUE_SIZE;
+		data.mv_data = value;
+		key.mv_size = sizeof(string_key);
+		key.mv_data = &keys[i];
+		E(mdb_put(txn, strings, &key, &data, 0));
+		key.mv_size = 8;
+		key.mv_data = binaryKeys[i];
+		E(mdb_put(txn, binary, &key, &data, 0));
+		key.mv_size = sizeof(uint32_t);
+		key.mv_data = &i;
+		E(mdb_put(txn, uint32, &key, &data, 0));
+	}
+	for (k = 0; k < dupKeys; k++) {
+		for (j = 0; j < DUPS_PER_KEY; j++) {
+			make_value(k * DUPS_PER_KEY + j, dup, 8);
+			key.mv_size = sizeof(uint32_t);
+			key.mv_data = &k;
+			data.mv_size = 8;
+			data.mv_data = dup;
+			E(mdb_put(txn, dups, &key, &data, 0));
+		}
+	}
+	E(mdb_txn_commit(txn));
+}
+
+static void reads(void)
+{
+	MDB_txn *txn;
+	MDB_val key, data;
+	unsigned int i = 0, n, idx;
+	double start, ops;
+	int rc;
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < 10000; n++) {
+			key.mv_size = sizeof(string_key);
+			key.mv_data = &keys[next_index(&i, count)];
+			E(mdb_get(txn, strings, &key, &data));
+		}
+		ops += n;
+	}
+	report("native", "getBinary (string key)", ops, now() - start);
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < 10000; n++) {
+			key.mv_size = 8;
+			key.mv_data = binaryKeys[next_index(&i, count)];
+			E(mdb_get(txn, binary, &key, &data));
+		}
+		ops += n;
+	}
+	report("native", "getBinary (buffer key)", ops, now() - start);
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < 10000; n++) {
+			idx = next_index(&i, count);
+			key.mv_size = sizeof(uint32_t);
+			key.mv_data = &idx;
+			E(mdb_get(txn, uint32, &key, &data));
+		}
+		ops += n;
+	}
+	report("native", "getBinary (uint32 key)", ops, now() - start);
+
+	mdb_txn_abort(txn);
+}
+
+static void cursors(void)
+{
+	MDB_txn *txn;
+	MDB_cursor *cursor;
+	MDB_val key, data;
+	unsigned int i = 0, n;
+	double start, ops;
+	int rc;
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	E(mdb_cursor_open(txn, strings, &cursor));
+
+	E(mdb_cursor_get(cursor, &key, &data, MDB_FIRST));
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < SCAN_LENGTH; n++) {
+			if (mdb_cursor_get(cursor, &key, &data, MDB_NEXT) == MDB_NOTFOUND)
+				E(mdb_cursor_get(cursor, &key, &data, MDB_FIRST));
+		}
+		ops += n;
+	}
+	report("native", "scan forward, getCurrentBinaryUnsafe", ops, now() - start);
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < 10000; n++) {
+			key.mv_size = sizeof(string_key);
+			key.mv_data = &keys[next_index(&i, count)];
+			E(mdb_cursor_get(cursor, &key, &data, MDB_SET_KEY));
+		}
+		ops += n;
+	}
+	report("native", "goToKey", ops, now() - start);
+
+	mdb_cursor_close(cursor);
+	mdb_txn_abort(txn);
+}
+
+static void dupsort(void)
+{
+	MDB_txn *txn;
+	MDB_cursor *cursor;
+	MDB_val key, data;
+	unsigned int i = 0, n, k;
+	double start, ops;
+	int rc;
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	E(mdb_cursor_open(txn, dups, &cursor));
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		for (n = 0; n < 1000; n++) {
+			k = next_index(&i, dupKeys);
+			key.mv_size = sizeof(uint32_t);
+			key.mv_data = &k;
+			E(mdb_cursor_get(cursor, &key, &data, MDB_SET_KEY));
+			do {
+				ops++;
+			} while (mdb_cursor_get(cursor, &key, &data, MDB_NEXT_DUP) == MDB_SUCCESS);
+		}
+	}
+	report("native", "goToKey + all dups", ops, now() - start);
+
+	mdb_cursor_close(cursor);
+	mdb_txn_abort(txn);
+}
+
+static void writes(void)
+{
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_val key, data;
+	unsigned char value[VALUE_SIZE];
+	unsigned int i = 0, n;
+	double start, ops;
+	int rc;
+
+	make_value(0, value, VALUE_SIZE);
+	data.mv_size = VALUE_SIZE;
+	data.mv_data = value;
+	key.mv_size = sizeof(string_key);
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, "writes", MDB_CREATE, &dbi));
+	E(mdb_txn_commit(txn));
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		E(mdb_txn_begin(env, NULL, 0, &txn));
+		for (n = 0; n < TXN_SIZE; n++) {
+			key.mv_data = &keys[next_index(&i, count)];
+			E(mdb_put(txn, dbi, &key, &data, 0));
+		}
+		E(mdb_txn_commit(txn));
+		ops += n;
+	}
+	report("native", "putBinary x1000 in one txn (scattered keys)", ops, now() - start);
+
+	start = now(), ops = 0;
+	while (now() - start < duration) {
+		E(mdb_txn_begin(env, NULL, 0, &txn));
+		key.mv_data = &keys[next_index(&i, count)];
+		E(mdb_put(txn, dbi, &key, &data, 0));
+		E(mdb_txn_commit(txn));
+		ops++;
+	}
+	report("native", "putBinary in its own txn", ops, now() - start);
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	unsigned int flags = 0;
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <directory> <count> <milliseconds per case> [nosync]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	count = (unsigned int)strtoul(argv[2], NULL, 10);
+	duration = strtod(argv[3], NULL) / 1000;
+	dupKeys = (count + DUPS_PER_KEY - 1) / DUPS_PER_KEY;
+	if (argc > 4 && !strcmp(argv[4], "nosync"))
+		flags |= MDB_NOSYNC;
+
+	keys = malloc(count * sizeof(string_key));
+	binaryKeys = malloc(count * 8);
+	if (!keys || !binaryKeys) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	mkdir(argv[1], 0775);
+	E(mdb_env_create(&env));
+	E(mdb_env_set_maxdbs(env, 10));
+	E(mdb_env_set_mapsize(env, (size_t)16 * 1024 * 1024 * 1024));
+	E(mdb_env_open(env, argv[1], flags, 0664));
+
+	fill();
+	reads();
+	cursors();
+	dupsort();
+	writes();
+	printf("\n]\n");
+
+	mdb_env_close(env);
+	free(keys);
+	free(binaryKeys);
+	return EXIT_SUCCESS;
+}
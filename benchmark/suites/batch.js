@@ -0,0 +1,49 @@
+'use strict';
+
+// env.batchWrite with and without conditions
+
+var common = require('../common');
+
+var BATCH_SIZE = 1000;
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var keys = ctx.data.keys;
+  var dbi = env.openDbi({ name: 'batch', create: true });
+  var next = common.indexes(ctx.count);
+
+  // Every key starts with the value of the data layout, so that the conditions match
+  var txn = env.beginTxn();
+  for (var i = 0; i < ctx.count; i++) {
+    txn.putBinary(dbi, keys[i], common.makeValue(i));
+  }
+  txn.commit();
+
+  function batch(conditional) {
+    var operations = [];
+    for (var i = 0; i < BATCH_SIZE; i++) {
+      var index = next();
+      var value = common.makeValue(index);
+      operations.push(conditional ? [dbi, keys[index], value, value] : [dbi, keys[index], value]);
+    }
+    return operations;
+  }
+  function run(operations) {
+    return function(deferred) {
+      env.batchWrite(operations, { keyIsString: true }, function(error) {
+        if (error) {
+          throw error;
+        }
+        deferred.resolve();
+      });
+    };
+  }
+
+  return common.measure('batch', [
+    { name: 'batchWrite x' + BATCH_SIZE, ops: BATCH_SIZE, defer: true, fn: run(batch(false)) },
+    { name: 'batchWrite x' + BATCH_SIZE + ' with conditions', ops: BATCH_SIZE, defer: true, fn: run(batch(true)) }
+  ]).then(function(results) {
+    dbi.close();
+    return results;
+  });
+};
@@ -0,0 +1,56 @@
+'use strict';
+
+// Cursor scans and seeks
+
+var lmdb = require('../..');
+var common = require('../common');
+
+var SCAN_LENGTH = 1000;
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var dbis = ctx.data.dbis;
+  var keys = ctx.data.keys;
+  var next = common.indexes(ctx.count);
+  var txn;
+  var cursor;
+
+  // Reads SCAN_LENGTH entries from where the cursor is, wrapping around at the end
+  function scan(move, restart, getter) {
+    return function() {
+      for (var i = 0; i < SCAN_LENGTH; i++) {
+        if (cursor[move]() === null) {
+          cursor[restart]();
+        }
+        cursor[getter]();
+      }
+    };
+  }
+
+  function open(dbi) {
+    return function() {
+      txn = env.beginTxn({ readOnly: true });
+      cursor = new lmdb.Cursor(txn, dbi);
+      cursor.goToFirst();
+    };
+  }
+  function close() {
+    cursor.close();
+    txn.abort();
+  }
+
+  return common.measure('cursors', [
+    { name: 'scan forward, getCurrentBinaryUnsafe', ops: SCAN_LENGTH, fn: scan('goToNext', 'goToFirst', 'getCurrentBinaryUnsafe') },
+    { name: 'scan forward, getCurrentBinary', ops: SCAN_LENGTH, fn: scan('goToNext', 'goToFirst', 'getCurrentBinary') },
+    { name: 'scan backward, getCurrentBinaryUnsafe', ops: SCAN_LENGTH, fn: scan('goToPrev', 'goToLast', 'getCurrentBinaryUnsafe') },
+    { name: 'goToKey', fn: function() {
+      cursor.goToKey(keys[next()]);
+    } },
+    { name: 'goToRange', fn: function() {
+      cursor.goToRange(keys[next()].substring(0, 12));
+    } }
+  ], {
+    before: open(dbis.strings),
+    after: close
+  });
+};
@@ -0,0 +1,58 @@
+'use strict';
+
+// Operations on a dupSort DB, with DUPS_PER_KEY values of 8 bytes under each uint32 key
+
+var lmdb = require('../..');
+var common = require('../common');
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var dbi = ctx.data.dbis.dups;
+  var dupKeys = ctx.data.dupKeys;
+  var next = common.indexes(dupKeys);
+  var txn;
+  var cursor;
+
+  function open(readOnly) {
+    return function() {
+      txn = env.beginTxn({ readOnly: readOnly });
+      cursor = new lmdb.Cursor(txn, dbi);
+    };
+  }
+  function close() {
+    cursor.close();
+    // The writes are rolled back, so that every case sees the same data
+    txn.abort();
+  }
+
+  var read = { before: open(true), after: close };
+  var write = { before: open(false), after: close };
+  return common.measure('dupsort', [
+    { name: 'goToKey + all dups', ops: common.DUPS_PER_KEY, fn: function() {
+      cursor.goToKey(next());
+      for (var k = cursor.goToFirstDup(); k !== null; k = cursor.goToNextDup()) {
+        cursor.getCurrentBinaryUnsafe();
+      }
+    } },
+    { name: 'goToDup', fn: function() {
+      var key = next();
+      cursor.goToDup(key, common.makeValue(key * common.DUPS_PER_KEY + 3, 8));
+    } },
+    { name: 'countDups', fn: function() {
+      cursor.goToKey(next());
+      cursor.countDups();
+    } }
+  ], read).then(function(results) {
+    var value = Buffer.alloc(8);
+    return common.measure('dupsort', [
+      { name: 'putBinary dup + del dup', ops: 2, fn: function() {
+        var key = next();
+        value.writeUInt32BE(key, 0);
+        txn.putBinary(dbi, key, value);
+        txn.del(dbi, key, value, {});
+      } }
+    ], write).then(function(writeResults) {
+      return results.concat(writeResults);
+    });
+  });
+};
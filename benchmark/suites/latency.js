@@ -0,0 +1,65 @@
+'use strict';
+
+// The latency of random point reads, as percentiles, to compare the options of the memory map
+// (--map-populate, --huge-pages, --lock-branch-pages) between runs
+
+var common = require('../common');
+
+var PERCENTILES = [50, 90, 99, 99.9];
+// Reads between two clock readings, so that the clock doesn't dominate the short ones
+var READS_PER_SAMPLE = 16;
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  // Opened again now that they're filled, so that lockBranchPages locks their branch pages
+  var dbis = {
+    strings: env.openDbi({ name: 'strings' }),
+    uint32: env.openDbi({ name: 'uint32', keyIsUint32: true })
+  };
+  var keys = ctx.data.keys;
+  var next = common.indexes(ctx.count);
+
+  var cases = [
+    { name: 'getBinaryUnsafe (string key)', read: function(txn) {
+      txn.getBinaryUnsafe(dbis.strings, keys[next()]);
+    } },
+    { name: 'getBinaryUnsafe (uint32 key)', read: function(txn) {
+      txn.getBinaryUnsafe(dbis.uint32, next());
+    } }
+  ];
+
+  var results = cases.map(function(benchCase) {
+    var samples = [];
+    var txn = env.beginTxn({ readOnly: true });
+    var start = process.hrtime.bigint();
+    var end = start + BigInt(ctx.duration) * 1000000n;
+    var now = start;
+    while (now < end) {
+      for (var i = 0; i < READS_PER_SAMPLE; i++) {
+        benchCase.read(txn);
+      }
+      var then = process.hrtime.bigint();
+      samples.push(Number(then - now) / READS_PER_SAMPLE / 1000);
+      now = then;
+    }
+    txn.abort();
+
+    samples.sort(function(a, b) {
+      return a - b;
+    });
+    var percentiles = {};
+    PERCENTILES.forEach(function(p) {
+      percentiles['p' + p] = samples[Math.min(samples.length - 1, Math.floor(samples.length * p / 100))];
+    });
+    var opsPerSec = samples.length * READS_PER_SAMPLE * 1e9 / Number(now - start);
+    console.log('latency: ' + benchCase.name + ' x ' + Math.round(opsPerSec).toLocaleString() + ' ops/sec, ' +
+      PERCENTILES.map(function(p) {
+        return 'p' + p + ' ' + percentiles['p' + p].toFixed(2) + ' µs';
+      }).join(', '));
+    return common.result('latency', benchCase.name, opsPerSec, Object.assign({ unit: 'µs' }, percentiles));
+  });
+
+  var info = env.info();
+  console.log('latency: ' + info.lockedPages + ' pages locked');
+  return Promise.resolve(results);
+};
@@ -0,0 +1,44 @@
+'use strict';
+
+// Reader threads while the main thread writes, to see how much they slow each other down
+
+var common = require('../common');
+var runReaders = require('./threads').runReaders;
+
+var TXN_SIZE = 100;
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var dbi = ctx.data.dbis.strings;
+  var keys = ctx.data.keys;
+  var next = common.indexes(ctx.count);
+  var readers = Math.max(1, Math.floor(ctx.threads / 2));
+
+  // Overwrites existing keys with their own values, in transactions of TXN_SIZE puts
+  function write(duration) {
+    var writes = 0;
+    var start = Date.now();
+    var end = start + duration;
+    while (Date.now() < end) {
+      var txn = env.beginTxn();
+      for (var i = 0; i < TXN_SIZE; i++) {
+        var index = next();
+        txn.putBinary(dbi, keys[index], common.makeValue(index));
+      }
+      txn.commit();
+      writes += TXN_SIZE;
+    }
+    return writes * 1000 / (Date.now() - start);
+  }
+
+  return runReaders(ctx, readers, ctx.duration, write).then(function(measured) {
+    var readName = 'getBinaryUnsafe on ' + readers + ' thread' + (readers > 1 ? 's' : '') + ' while writing';
+    var writeName = 'putBinary x' + TXN_SIZE + ' per txn while ' + readers + ' thread' + (readers > 1 ? 's' : '') + ' read';
+    console.log('mixed: ' + readName + ' x ' + Math.round(measured.opsPerSec).toLocaleString() + ' ops/sec');
+    console.log('mixed: ' + writeName + ' x ' + Math.round(measured.during).toLocaleString() + ' ops/sec');
+    return [
+      common.result('mixed', readName, measured.opsPerSec, { threads: readers }),
+      common.result('mixed', writeName, measured.during, { threads: readers })
+    ];
+  });
+};
@@ -0,0 +1,49 @@
+'use strict';
+
+// Point reads: each key type, and the copying getters against the zero-copy (unsafe) ones
+
+var common = require('../common');
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var dbis = ctx.data.dbis;
+  var keys = ctx.data.keys;
+  var binaryKeys = ctx.data.binaryKeys;
+  var next = common.indexes(ctx.count);
+  var txn;
+
+  return common.measure('reads', [
+    { name: 'getBinary (string key)', fn: function() {
+      txn.getBinary(dbis.strings, keys[next()]);
+    } },
+    { name: 'getBinary (buffer key)', fn: function() {
+      txn.getBinary(dbis.binary, binaryKeys[next()]);
+    } },
+    { name: 'getBinary (uint32 key)', fn: function() {
+      txn.getBinary(dbis.uint32, next());
+    } },
+    { name: 'getBinaryUnsafe (string key)', fn: function() {
+      txn.getBinaryUnsafe(dbis.strings, keys[next()]);
+    } },
+    { name: 'getBinaryUnsafe (uint32 key)', fn: function() {
+      txn.getBinaryUnsafe(dbis.uint32, next());
+    } },
+    { name: 'getString (string key)', fn: function() {
+      txn.getString(dbis.strings, keys[next()]);
+    } },
+    { name: 'getStringUnsafe (string key)', fn: function() {
+      txn.getStringUnsafe(dbis.strings, keys[next()]);
+    } },
+    { name: 'getBinary (missing key)', fn: function() {
+      txn.getBinary(dbis.uint32, ctx.count + next());
+    } }
+  ], {
+    // A fresh read transaction per case, so that no case reads through a stale snapshot
+    before: function() {
+      txn = env.beginTxn({ readOnly: true });
+    },
+    after: function() {
+      txn.abort();
+    }
+  });
+};
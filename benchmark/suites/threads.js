@@ -0,0 +1,65 @@
+'use strict';
+
+// Point reads on a growing number of reader threads, which attach to the environment with env.share
+
+var path = require('path');
+var Worker = require('worker_threads').Worker;
+var common = require('../common');
+
+// Starts the reader threads, lets them read for duration ms, calls during() meanwhile,
+// and resolves with the total number of reads per second
+function runReaders(ctx, threads, duration, during) {
+  var handle = ctx.env.share([ctx.data.dbis.strings]);
+  var workers = [];
+  for (var i = 0; i < threads; i++) {
+    workers.push(new Worker(path.resolve(__dirname, '../worker.js'), {
+      workerData: { handle: handle, count: ctx.count }
+    }));
+  }
+
+  var ready = workers.map(function(worker) {
+    return new Promise(function(resolve, reject) {
+      worker.once('message', resolve);
+      worker.once('error', reject);
+    });
+  });
+  return Promise.all(ready).then(function() {
+    var done = workers.map(function(worker) {
+      return new Promise(function(resolve, reject) {
+        worker.once('message', resolve);
+        worker.once('error', reject);
+        worker.postMessage(duration);
+      });
+    });
+    return Promise.all([Promise.all(done), during ? during(duration) : null]);
+  }).then(function(results) {
+    var opsPerSec = 0;
+    results[0].forEach(function(result) {
+      opsPerSec += result.reads * 1000 / result.ms;
+    });
+    return { opsPerSec: opsPerSec, during: results[1] };
+  });
+}
+
+module.exports = function(ctx) {
+  var threadCounts = [];
+  for (var threads = 1; threads < ctx.threads; threads *= 2) {
+    threadCounts.push(threads);
+  }
+  threadCounts.push(ctx.threads);
+
+  var results = [];
+  return threadCounts.reduce(function(previous, threads) {
+    return previous.then(function() {
+      return runReaders(ctx, threads, ctx.duration);
+    }).then(function(measured) {
+      var name = 'getBinaryUnsafe on ' + threads + ' thread' + (threads > 1 ? 's' : '');
+      console.log('threads: ' + name + ' x ' + Math.round(measured.opsPerSec).toLocaleString() + ' ops/sec');
+      results.push(common.result('threads', name, measured.opsPerSec, { threads: threads }));
+    });
+  }, Promise.resolve()).then(function() {
+    return results;
+  });
+};
+
+module.exports.runReaders = runReaders;
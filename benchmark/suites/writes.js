@@ -0,0 +1,63 @@
+'use strict';
+
+// Puts in one big transaction against a transaction per put.
+// Commits are synced to the disk unless the runner is started with --no-sync.
+
+var common = require('../common');
+
+var TXN_SIZE = 1000;
+
+module.exports = function(ctx) {
+  var env = ctx.env;
+  var keys = ctx.data.keys;
+  var next = common.indexes(ctx.count);
+  var value = common.makeValue(0);
+  var sequence = 0;
+  var dbi = env.openDbi({ name: 'writes', create: true });
+  var uint32Dbi = env.openDbi({ name: 'writesUint32', create: true, keyIsUint32: true });
+
+  return common.measure('writes', [
+    { name: 'putBinary x' + TXN_SIZE + ' in one txn (scattered keys)', ops: TXN_SIZE, fn: function() {
+      var txn = env.beginTxn();
+      for (var i = 0; i < TXN_SIZE; i++) {
+        txn.putBinary(dbi, keys[next()], value);
+      }
+      txn.commit();
+    } },
+    { name: 'putBinary x' + TXN_SIZE + ' in one txn (appended uint32 keys)', ops: TXN_SIZE, fn: function() {
+      var txn = env.beginTxn();
+      for (var i = 0; i < TXN_SIZE; i++) {
+        txn.putBinary(uint32Dbi, sequence++, value);
+      }
+      txn.commit();
+    } },
+    { name: 'putString x' + TXN_SIZE + ' in one txn (scattered keys)', ops: TXN_SIZE, fn: function() {
+      var txn = env.beginTxn();
+      for (var i = 0; i < TXN_SIZE; i++) {
+        txn.putString(dbi, keys[next()], 'value');
+      }
+      txn.commit();
+    } },
+    { name: 'putBinary x' + TXN_SIZE + ' in one txn, commitAsync', ops: TXN_SIZE, defer: true, fn: function(deferred) {
+      var txn = env.beginTxn();
+      for (var i = 0; i < TXN_SIZE; i++) {
+        txn.putBinary(dbi, keys[next()], value);
+      }
+      txn.commitAsync(function(error) {
+        if (error) {
+          throw error;
+        }
+        deferred.resolve();
+      });
+    } },
+    { name: 'putBinary in its own txn', fn: function() {
+      var txn = env.beginTxn();
+      txn.putBinary(dbi, keys[next()], value);
+      txn.commit();
+    } }
+  ]).then(function(results) {
+    dbi.close();
+    uint32Dbi.close();
+    return results;
+  });
+};
@@ -0,0 +1,41 @@
+'use strict';
+
+// A reader thread of the threads and mixed suites. It attaches to the environment that the
+// main thread shares, waits for the signal to start and reports how many reads it made.
+
+var workerThreads = require('worker_threads');
+var lmdb = require('..');
+var common = require('./common');
+
+var RENEW_EVERY = 10000;
+
+var env = new lmdb.Env();
+var dbi = env.attach(workerThreads.workerData.handle)[0];
+var count = workerThreads.workerData.count;
+var next = common.indexes(count);
+var keys = [];
+for (var i = 0; i < count; i++) {
+  keys.push(common.makeKey(i));
+}
+
+workerThreads.parentPort.on('message', function(duration) {
+  var reads = 0;
+  var txn = env.beginTxn({ readOnly: true });
+  var start = Date.now();
+  var end = start + duration;
+  while (Date.now() < end) {
+    for (var i = 0; i < RENEW_EVERY; i++) {
+      txn.getBinaryUnsafe(dbi, keys[next()]);
+    }
+    reads += RENEW_EVERY;
+    // A new snapshot now and then, so that the readers see the writes of the mixed suite
+    txn.reset();
+    txn.renew();
+  }
+  txn.abort();
+  // The Dbi handle belongs to the main thread, which goes on using it in the next suites,
+  // so the worker only closes its Env
+  env.close();
+  workerThreads.parentPort.postMessage({ reads: reads, ms: Date.now() - start });
+});
+workerThreads.parentPort.postMessage('ready');
@@ -16,6 +16,10 @@
         "src/node-lmdb.cpp",
         "src/env.cpp",
         "src/misc.cpp",
+        "src/metrics.cpp",
+        "src/trace.cpp",
+        "src/pagecache.cpp",
+        "src/postings.cpp",
         "src/txn.cpp",
         "src/dbi.cpp",
         "src/cursor.cpp"
@@ -507,6 +507,20 @@ typedef struct MDB_envinfo {
 	unsigned int me_numreaders;		/**< max reader slots used in the environment */
 } MDB_envinfo;
 
+/** @brief Statistics for the commit of a write transaction, see #mdb_txn_commit_stat() */
+typedef struct MDB_commit_stat {
+	mdb_size_t	ms_dirty;			/**< Pages dirty in memory when the commit began */
+	mdb_size_t	ms_spilled;			/**< Pages spilled to the file before the commit */
+	mdb_size_t	ms_spill_writes;	/**< Write system calls spilling pages */
+	mdb_size_t	ms_written;			/**< Pages written by the commit, including the freelist */
+	mdb_size_t	ms_writes;			/**< Write system calls of the commit, without the meta page */
+	uint64_t	ms_spill_time;		/**< Nanoseconds spent spilling pages */
+	uint64_t	ms_freelist_time;	/**< Nanoseconds spent saving the freelist */
+	uint64_t	ms_write_time;		/**< Nanoseconds spent writing the pages */
+	uint64_t	ms_sync_time;		/**< Nanoseconds spent syncing the pages */
+	uint64_t	ms_meta_time;		/**< Nanoseconds spent writing (and syncing) the meta page */
+} MDB_commit_stat;
+
 	/** @brief Return the LMDB library version information.
 	 *
 	 * @param[out] major if non-NULL, the library major version number is copied here
@@ -745,6 +759,69 @@ int  mdb_env_copy2(MDB_env *env, const char *path, unsigned int flags);
 	 */
 int  mdb_env_copyfd2(MDB_env *env, mdb_filehandle_t fd, unsigned int flags);
 
+	/** @brief A callback function for #mdb_env_walk_pages() and #mdb_dbi_walk().
+	 *
+	 * @param[in] ctx The context passed to #mdb_env_walk_pages() or #mdb_dbi_walk().
+	 * @param[in] pgno The number of the first page.
+	 * @param[in] pages The address of the pages, they must not be modified.
+	 * @param[in] count The number of pages.
+	 * @return Non-zero to stop the walk, which then returns this value.
+	 */
+typedef int (MDB_page_func)(void *ctx, mdb_size_t pgno, const void *pages, mdb_size_t count);
+
+	/** @brief Pass the raw pages of a snapshot of the environment to a function.
+	 *
+	 * This is the same snapshot that #mdb_env_copyfd2() copies without
+	 * #MDB_CP_COMPACT: the meta pages as they were when the snapshot was
+	 * taken, followed by every other page up to the last used page, so that
+	 * writing the pages in order gives a copy of the environment. It may be
+	 * used to make incremental backups by only keeping the pages that changed.
+	 * The pages that are not free in the snapshot don't change while the
+	 * function runs, free pages may be written by concurrent transactions.
+	 * @note This call holds a read-only transaction while it runs,
+	 * see long-lived transactions under @ref caveats_sec.
+	 * @note Not supported with MDB_VL32.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] func The function that receives the pages. It is called
+	 * once with the meta pages, and once with the rest of the pages.
+	 * @param[in] ctx An arbitrary pointer passed to \b func.
+	 * @param[out] info The address of an #MDB_envinfo structure, it's filled
+	 * in before \b func is first called. \b me_last_txnid and \b me_last_pgno
+	 * describe the snapshot.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_walk_pages(MDB_env *env, MDB_page_func *func, void *ctx, MDB_envinfo *info);
+
+	/** @brief Replace the data file of an open environment with a copy of it.
+	 *
+	 * This may be used to compact an environment while it is open: make a
+	 * copy with #MDB_CP_COMPACT, then replace the data file with it. The
+	 * copy is renamed over the data file and mapped instead of it, so
+	 * that database handles and settings of the environment stay valid.
+	 * The meta pages of the copy are rewritten to continue from \b txnid.
+	 * The caller must make sure that no transaction of this environment
+	 * handle is active, and that no other handle in this process uses
+	 * the environment.
+	 * @note Not supported on Windows, nor with MDB_VL32.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully, not read-only.
+	 * @param[in] path The path of the copy, which must be on the same
+	 * filesystem as the data file.
+	 * @param[in] txnid The ID of the last transaction that was committed
+	 * when the copy was started.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EAGAIN - a transaction was committed since \b txnid, the copy
+	 *		is out of date.
+	 *	<li>EBUSY - another process has the environment open, or a reader
+	 *		is active.
+	 *	<li>MDB_INVALID - the copy is not an LMDB file with the same page size.
+	 * </ul>
+	 */
+int  mdb_env_replace_file(MDB_env *env, const char *path, mdb_size_t txnid);
+
 	/** @brief Return statistics about the LMDB environment.
 	 *
 	 * @param[in] env An environment handle returned by #mdb_env_create()
@@ -761,6 +838,81 @@ int  mdb_env_stat(MDB_env *env, MDB_stat *stat);
 	 */
 int  mdb_env_info(MDB_env *env, MDB_envinfo *stat);
 
+	/** @brief Return the number of bytes written by commits through this handle.
+	 *
+	 * Counts the pages that commits in this process wrote through this
+	 * environment handle (or dirtied in the map, with #MDB_WRITEMAP),
+	 * which is what a following #mdb_env_sync() has to flush at most.
+	 * Meta pages and writes of other processes are not counted.
+	 * The count is not synchronized with commits running on other threads.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] bytes Address where the number of bytes will be stored.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_get_written(MDB_env *env, mdb_size_t *bytes);
+
+/** @brief Advice for #mdb_env_advise(), same as the advice of madvise() */
+typedef enum MDB_advice {
+	MDB_ADVICE_NORMAL,
+	MDB_ADVICE_RANDOM,
+	MDB_ADVICE_SEQUENTIAL,
+	MDB_ADVICE_WILLNEED,
+	MDB_ADVICE_DONTNEED
+} MDB_advice;
+
+	/** @brief Give advice about the use of a range of pages of the memory map.
+	 *
+	 * Calls madvise() on the pages, rounded to the pages of the OS:
+	 * #MDB_ADVICE_WILLNEED reads them ahead, #MDB_ADVICE_DONTNEED lets
+	 * the OS drop them from the memory of the process, and
+	 * #MDB_ADVICE_RANDOM turns off the read-ahead like #MDB_NORDAHEAD.
+	 * Pages beyond the map are ignored.
+	 * @note Not supported on Windows, nor with MDB_VL32.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] pgno The number of the first page.
+	 * @param[in] count The number of pages.
+	 * @param[in] advice One of the #MDB_advice values.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_advise(MDB_env *env, mdb_size_t pgno, mdb_size_t count, int advice);
+
+	/** @brief Tell which pages of the memory map are resident in memory.
+	 *
+	 * Calls mincore() on the pages. A page is resident when all of the OS
+	 * pages it spans are. Checking doesn't read the pages.
+	 * @note Not supported on Windows, nor with MDB_VL32.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] pgno The number of the first page.
+	 * @param[in] count The number of pages.
+	 * @param[out] vec An array of \b count bytes, each set to 1 if the page
+	 * is resident and to 0 otherwise, or if it's beyond the map.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_resident(MDB_env *env, mdb_size_t pgno, mdb_size_t count, unsigned char *vec);
+
+	/** @brief Lock a range of pages of the memory map in memory, or unlock it.
+	 *
+	 * Calls mlock() or munlock() on the pages, rounded to the pages of the
+	 * OS. Locked pages stay in memory until they're unlocked or the map is
+	 * resized or closed, and count against RLIMIT_MEMLOCK.
+	 * Pages beyond the map are ignored.
+	 * @note Not supported on Windows, nor with MDB_VL32.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] pgno The number of the first page.
+	 * @param[in] count The number of pages.
+	 * @param[in] lock Non-zero to lock the pages, zero to unlock them.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>ENOMEM - the pages would exceed RLIMIT_MEMLOCK.
+	 *	<li>EPERM - the process may not lock memory.
+	 * </ul>
+	 */
+int  mdb_env_lock(MDB_env *env, mdb_size_t pgno, mdb_size_t count, int lock);
+
 	/** @brief Flush the data buffers to disk.
 	 *
 	 * Data is always written to disk when #mdb_txn_commit() is called,
@@ -884,6 +1036,34 @@ int  mdb_env_get_fd(MDB_env *env, mdb_filehandle_t *fd);
 	 */
 int  mdb_env_set_mapsize(MDB_env *env, mdb_size_t size);
 
+/** @defgroup	mdb_mapflags	Memory map options
+ *	@{
+ */
+	/** read the whole data file into memory when it's mapped (MAP_POPULATE) */
+#define MDB_MAP_POPULATE	0x01
+	/** ask for transparent huge pages on the map (MADV_HUGEPAGE) */
+#define MDB_MAP_HUGEPAGE	0x02
+/** @} */
+
+	/** @brief Set options of the memory map of the environment.
+	 *
+	 * The options are applied each time the data file is mapped, when the
+	 * environment is opened and when the map is resized. They are hints:
+	 * #MDB_MAP_POPULATE is ignored where MAP_POPULATE isn't defined, and
+	 * #MDB_MAP_HUGEPAGE where the OS or the filesystem of the data file
+	 * doesn't support huge pages in file mappings.
+	 * This function may only be called after #mdb_env_create() and before #mdb_env_open().
+	 * @note Not supported on Windows, nor with MDB_VL32, where the options are ignored.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] flags The options, a bitwise OR of #MDB_MAP_POPULATE and #MDB_MAP_HUGEPAGE.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the environment is already open.
+	 * </ul>
+	 */
+int  mdb_env_set_mapflags(MDB_env *env, unsigned int flags);
+
 	/** @brief Set the maximum number of threads/reader slots for the environment.
 	 *
 	 * This defines the number of slots in the lock table that is used to track readers in the
@@ -1033,6 +1213,39 @@ MDB_env *mdb_txn_env(MDB_txn *txn);
 	 */
 mdb_size_t mdb_txn_id(MDB_txn *txn);
 
+	/** @brief Return the number of dirty and spilled pages of a write transaction.
+	 *
+	 * A write transaction keeps the pages it modified in memory, up to
+	 * a limit; beyond that, dirty pages are spilled (written to the file)
+	 * to make room, and must be read back if they are modified again.
+	 * A high ratio of spilled pages means the transaction is too large.
+	 * @param[in] txn A write transaction handle returned by #mdb_txn_begin()
+	 * @param[out] dirty The number of dirty pages, or NULL
+	 * @param[out] spilled The number of spilled pages, or NULL
+	 * @param[out] room The number of pages that can still be dirtied
+	 * before pages are spilled, or NULL
+	 * @return A non-zero error value on failure and 0 on success. EINVAL
+	 * is returned for read-only and finished transactions.
+	 */
+int  mdb_txn_dirty_stat(MDB_txn *txn, mdb_size_t *dirty, mdb_size_t *spilled, mdb_size_t *room);
+
+	/** @brief Collect statistics about the commit of a write transaction.
+	 *
+	 * The structure is cleared, then the transaction counts the pages it
+	 * spills in it from now on, and its commit fills in how many pages
+	 * it wrote, with how many system calls, and how long each step took.
+	 * This costs a few reads of the clock per commit and per spill.
+	 * The structure must stay valid until the transaction ends; with
+	 * #mdb_txn_commit_sync() on another thread, it is only complete once
+	 * that call has returned.
+	 * @param[in] txn A write transaction handle returned by #mdb_txn_begin()
+	 * @param[in] stat The address of an #MDB_commit_stat structure, or NULL
+	 * to stop collecting statistics.
+	 * @return A non-zero error value on failure and 0 on success. EINVAL
+	 * is returned for read-only and finished transactions.
+	 */
+int  mdb_txn_commit_stat(MDB_txn *txn, MDB_commit_stat *stat);
+
 	/** @brief Commit all the operations of a transaction into the database.
 	 *
 	 * The transaction handle is freed. It and its cursors must not be used
@@ -1051,6 +1264,54 @@ mdb_size_t mdb_txn_id(MDB_txn *txn);
 	 */
 int  mdb_txn_commit(MDB_txn *txn);
 
+	/** @brief Write the pages of a write transaction, without syncing them.
+	 *
+	 * The first of three steps doing the same as #mdb_txn_commit(), which
+	 * allow the slow part of a commit to run on another thread:
+	 * #mdb_txn_commit_prepare() and #mdb_txn_commit_finish() must be called
+	 * from the thread which began the transaction, since they use the
+	 * writer lock, while #mdb_txn_commit_sync() may be called from any thread.
+	 * Between the first and the last step the transaction can't be used for
+	 * anything else, and no other write transaction can begin.
+	 * The transaction is aborted if this call fails.
+	 * @param[in] txn A top-level write transaction returned by #mdb_txn_begin()
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the transaction
+	 *		is read-only or nested.
+	 *	<li>ENOSPC - no more disk space.
+	 *	<li>EIO - a low-level I/O error occurred while writing.
+	 *	<li>ENOMEM - out of memory.
+	 * </ul>
+	 */
+int  mdb_txn_commit_prepare(MDB_txn *txn);
+
+	/** @brief Sync the pages of a prepared transaction and write its meta page.
+	 *
+	 * This doesn't take any lock and may be called from another thread than
+	 * the one which began the transaction. The transaction is not ended,
+	 * whatever the result: pass it to #mdb_txn_commit_finish().
+	 * @param[in] txn A transaction prepared by #mdb_txn_commit_prepare()
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EIO - a low-level I/O error occurred while writing.
+	 * </ul>
+	 */
+int  mdb_txn_commit_sync(MDB_txn *txn);
+
+	/** @brief End a transaction committed by #mdb_txn_commit_sync().
+	 *
+	 * The transaction handle is freed, as with #mdb_txn_commit(). It is
+	 * aborted instead when \b rc is non-zero.
+	 * @param[in] txn A transaction prepared by #mdb_txn_commit_prepare()
+	 * @param[in] rc The result of #mdb_txn_commit_sync()
+	 * @return \b rc if it is non-zero, otherwise 0 on success or
+	 * a non-zero error value on failure.
+	 */
+int  mdb_txn_commit_finish(MDB_txn *txn, int rc);
+
 	/** @brief Abandon all the operations of the transaction instead of saving them.
 	 *
 	 * The transaction handle is freed. It and its cursors must not be used
@@ -1186,6 +1447,32 @@ int  mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *d
 	 */
 int  mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 
+/** @brief Also pass the leaf pages to the function of #mdb_dbi_walk() */
+#define MDB_WALK_LEAVES	0x01
+/** @brief Only walk the top \b n levels of the B-tree in #mdb_dbi_walk(),
+ * the root being the first level. 0 walks all of them.
+ */
+#define MDB_WALK_LEVELS(n)	((unsigned int)(n) << 8)
+
+	/** @brief Pass the pages of the B-tree of a database to a function.
+	 *
+	 * The walk is depth-first, in key order. \b func is called with each
+	 * branch page before the walk reads it, so that it may check whether
+	 * the page is resident, and with each leaf page when #MDB_WALK_LEAVES
+	 * is given. Leaf pages aren't read, so the overflow pages and the
+	 * sub-databases of #MDB_DUPSORT databases are not visited. Reading
+	 * the branch pages faults them in, except for the pages of the last
+	 * level given by #MDB_WALK_LEVELS(), which aren't read either.
+	 * @note Not supported with MDB_VL32.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] flags 0, #MDB_WALK_LEAVES, or'd with #MDB_WALK_LEVELS().
+	 * @param[in] func The function that receives the pages, one at a time.
+	 * @param[in] ctx An arbitrary pointer passed to \b func.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_dbi_walk(MDB_txn *txn, MDB_dbi dbi, unsigned int flags, MDB_page_func *func, void *ctx);
+
 	/** @brief Retrieve the DB flags for a database handle.
 	 *
 	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
@@ -1589,6 +1876,44 @@ int  mdb_cursor_del(MDB_cursor *cursor, unsigned int flags);
 	 */
 int  mdb_cursor_count(MDB_cursor *cursor, mdb_size_t *countp);
 
+	/** @brief Return the approximate relative position of a cursor.
+	 *
+	 * The position is derived from the cursor's index at each level of the
+	 * B-tree, weighing the entries of upper branch pages by the number of
+	 * keys of their child pages; only branch pages are read, so it is cheap
+	 * compared to counting the items. Multiplying the difference of two positions by the database's
+	 * ms_entries gives an estimate of the number of items between them.
+	 * Duplicate data items of a key are not distinguished.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[out] posp Address where the position, from 0.0 (first item)
+	 * to 1.0 (past the last item), will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - cursor is not initialized, or an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_pos(MDB_cursor *cursor, double *posp);
+
+	/** @brief Position a cursor at an approximate relative position.
+	 *
+	 * This is the inverse of #mdb_cursor_pos(): the cursor is moved to
+	 * the key found at roughly the given fraction of the database, by
+	 * descending the B-tree once, without visiting the keys before it.
+	 * Positions are measured the same way as by #mdb_cursor_pos().
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] pos The position, from 0.0 (first item) to 1.0 (last item)
+	 * @param[out] key The key the cursor was moved to
+	 * @param[out] data The data of that key, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_NOTFOUND - the database is empty.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_set_pos(MDB_cursor *cursor, double pos, MDB_val *key, MDB_val *data);
+
 	/** @brief Compare two data items according to a particular database.
 	 *
 	 * This returns a comparison as if the two data items were keys in the
@@ -0,0 +1,164 @@
+/* mbench.c - lookup benchmark for the key search within pages */
+/*
+ * Copyright 2011-2020 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Fills ./bench.mdb with string keys sharing a long prefix, integer
+ * keys and integer duplicates, then measures random lookups/sec in each.
+ * "make bench" runs it against a library built with MDB_INLINE_CMP=0
+ * (mbench-call) and with the default build (mbench).
+ *
+ *	mbench [-n count] [-p prefix length] [-l lookups]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define DBPATH	"./bench.mdb"
+
+static unsigned int seed = 2463534242U;
+
+/* xorshift, so that every run looks up the same keys */
+static unsigned int next(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void strkey(char *buf, int prefix, unsigned int n)
+{
+	memset(buf, 'k', prefix);
+	sprintf(buf + prefix, "%08x", n);
+}
+
+/* lookups/sec of the best of three rounds */
+#define TIME(name, lookup)	do { \
+	double best = 0, start, secs; \
+	int round; \
+	for (round = 0; round < 3; round++) { \
+		start = now(); \
+		for (i = 0; i < lookups; i++) { lookup; } \
+		secs = now() - start; \
+		if (!round || secs < best) best = secs; \
+	} \
+	report(name, lookups, best); \
+} while (0)
+
+static void report(const char *name, int lookups, double secs)
+{
+	printf("%-8s %12.0f lookups/sec\n", name, lookups / secs);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, rc, c;
+	int count = 1000000, prefix = 48, lookups = 2000000;
+	MDB_env *env;
+	MDB_dbi sdbi, idbi, ddbi;
+	MDB_val key, data;
+	MDB_txn *txn;
+	MDB_cursor *cursor;
+	unsigned int *values, u, zero = 0;
+	char *skeys;
+	size_t ssize;
+
+	while ((c = getopt(argc, argv, "n:p:l:")) != -1) {
+		switch (c) {
+		case 'n': count = atoi(optarg); break;
+		case 'p': prefix = atoi(optarg); break;
+		case 'l': lookups = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n count] [-p prefix] [-l lookups]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	values = (unsigned int *)malloc(count * sizeof(unsigned int));
+	ssize = prefix + 9;
+	skeys = (char *)malloc((size_t)count * ssize);
+	for (i = 0; i < count; i++) {
+		values[i] = next();
+		strkey(skeys + i * ssize, prefix, values[i]);
+	}
+
+	unlink(DBPATH);
+	unlink(DBPATH "-lock");
+	E(mdb_env_create(&env));
+	E(mdb_env_set_maxdbs(env, 3));
+	E(mdb_env_set_mapsize(env, (size_t)count * (prefix + 64) * 4 + 10485760));
+	E(mdb_env_open(env, DBPATH, MDB_NOSUBDIR|MDB_NOSYNC, 0664));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, "str", MDB_CREATE, &sdbi));
+	E(mdb_dbi_open(txn, "int", MDB_CREATE|MDB_INTEGERKEY, &idbi));
+	E(mdb_dbi_open(txn, "dup", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP, &ddbi));
+	for (i = 0; i < count; i++) {
+		key.mv_size = prefix + 8;
+		key.mv_data = skeys + i * ssize;
+		data.mv_size = sizeof(unsigned int);
+		data.mv_data = &values[i];
+		E(mdb_put(txn, sdbi, &key, &data, 0));
+		key.mv_size = sizeof(unsigned int);
+		key.mv_data = &values[i];
+		E(mdb_put(txn, idbi, &key, &data, 0));
+		key.mv_data = &zero;
+		E(mdb_put(txn, ddbi, &key, &data, 0));
+	}
+	E(mdb_txn_commit(txn));
+	printf("%d entries, %d byte prefix\n", count, prefix);
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+
+	TIME("str",
+		key.mv_size = prefix + 8;
+		key.mv_data = skeys + (next() % count) * ssize;
+		E(mdb_get(txn, sdbi, &key, &data)));
+
+	TIME("int",
+		u = values[next() % count];
+		key.mv_size = sizeof(unsigned int);
+		key.mv_data = &u;
+		E(mdb_get(txn, idbi, &key, &data)));
+
+	E(mdb_cursor_open(txn, ddbi, &cursor));
+	TIME("dup",
+		u = values[next() % count];
+		key.mv_size = sizeof(unsigned int);
+		key.mv_data = &zero;
+		data.mv_size = sizeof(unsigned int);
+		data.mv_data = &u;
+		E(mdb_cursor_get(cursor, &key, &data, MDB_GET_BOTH)));
+	mdb_cursor_close(cursor);
+
+	mdb_txn_abort(txn);
+	mdb_env_close(env);
+	free(skeys);
+	free(values);
+
+	return 0;
+}
@@ -1346,8 +1346,9 @@ struct MDB_txn {
 #define MDB_TXN_DIRTY		0x04		/**< must write, even if dirty list is empty */
 #define MDB_TXN_SPILLS		0x08		/**< txn or a parent has spilled pages */
 #define MDB_TXN_HAS_CHILD	0x10		/**< txn has an #MDB_txn.%mt_child */
+#define MDB_TXN_PREPARED	0x20		/**< txn pages are written, only the sync is left */
 	/** most operations on the txn are currently illegal */
-#define MDB_TXN_BLOCKED		(MDB_TXN_FINISHED|MDB_TXN_ERROR|MDB_TXN_HAS_CHILD)
+#define MDB_TXN_BLOCKED		(MDB_TXN_FINISHED|MDB_TXN_ERROR|MDB_TXN_HAS_CHILD|MDB_TXN_PREPARED)
 /** @} */
 	unsigned int	mt_flags;		/**< @ref mdb_txn */
 	/** #dirty_list room: Array size - \#dirty pages visible to this txn.
@@ -1356,6 +1357,10 @@ struct MDB_txn {
 	 *	dirty_list into mt_parent after freeing hidden mt_parent pages.
 	 */
 	unsigned int	mt_dirty_room;
+	/** Where to count the spilled pages and the steps of the commit,
+	 *	or NULL, see #mdb_txn_commit_stat().
+	 */
+	MDB_commit_stat	*mt_cstat;
 };
 
 /** Enough space for 2^32 nodes with minimum of 2 keys per node. I.e., plenty.
@@ -1413,6 +1418,10 @@ struct MDB_cursor {
 	unsigned int	mc_flags;	/**< @ref mdb_cursor */
 	MDB_page	*mc_pg[CURSOR_STACK];	/**< stack of pushed pages */
 	indx_t		mc_ki[CURSOR_STACK];	/**< stack of page indices */
+	/** The length of the prefix that all keys of the top page share
+	 *	with the key of the last #mdb_page_search_root(), see #mdb_node_search()
+	 */
+	size_t		mc_lcp;
 #ifdef MDB_VL32
 	MDB_page	*mc_ovpg;		/**< a referenced overflow page */
 #	define MC_OVPG(mc)			((mc)->mc_ovpg)
@@ -1517,6 +1526,9 @@ struct MDB_env {
 	int			me_maxfree_1pg;
 	/** Max size of a node on a page */
 	unsigned int	me_nodemax;
+	/** Bytes of pages written by the commits of this env handle */
+	mdb_size_t	me_written;
+	unsigned int	me_mapflags;	/**< @ref mdb_mapflags */
 #if !(MDB_MAXKEYSIZE)
 	unsigned int	me_maxkey;	/**< max size of a key */
 #endif
@@ -1588,6 +1600,9 @@ enum {
 #define MDB_END_FREE	0x20	/**< free txn unless it is #MDB_env.%me_txn0 */
 #define MDB_END_SLOT MDB_NOTLS	/**< release any reader slot if #MDB_NOTLS */
 static void mdb_txn_end(MDB_txn *txn, unsigned mode);
+static int  mdb_txn_prepare0(MDB_txn *txn);
+static int  mdb_txn_sync0(MDB_txn *txn);
+static int  mdb_txn_finish0(MDB_txn *txn);
 
 static int  mdb_page_get(MDB_cursor *mc, pgno_t pgno, MDB_page **mp, int *lvl);
 static int  mdb_page_search_root(MDB_cursor *mc,
@@ -1612,7 +1627,8 @@ static int  mdb_env_write_meta(MDB_txn *txn);
 #endif
 static void mdb_env_close0(MDB_env *env, int excl);
 
-static MDB_node *mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp);
+static MDB_node *mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp,
+			    size_t *lcpp);
 static int  mdb_node_add(MDB_cursor *mc, indx_t indx,
 			    MDB_val *key, MDB_val *data, pgno_t pgno, unsigned int flags);
 static void mdb_node_del(MDB_cursor *mc, int ksize);
@@ -1645,6 +1661,7 @@ static void	mdb_xcursor_init2(MDB_cursor *mc, MDB_xcursor *src_mx, int force);
 
 static int	mdb_drop0(MDB_cursor *mc, int subs);
 static void mdb_default_cmp(MDB_txn *txn, MDB_dbi dbi);
+static void mdb_scan_init(void);
 static int mdb_reader_check0(MDB_env *env, int rlocked, int *dead);
 
 /** @cond */
@@ -2241,6 +2258,23 @@ mark_done:
 
 static int mdb_page_flush(MDB_txn *txn, int keep);
 
+/** Return a monotonic time in nanoseconds, to time the steps of a commit */
+static uint64_t
+mdb_nsec(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 +
+		(uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
 /**	Spill pages from the dirty list back to disk.
  * This is intended to prevent running into #MDB_TXN_FULL situations,
  * but note that they may still occur in a few cases:
@@ -2279,6 +2313,9 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	MDB_txn *txn = m0->mc_txn;
 	MDB_page *dp;
 	MDB_ID2L dl = txn->mt_u.dirty_list;
+	MDB_commit_stat *cs = txn->mt_cstat;
+	mdb_size_t written = 0, writes = 0;
+	uint64_t start = 0;
 	unsigned int i, j, need;
 	int rc;
 
@@ -2359,8 +2396,23 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	}
 	mdb_midl_sort(txn->mt_spill_pgs);
 
-	/* Flush the spilled part of dirty list */
-	if ((rc = mdb_page_flush(txn, i)) != MDB_SUCCESS)
+	/* Flush the spilled part of dirty list. mdb_page_flush() counts
+	 * its writes as the commit's, move them to the spill counters.
+	 */
+	if (cs) {
+		start = mdb_nsec();
+		written = cs->ms_written;
+		writes = cs->ms_writes;
+	}
+	rc = mdb_page_flush(txn, i);
+	if (cs) {
+		cs->ms_spilled += cs->ms_written - written;
+		cs->ms_spill_writes += cs->ms_writes - writes;
+		cs->ms_written = written;
+		cs->ms_writes = writes;
+		cs->ms_spill_time += mdb_nsec() - start;
+	}
+	if (rc != MDB_SUCCESS)
 		goto done;
 
 	/* Reset any dirty pages we kept that page_flush didn't see */
@@ -3088,6 +3140,7 @@ mdb_txn_renew0(MDB_txn *txn)
 		txn->mt_free_pgs = env->me_free_pgs;
 		txn->mt_free_pgs[0] = 0;
 		txn->mt_spill_pgs = NULL;
+		txn->mt_cstat = NULL;
 		env->me_txn = txn;
 		memcpy(txn->mt_dbiseqs, env->me_dbiseqs, env->me_maxdbs * sizeof(unsigned int));
 	}
@@ -3211,6 +3264,8 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		txn->mt_dirty_room = parent->mt_dirty_room;
 		txn->mt_u.dirty_list[0].mid = 0;
 		txn->mt_spill_pgs = NULL;
+		/* Pages spilled by the child are written all the same */
+		txn->mt_cstat = parent->mt_cstat;
 		txn->mt_next_pgno = parent->mt_next_pgno;
 		parent->mt_flags |= MDB_TXN_HAS_CHILD;
 		parent->mt_child = txn;
@@ -3275,6 +3330,45 @@ mdb_txn_id(MDB_txn *txn)
     return txn->mt_txnid;
 }
 
+int
+mdb_txn_dirty_stat(MDB_txn *txn, mdb_size_t *dirty, mdb_size_t *spilled, mdb_size_t *room)
+{
+	MDB_IDL sl;
+	mdb_size_t i, count = 0;
+
+	if (!txn || (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_FINISHED)))
+		return EINVAL;
+
+	if (dirty)
+		*dirty = txn->mt_u.dirty_list[0].mid;
+	if (spilled) {
+		/* Pages that were spilled and dirtied again are marked deleted */
+		sl = txn->mt_spill_pgs;
+		if (sl) {
+			for (i = 1; i <= sl[0]; i++) {
+				if (!(sl[i] & 1))
+					count++;
+			}
+		}
+		*spilled = count;
+	}
+	if (room)
+		*room = txn->mt_dirty_room;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_txn_commit_stat(MDB_txn *txn, MDB_commit_stat *stat)
+{
+	if (!txn || (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_FINISHED)))
+		return EINVAL;
+
+	if (stat)
+		memset(stat, 0, sizeof(*stat));
+	txn->mt_cstat = stat;
+	return MDB_SUCCESS;
+}
+
 /** Export or close DBI handles opened in this txn. */
 static void
 mdb_dbis_update(MDB_txn *txn, int keep)
@@ -3682,6 +3776,7 @@ mdb_page_flush(MDB_txn *txn, int keep)
 	ssize_t		wsize = 0, wres;
 	MDB_OFF_T	wpos = 0, next_pos = 1; /* impossible pos, so pos != next_pos */
 	int			n = 0;
+	mdb_size_t	npages = 0, nwrites = 0;
 
 	j = i = keep;
 	if (env->me_flags & MDB_WRITEMAP
@@ -3701,6 +3796,8 @@ mdb_page_flush(MDB_txn *txn, int keep)
 				continue;
 			}
 			dp->mp_flags &= ~P_DIRTY;
+			env->me_written += IS_OVERFLOW(dp) ? (mdb_size_t)psize * dp->mp_pages : psize;
+			npages += IS_OVERFLOW(dp) ? dp->mp_pages : 1;
 		}
 		goto done;
 	}
@@ -3742,6 +3839,8 @@ mdb_page_flush(MDB_txn *txn, int keep)
 			pos = pgno * psize;
 			size = psize;
 			if (IS_OVERFLOW(dp)) size *= dp->mp_pages;
+			env->me_written += size;
+			npages += size / psize;
 		}
 		/* Write up to MDB_COMMIT_PAGES dirty pages at a time. */
 		if (pos!=next_pos || n==MDB_COMMIT_PAGES || wsize+size>MAX_WRITE
@@ -3763,6 +3862,7 @@ mdb_page_flush(MDB_txn *txn, int keep)
 retry_write:
 				/* Write previous page(s) */
 				DPRINTF(("committing page %"Z"u", pgno));
+				nwrites++;
 #ifdef _WIN32
 				OVERLAPPED *this_ov = &ov[async_i];
 				/* Clear status, and keep hEvent, we reuse that */
@@ -3885,6 +3985,10 @@ done:
 	i--;
 	txn->mt_dirty_room += i - j;
 	dl[0].mid = j;
+	if (txn->mt_cstat) {
+		txn->mt_cstat->ms_written += npages;
+		txn->mt_cstat->ms_writes += nwrites;
+	}
 	return MDB_SUCCESS;
 }
 
@@ -3895,7 +3999,6 @@ mdb_txn_commit(MDB_txn *txn)
 {
 	int		rc;
 	unsigned int i, end_mode;
-	MDB_env	*env;
 
 	if (txn == NULL)
 		return EINVAL;
@@ -3909,8 +4012,6 @@ mdb_txn_commit(MDB_txn *txn)
 			goto fail;
 	}
 
-	env = txn->mt_env;
-
 	if (F_ISSET(txn->mt_flags, MDB_TXN_RDONLY)) {
 		goto done;
 	}
@@ -4054,21 +4155,55 @@ mdb_txn_commit(MDB_txn *txn)
 		return rc;
 	}
 
+	rc = mdb_txn_prepare0(txn);
+	if (!rc)
+		rc = mdb_txn_sync0(txn);
+	if (!rc)
+		rc = mdb_txn_finish0(txn);
+	if (rc)
+		goto fail;
+	return MDB_SUCCESS;
+
+done:
+	mdb_txn_end(txn, end_mode);
+	return MDB_SUCCESS;
+
+fail:
+	mdb_txn_abort(txn);
+	return rc;
+}
+
+/** Write the dirty pages of a top-level write txn, but don't sync them.
+ * If there was anything to write, the txn is flagged #MDB_TXN_PREPARED
+ * and only accepts #mdb_txn_sync0() and #mdb_txn_finish0() from now on.
+ * @param[in] txn the transaction to prepare
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_txn_prepare0(MDB_txn *txn)
+{
+	int		rc;
+	MDB_env	*env = txn->mt_env;
+	MDB_commit_stat *cs = txn->mt_cstat;
+	uint64_t start = 0;
+
 	if (txn != env->me_txn) {
 		DPUTS("attempt to commit unknown transaction");
-		rc = EINVAL;
-		goto fail;
+		return EINVAL;
 	}
 
 	mdb_cursors_close(txn, 0);
 
 	if (!txn->mt_u.dirty_list[0].mid &&
 		!(txn->mt_flags & (MDB_TXN_DIRTY|MDB_TXN_SPILLS)))
-		goto done;
+		return MDB_SUCCESS;
 
 	DPRINTF(("committing txn %"Yu" %p on mdbenv %p, root page %"Yu,
 	    txn->mt_txnid, (void*)txn, (void*)env, txn->mt_dbs[MAIN_DBI].md_root));
 
+	if (cs)
+		cs->ms_dirty = txn->mt_u.dirty_list[0].mid;
+
 	/* Update DB root pointers */
 	if (txn->mt_numdbs > CORE_DBS) {
 		MDB_cursor mc;
@@ -4079,22 +4214,26 @@ mdb_txn_commit(MDB_txn *txn)
 		mdb_cursor_init(&mc, txn, MAIN_DBI, NULL);
 		for (i = CORE_DBS; i < txn->mt_numdbs; i++) {
 			if (txn->mt_dbflags[i] & DB_DIRTY) {
-				if (TXN_DBI_CHANGED(txn, i)) {
-					rc = MDB_BAD_DBI;
-					goto fail;
-				}
+				if (TXN_DBI_CHANGED(txn, i))
+					return MDB_BAD_DBI;
 				data.mv_data = &txn->mt_dbs[i];
 				rc = mdb_cursor_put(&mc, &txn->mt_dbxs[i].md_name, &data,
 					F_SUBDATA);
 				if (rc)
-					goto fail;
+					return rc;
 			}
 		}
 	}
 
+	if (cs)
+		start = mdb_nsec();
 	rc = mdb_freelist_save(txn);
 	if (rc)
-		goto fail;
+		return rc;
+	if (cs) {
+		cs->ms_freelist_time = mdb_nsec() - start;
+		start += cs->ms_freelist_time;
+	}
 
 	mdb_midl_free(env->me_pghead);
 	env->me_pghead = NULL;
@@ -4105,29 +4244,107 @@ mdb_txn_commit(MDB_txn *txn)
 #endif
 
 	if ((rc = mdb_page_flush(txn, 0)))
-		goto fail;
+		return rc;
+	if (cs)
+		cs->ms_write_time = mdb_nsec() - start;
+	txn->mt_flags |= MDB_TXN_PREPARED;
+	return MDB_SUCCESS;
+}
+
+/** Sync the pages written by #mdb_txn_prepare0() and write the meta page.
+ * This doesn't take or release any lock, so it may run on another thread
+ * than the one which owns the txn.
+ * @param[in] txn the prepared transaction
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_txn_sync0(MDB_txn *txn)
+{
+	int		rc;
+	MDB_env	*env = txn->mt_env;
+	MDB_commit_stat *cs = txn->mt_cstat;
+	uint64_t start = 0;
+
+	if (!(txn->mt_flags & MDB_TXN_PREPARED))
+		return MDB_SUCCESS;
+	if (cs)
+		start = mdb_nsec();
 	if (!F_ISSET(txn->mt_flags, MDB_TXN_NOSYNC) &&
 		(rc = mdb_env_sync0(env, 0, txn->mt_next_pgno)))
-		goto fail;
-	if ((rc = mdb_env_write_meta(txn)))
-		goto fail;
-	end_mode = MDB_END_COMMITTED|MDB_END_UPDATE;
+		return rc;
+	if (cs) {
+		cs->ms_sync_time = mdb_nsec() - start;
+		start += cs->ms_sync_time;
+	}
+	rc = mdb_env_write_meta(txn);
+	if (cs)
+		cs->ms_meta_time = mdb_nsec() - start;
+	return rc;
+}
+
+/** End a transaction committed by #mdb_txn_prepare0() and #mdb_txn_sync0().
+ * @param[in] txn the committed transaction
+ * @return 0 on success, non-zero on failure. The txn isn't ended on failure.
+ */
+static int
+mdb_txn_finish0(MDB_txn *txn)
+{
+	MDB_env	*env = txn->mt_env;
+
+	if (!(txn->mt_flags & MDB_TXN_PREPARED)) {
+		mdb_txn_end(txn, MDB_END_EMPTY_COMMIT|MDB_END_UPDATE|MDB_END_SLOT|MDB_END_FREE);
+		return MDB_SUCCESS;
+	}
 	if (env->me_flags & MDB_PREVSNAPSHOT) {
 		if (!(env->me_flags & MDB_NOLOCK)) {
 			int excl;
-			rc = mdb_env_share_locks(env, &excl);
+			int rc = mdb_env_share_locks(env, &excl);
 			if (rc)
-				goto fail;
+				return rc;
 		}
 		env->me_flags ^= MDB_PREVSNAPSHOT;
 	}
-
-done:
-	mdb_txn_end(txn, end_mode);
+	mdb_txn_end(txn, MDB_END_COMMITTED|MDB_END_UPDATE);
 	return MDB_SUCCESS;
+}
 
-fail:
-	mdb_txn_abort(txn);
+int
+mdb_txn_commit_prepare(MDB_txn *txn)
+{
+	int rc;
+
+	if (txn == NULL)
+		return EINVAL;
+
+	if (txn->mt_parent || (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_HAS_CHILD)))
+		rc = EINVAL;
+	else if (txn->mt_flags & (MDB_TXN_FINISHED|MDB_TXN_ERROR|MDB_TXN_PREPARED))
+		rc = MDB_BAD_TXN;
+	else
+		rc = mdb_txn_prepare0(txn);
+	if (rc)
+		mdb_txn_abort(txn);
+	return rc;
+}
+
+int
+mdb_txn_commit_sync(MDB_txn *txn)
+{
+	if (txn == NULL)
+		return EINVAL;
+	return mdb_txn_sync0(txn);
+}
+
+int
+mdb_txn_commit_finish(MDB_txn *txn, int rc)
+{
+	if (txn == NULL)
+		return EINVAL;
+
+	if (!rc)
+		rc = mdb_txn_finish0(txn);
+	if (rc)
+		mdb_txn_abort(txn);
 	return rc;
 }
 
@@ -4430,6 +4647,7 @@ mdb_env_create(MDB_env **env)
 	e->me_pid = getpid();
 	GET_PAGESIZE(e->me_os_psize);
 	VGMEMP_CREATE(e,0,0);
+	mdb_scan_init();
 	*env = e;
 	return MDB_SUCCESS;
 }
@@ -4523,6 +4741,10 @@ mdb_env_map(MDB_env *env, void *addr)
 		if (ftruncate(env->me_fd, env->me_mapsize) < 0)
 			return ErrCode();
 	}
+#ifdef MAP_POPULATE
+	if (env->me_mapflags & MDB_MAP_POPULATE)
+		mmap_flags |= MAP_POPULATE;
+#endif
 	env->me_map = mmap(addr, env->me_mapsize, prot, mmap_flags,
 		env->me_fd, 0);
 	if (env->me_map == MAP_FAILED) {
@@ -4540,6 +4762,12 @@ mdb_env_map(MDB_env *env, void *addr)
 #endif /* POSIX_MADV_RANDOM */
 #endif /* MADV_RANDOM */
 	}
+#ifdef MADV_HUGEPAGE
+	if (env->me_mapflags & MDB_MAP_HUGEPAGE) {
+		/* Only a hint, file mappings get huge pages on few filesystems */
+		madvise(env->me_map, env->me_mapsize, MADV_HUGEPAGE);
+	}
+#endif
 #endif /* _WIN32 */
 
 	/* Can happen because the address argument to mmap() is just a
@@ -4599,6 +4827,15 @@ mdb_env_set_mapsize(MDB_env *env, mdb_size_t size)
 	return MDB_SUCCESS;
 }
 
+int ESECT
+mdb_env_set_mapflags(MDB_env *env, unsigned int flags)
+{
+	if (env->me_map || (flags & ~(MDB_MAP_POPULATE|MDB_MAP_HUGEPAGE)))
+		return EINVAL;
+	env->me_mapflags = flags;
+	return MDB_SUCCESS;
+}
+
 int ESECT
 mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs)
 {
@@ -5948,15 +6185,338 @@ mdb_cmp_memnr(const MDB_val *a, const MDB_val *b)
 	return len_diff<0 ? -1 : len_diff;
 }
 
+/** Compare two items lexically, like #mdb_cmp_memn(), when their
+ *	first \b skip bytes are known to be equal.
+ *	Stores the length of the common prefix of both items in \b *lcp.
+ */
+static int
+mdb_cmp_memn_lcp(const MDB_val *a, const MDB_val *b, size_t skip, size_t *lcp)
+{
+	const unsigned char *p1, *p2;
+	size_t len, n, w1[4], w2[4];
+
+	p1 = (const unsigned char *)a->mv_data;
+	p2 = (const unsigned char *)b->mv_data;
+	len = a->mv_size < b->mv_size ? a->mv_size : b->mv_size;
+
+	/* Find the first word that differs, four words at a time */
+	for (n = skip; n + sizeof(w1) <= len; n += sizeof(w1)) {
+		memcpy(w1, p1 + n, sizeof(w1));
+		memcpy(w2, p2 + n, sizeof(w2));
+		if ((w1[0] ^ w2[0]) | (w1[1] ^ w2[1]) |
+			(w1[2] ^ w2[2]) | (w1[3] ^ w2[3]))
+			break;
+	}
+	for (; n + sizeof(size_t) <= len; n += sizeof(size_t)) {
+		memcpy(w1, p1 + n, sizeof(size_t));
+		memcpy(w2, p2 + n, sizeof(size_t));
+		if (w1[0] != w2[0])
+			break;
+	}
+	while (n < len && p1[n] == p2[n])
+		n++;
+	*lcp = n;
+	if (n < len)
+		return p1[n] - p2[n];
+	return a->mv_size < b->mv_size ? -1 : a->mv_size > b->mv_size;
+}
+
+#ifndef MDB_INLINE_CMP
+	/**	Inline the default comparisons into #mdb_node_search().
+	 *	Set this to 0 to call \b md_cmp for every key instead,
+	 *	which is what the debug output of the search needs.
+	 */
+#define MDB_INLINE_CMP	(!(MDB_DEBUG))
+#endif
+
+	/**	How #mdb_node_search() compares the keys of a page. */
+enum {
+	MDB_SEARCH_CALL,	/**< call \b md_cmp */
+	MDB_SEARCH_MEMN,	/**< #mdb_cmp_memn_lcp() skipping the common prefix */
+	MDB_SEARCH_UINT,	/**< compare unsigned ints */
+	MDB_SEARCH_SIZE 	/**< compare #mdb_size_t's */
+};
+
+	/**	The binary search of #mdb_node_search().
+	 *	\b KEY points \b nodekey at the key of node \b i,
+	 *	\b CMP compares \b key with it and stores the result in \b rc.
+	 */
+#define MDB_BSEARCH(KEY, CMP)	do { \
+	while (low <= high) { \
+		i = (low + high) >> 1; \
+		KEY; \
+		CMP; \
+		if (rc == 0) \
+			break; \
+		if (rc > 0) \
+			low = i + 1; \
+		else \
+			high = i - 1; \
+	} \
+} while (0)
+
+	/**	Compare \b key with \b nodekey as in #MDB_SEARCH_MEMN.
+	 *	All the keys between two keys share the prefix that both of
+	 *	them share with \b key, so only the rest needs comparing.
+	 */
+#define MDB_CMP_LCP	do { \
+	rc = mdb_cmp_memn_lcp(key, &nodekey, llcp < hlcp ? llcp : hlcp, &lcp); \
+	if (rc > 0) \
+		llcp = lcp; \
+	else if (rc < 0) \
+		hlcp = lcp; \
+} while (0)
+
+	/**	Compare \b key with \b nodekey as in #MDB_SEARCH_UINT or
+	 *	#MDB_SEARCH_SIZE. The value of \b key is in \b kval.
+	 */
+#define MDB_CMP_NUM(type)	do { \
+	type nval; \
+	memcpy(&nval, nodekey.mv_data, sizeof(type)); \
+	rc = ((type)kval < nval) ? -1 : (type)kval > nval; \
+} while (0)
+
+	/**	Point \b nodekey at the key of node \b i of a regular page. */
+#define MDB_NODE_KEY	do { \
+	node = NODEPTR(mp, i); \
+	nodekey.mv_size = NODEKSZ(node); \
+	nodekey.mv_data = NODEKEY(node); \
+} while (0)
+
+	/**	Point \b nodekey at key \b i of an #MDB_DUPFIXED page. */
+#define MDB_LEAF2_KEY	(nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size))
+
+/** @defgroup simd	Integer Key Scans
+ *	@ingroup internal
+ *	The search of an #MDB_DUPFIXED page of integers narrows the keys
+ *	down to #MDB_SCAN_KEYS with a binary search, then counts how many of
+ *	them are below the key, several keys per instruction where the CPU
+ *	supports it. The count is the index of the key.
+ *	@{
+ */
+#ifndef MDB_SCAN_KEYS
+	/**	How many integer keys #mdb_leaf2_search() counts at the end. */
+#define MDB_SCAN_KEYS	32
+#endif
+
+	/**	Count the \b n integer keys at \b keys that are below \b kval.
+	 *	Keys may be unaligned, since sub-pages are only 2-byte aligned.
+	 */
+typedef unsigned int (MDB_scan_func)(const char *keys, unsigned int n, uint64_t kval);
+
+static unsigned int
+mdb_scan_int(const char *keys, unsigned int n, uint64_t kval)
+{
+	unsigned int j, rank = 0, u;
+
+	for (j = 0; j < n; j++) {
+		memcpy(&u, keys + j * sizeof(u), sizeof(u));
+		rank += u < kval;
+	}
+	return rank;
+}
+
+static unsigned int
+mdb_scan_long(const char *keys, unsigned int n, uint64_t kval)
+{
+	unsigned int j, rank = 0;
+	uint64_t u;
+
+	for (j = 0; j < n; j++) {
+		memcpy(&u, keys + j * sizeof(u), sizeof(u));
+		rank += u < kval;
+	}
+	return rank;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MDB_SCAN_X86	1
+#include <immintrin.h>
+
+	/* SSE and AVX2 only compare signed integers, so both sides are
+	 * biased by the sign bit first.
+	 */
+__attribute__((target("sse4.2,popcnt"))) static unsigned int
+mdb_scan_int_sse4(const char *keys, unsigned int n, uint64_t kval)
+{
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	const __m128i k = _mm_xor_si128(_mm_set1_epi32((int)kval), bias);
+	unsigned int j, rank = 0;
+
+	for (j = 0; j + 4 <= n; j += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(keys + j * 4));
+		v = _mm_xor_si128(v, bias);
+		rank += _mm_popcnt_u32(_mm_movemask_ps(
+			_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))));
+	}
+	return rank + mdb_scan_int(keys + j * 4, n - j, kval);
+}
+
+__attribute__((target("sse4.2,popcnt"))) static unsigned int
+mdb_scan_long_sse4(const char *keys, unsigned int n, uint64_t kval)
+{
+	const __m128i bias = _mm_set1_epi64x((long long)0x8000000000000000ULL);
+	const __m128i k = _mm_xor_si128(_mm_set1_epi64x((long long)kval), bias);
+	unsigned int j, rank = 0;
+
+	for (j = 0; j + 2 <= n; j += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(keys + j * 8));
+		v = _mm_xor_si128(v, bias);
+		rank += _mm_popcnt_u32(_mm_movemask_pd(
+			_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))));
+	}
+	return rank + mdb_scan_long(keys + j * 8, n - j, kval);
+}
+
+__attribute__((target("avx2,popcnt"))) static unsigned int
+mdb_scan_int_avx2(const char *keys, unsigned int n, uint64_t kval)
+{
+	const __m256i bias = _mm256_set1_epi32((int)0x80000000);
+	const __m256i k = _mm256_xor_si256(_mm256_set1_epi32((int)kval), bias);
+	unsigned int j, rank = 0;
+
+	for (j = 0; j + 8 <= n; j += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(keys + j * 4));
+		v = _mm256_xor_si256(v, bias);
+		rank += _mm_popcnt_u32(_mm256_movemask_ps(
+			_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+	}
+	return rank + mdb_scan_int(keys + j * 4, n - j, kval);
+}
+
+__attribute__((target("avx2,popcnt"))) static unsigned int
+mdb_scan_long_avx2(const char *keys, unsigned int n, uint64_t kval)
+{
+	const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+	const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)kval), bias);
+	unsigned int j, rank = 0;
+
+	for (j = 0; j + 4 <= n; j += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(keys + j * 8));
+		v = _mm256_xor_si256(v, bias);
+		rank += _mm_popcnt_u32(_mm256_movemask_pd(
+			_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))));
+	}
+	return rank + mdb_scan_long(keys + j * 8, n - j, kval);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MDB_SCAN_NEON	1
+#include <arm_neon.h>
+
+	/* Compares give all ones for each key below, so subtracting them
+	 * counts the keys in each lane.
+	 */
+static unsigned int
+mdb_scan_int_neon(const char *keys, unsigned int n, uint64_t kval)
+{
+	const uint32x4_t k = vdupq_n_u32((uint32_t)kval);
+	uint32x4_t count = vdupq_n_u32(0);
+	unsigned int j;
+
+	for (j = 0; j + 4 <= n; j += 4) {
+		uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8((const uint8_t *)keys + j * 4));
+		count = vsubq_u32(count, vcltq_u32(v, k));
+	}
+	return vaddvq_u32(count) + mdb_scan_int(keys + j * 4, n - j, kval);
+}
+
+static unsigned int
+mdb_scan_long_neon(const char *keys, unsigned int n, uint64_t kval)
+{
+	const uint64x2_t k = vdupq_n_u64(kval);
+	uint64x2_t count = vdupq_n_u64(0);
+	unsigned int j;
+
+	for (j = 0; j + 2 <= n; j += 2) {
+		uint64x2_t v = vreinterpretq_u64_u8(vld1q_u8((const uint8_t *)keys + j * 8));
+		count = vsubq_u64(count, vcltq_u64(v, k));
+	}
+	return (unsigned int)vaddvq_u64(count) + mdb_scan_long(keys + j * 8, n - j, kval);
+}
+#endif
+
+	/**	The scans for 4- and 8-byte keys, set by #mdb_scan_init(). */
+static MDB_scan_func *mdb_scan_ints = mdb_scan_int, *mdb_scan_longs = mdb_scan_long;
+
+	/**	Pick the scans for this CPU. Called by #mdb_env_create(),
+	 *	every call stores the same pointers.
+	 */
+static void
+mdb_scan_init(void)
+{
+#if defined(MDB_SCAN_X86)
+	if (__builtin_cpu_supports("avx2")) {
+		mdb_scan_ints = mdb_scan_int_avx2;
+		mdb_scan_longs = mdb_scan_long_avx2;
+	} else if (__builtin_cpu_supports("sse4.2")) {
+		mdb_scan_ints = mdb_scan_int_sse4;
+		mdb_scan_longs = mdb_scan_long_sse4;
+	}
+#elif defined(MDB_SCAN_NEON)
+	mdb_scan_ints = mdb_scan_int_neon;
+	mdb_scan_longs = mdb_scan_long_neon;
+#endif
+}
+
+	/**	Read key \b i of the integer keys at \b keys. */
+static uint64_t
+mdb_leaf2_int(const char *keys, unsigned int i, unsigned int ksize)
+{
+	unsigned int u;
+	uint64_t l;
+
+	if (ksize == sizeof(u)) {
+		memcpy(&u, keys + i * sizeof(u), sizeof(u));
+		return u;
+	}
+	memcpy(&l, keys + i * sizeof(l), sizeof(l));
+	return l;
+}
+
+/** Search the \b nkeys integer keys of size \b ksize on an
+ *	#MDB_DUPFIXED page for \b kval.
+ *	Returns the index of the first key that is not below \b kval,
+ *	and stores 0 in \b *rcp if that key is \b kval, or -1 if not.
+ */
+static unsigned int
+mdb_leaf2_search(MDB_page *mp, unsigned int nkeys, unsigned int ksize,
+	uint64_t kval, int *rcp)
+{
+	const char *keys = LEAF2KEY(mp, 0, ksize);
+	unsigned int low = 0, high = nkeys, mid;
+
+	/* The keys before low are below kval, the keys from high are not */
+	while (high - low > MDB_SCAN_KEYS) {
+		mid = (low + high) >> 1;
+		if (mdb_leaf2_int(keys, mid, ksize) < kval)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	low += (ksize == sizeof(unsigned int) ? mdb_scan_ints : mdb_scan_longs)
+		(keys + low * ksize, high - low, kval);
+	*rcp = (low < nkeys && mdb_leaf2_int(keys, low, ksize) == kval) ? 0 : -1;
+	return low;
+}
+/** @} */
+
 /** Search for key within a page, using binary search.
  * Returns the smallest entry larger or equal to the key.
  * If exactp is non-null, stores whether the found entry was an exact match
  * in *exactp (1 or 0).
  * Updates the cursor index with the index of the found entry.
  * If no entry larger or equal to the key is found, returns NULL.
+ *
+ * If lcpp is non-null, it holds the length of a prefix that all keys
+ * on the page are known to share with the key, and the comparisons skip
+ * it. It is updated to the prefix that all keys from the found entry up
+ * to the next entry share with the key, which holds for the child page
+ * when searching a branch page.
  */
 static MDB_node *
-mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
+mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp, size_t *lcpp)
 {
 	unsigned int	 i = 0, nkeys;
 	int		 low, high;
@@ -5965,6 +6525,9 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 	MDB_node	*node = NULL;
 	MDB_val	 nodekey;
 	MDB_cmp_func *cmp;
+	int		 how = MDB_SEARCH_CALL;
+	size_t	 llcp = 0, hlcp = 0, lcp;
+	mdb_size_t	 kval = 0;
 	DKBUF;
 
 	nkeys = NUMKEYS(mp);
@@ -5976,6 +6539,8 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 	low = IS_LEAF(mp) ? 0 : 1;
 	high = nkeys - 1;
 	cmp = mc->mc_dbx->md_cmp;
+	if (lcpp)
+		llcp = hlcp = *lcpp;
 
 	/* Branch pages have no data, so if using integer keys,
 	 * alignment is guaranteed. Use faster mdb_cmp_int.
@@ -5987,48 +6552,102 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 			cmp = mdb_cmp_int;
 	}
 
+#if MDB_INLINE_CMP
+	/* Don't call the default comparisons through the pointer.
+	 * Integer keys are read once, and with memcpy() since leaf
+	 * nodes only guarantee 2-byte alignment.
+	 */
+	if (cmp == mdb_cmp_memn) {
+		how = MDB_SEARCH_MEMN;
+	} else if (cmp == mdb_cmp_int ||
+		(cmp == mdb_cmp_cint && key->mv_size == sizeof(unsigned int))) {
+		unsigned int u;
+		memcpy(&u, key->mv_data, sizeof(u));
+		kval = u;
+		how = MDB_SEARCH_UINT;
+	} else if (cmp == mdb_cmp_long ||
+		(cmp == mdb_cmp_cint && key->mv_size == sizeof(mdb_size_t))) {
+		memcpy(&kval, key->mv_data, sizeof(kval));
+		how = MDB_SEARCH_SIZE;
+	}
+#endif
+
 	if (IS_LEAF2(mp)) {
 		nodekey.mv_size = mc->mc_db->md_pad;
 		node = NODEPTR(mp, 0);	/* fake */
-		while (low <= high) {
-			i = (low + high) >> 1;
-			nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size);
-			rc = cmp(key, &nodekey);
-			DPRINTF(("found leaf index %u [%s], rc = %i",
-			    i, DKEY(&nodekey), rc));
-			if (rc == 0)
+		switch (how) {
+		case MDB_SEARCH_MEMN:
+			MDB_BSEARCH(MDB_LEAF2_KEY, MDB_CMP_LCP);
+			break;
+		case MDB_SEARCH_UINT:
+			if (nodekey.mv_size == sizeof(unsigned int)) {
+				i = mdb_leaf2_search(mp, nkeys, sizeof(unsigned int), kval, &rc);
 				break;
-			if (rc > 0)
-				low = i + 1;
-			else
-				high = i - 1;
-		}
-	} else {
-		while (low <= high) {
-			i = (low + high) >> 1;
-
-			node = NODEPTR(mp, i);
-			nodekey.mv_size = NODEKSZ(node);
-			nodekey.mv_data = NODEKEY(node);
-
-			rc = cmp(key, &nodekey);
-#if MDB_DEBUG
-			if (IS_LEAF(mp))
+			}
+			MDB_BSEARCH(MDB_LEAF2_KEY, MDB_CMP_NUM(unsigned int));
+			break;
+		case MDB_SEARCH_SIZE:
+			if (nodekey.mv_size == sizeof(mdb_size_t)) {
+				i = mdb_leaf2_search(mp, nkeys, sizeof(mdb_size_t), kval, &rc);
+				break;
+			}
+			MDB_BSEARCH(MDB_LEAF2_KEY, MDB_CMP_NUM(mdb_size_t));
+			break;
+		default:
+			while (low <= high) {
+				i = (low + high) >> 1;
+				nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size);
+				rc = cmp(key, &nodekey);
 				DPRINTF(("found leaf index %u [%s], rc = %i",
 				    i, DKEY(&nodekey), rc));
-			else
-				DPRINTF(("found branch index %u [%s -> %"Yu"], rc = %i",
-				    i, DKEY(&nodekey), NODEPGNO(node), rc));
+				if (rc == 0)
+					break;
+				if (rc > 0)
+					low = i + 1;
+				else
+					high = i - 1;
+			}
+		}
+	} else {
+		switch (how) {
+		case MDB_SEARCH_MEMN:
+			MDB_BSEARCH(MDB_NODE_KEY, MDB_CMP_LCP);
+			break;
+		case MDB_SEARCH_UINT:
+			MDB_BSEARCH(MDB_NODE_KEY, MDB_CMP_NUM(unsigned int));
+			break;
+		case MDB_SEARCH_SIZE:
+			MDB_BSEARCH(MDB_NODE_KEY, MDB_CMP_NUM(mdb_size_t));
+			break;
+		default:
+			while (low <= high) {
+				i = (low + high) >> 1;
+
+				node = NODEPTR(mp, i);
+				nodekey.mv_size = NODEKSZ(node);
+				nodekey.mv_data = NODEKEY(node);
+
+				rc = cmp(key, &nodekey);
+#if MDB_DEBUG
+				if (IS_LEAF(mp))
+					DPRINTF(("found leaf index %u [%s], rc = %i",
+					    i, DKEY(&nodekey), rc));
+				else
+					DPRINTF(("found branch index %u [%s -> %"Yu"], rc = %i",
+					    i, DKEY(&nodekey), NODEPGNO(node), rc));
 #endif
-			if (rc == 0)
-				break;
-			if (rc > 0)
-				low = i + 1;
-			else
-				high = i - 1;
+				if (rc == 0)
+					break;
+				if (rc > 0)
+					low = i + 1;
+				else
+					high = i - 1;
+			}
 		}
 	}
 
+	if (lcpp)
+		*lcpp = how == MDB_SEARCH_MEMN ? (llcp < hlcp ? llcp : hlcp) : 0;
 	if (rc > 0) {	/* Found entry is less than the key. */
 		i++;	/* Skip to get the smallest entry larger than key. */
 		if (!IS_LEAF2(mp))
@@ -6466,6 +7085,7 @@ static int
 mdb_page_search_root(MDB_cursor *mc, MDB_val *key, int flags)
 {
 	MDB_page	*mp = mc->mc_pg[mc->mc_top];
+	size_t	 lcp = 0;
 	int rc;
 	DKBUF;
 
@@ -6496,7 +7116,7 @@ mdb_page_search_root(MDB_cursor *mc, MDB_val *key, int flags)
 			}
 		} else {
 			int	 exact;
-			node = mdb_node_search(mc, key, &exact);
+			node = mdb_node_search(mc, key, &exact, &lcp);
 			if (node == NULL)
 				i = NUMKEYS(mp) - 1;
 			else {
@@ -6536,6 +7156,7 @@ ready:
 
 	DPRINTF(("found leaf page %"Yu" for key [%s]", mp->mp_pgno,
 	    key ? DKEY(key) : "null"));
+	mc->mc_lcp = lcp;
 	mc->mc_flags |= C_INITIALIZED;
 	mc->mc_flags &= ~C_EOF;
 
@@ -6602,7 +7223,7 @@ mdb_page_search(MDB_cursor *mc, MDB_val *key, int flags)
 					int exact = 0;
 					uint16_t flags;
 					MDB_node *leaf = mdb_node_search(&mc2,
-						&mc->mc_dbx->md_name, &exact);
+						&mc->mc_dbx->md_name, &exact, NULL);
 					if (!exact)
 						return MDB_NOTFOUND;
 					if ((leaf->mn_flags & (F_DUPDATA|F_SUBDATA)) != F_SUBDATA)
@@ -7057,6 +7678,7 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 	int		 rc;
 	MDB_page	*mp;
 	MDB_node	*leaf = NULL;
+	size_t	*lcpp = NULL;
 	DKBUF;
 
 	if (key->mv_size == 0)
@@ -7167,9 +7789,10 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 
 	mp = mc->mc_pg[mc->mc_top];
 	mdb_cassert(mc, IS_LEAF(mp));
+	lcpp = &mc->mc_lcp;
 
 set2:
-	leaf = mdb_node_search(mc, key, exactp);
+	leaf = mdb_node_search(mc, key, exactp, lcpp);
 	if (exactp != NULL && !*exactp) {
 		/* MDB_SET specified and not an exact match. */
 		return MDB_NOTFOUND;
@@ -8742,6 +9365,172 @@ mdb_cursor_count(MDB_cursor *mc, mdb_size_t *countp)
 	return MDB_SUCCESS;
 }
 
+/** Get the relative weight of an entry of a page on a cursor's path.
+ *	Entries of branch pages whose children are branch pages too are weighted
+ *	by the number of keys of their child. Entries lower in the tree all weigh
+ *	the same, since telling them apart would touch every leaf page.
+ * @param[in] mc The cursor whose path the page is on.
+ * @param[in] depth The depth of the page.
+ * @param[in] idx The index of the entry.
+ * @param[out] weight The weight of the entry.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_entry_weight(MDB_cursor *mc, int depth, unsigned int idx, double *weight)
+{
+	MDB_page	*child;
+	int rc;
+
+	if (depth + 2 >= (int)mc->mc_db->md_depth) {
+		*weight = 1.0;
+		return MDB_SUCCESS;
+	}
+	rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mc->mc_pg[depth], idx)), &child, NULL);
+	if (rc == MDB_SUCCESS)
+		*weight = NUMKEYS(child);
+	return rc;
+}
+
+/** Weigh the entries of a page on a cursor's path.
+ * @param[in] mc The cursor whose path the page is on.
+ * @param[in] depth The depth of the page.
+ * @param[in] ki The index of the entry of interest.
+ * @param[out] before The total weight of the entries before \b ki.
+ * @param[out] own The weight of the entry at \b ki.
+ * @param[out] total The total weight of all entries of the page.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_weigh(MDB_cursor *mc, int depth, unsigned int ki,
+	double *before, double *own, double *total)
+{
+	unsigned int i, nkeys = NUMKEYS(mc->mc_pg[depth]);
+	double w;
+	int rc;
+
+	if (depth + 2 >= (int)mc->mc_db->md_depth) {
+		*before = ki;
+		*own = 1.0;
+		*total = nkeys;
+		return MDB_SUCCESS;
+	}
+
+	*before = *own = *total = 0.0;
+	for (i = 0; i < nkeys; i++) {
+		if ((rc = mdb_entry_weight(mc, depth, i, &w)) != 0)
+			return rc;
+		if (i < ki)
+			*before += w;
+		else if (i == ki)
+			*own = w;
+		*total += w;
+	}
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_pos(MDB_cursor *mc, double *posp)
+{
+	double pos = 0.0, scale = 1.0, before, own, total;
+	unsigned int ki;
+	int i, rc;
+
+	if (mc == NULL || posp == NULL)
+		return EINVAL;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	if (!(mc->mc_flags & C_INITIALIZED))
+		return EINVAL;
+
+	if (!mc->mc_snum || (mc->mc_flags & C_EOF)) {
+		*posp = mc->mc_snum ? 1.0 : 0.0;
+		return MDB_SUCCESS;
+	}
+
+	/* Each level splits the share of the page it is on between its
+	 * entries, in proportion to their weight.
+	 */
+	for (i = 0; i <= mc->mc_top; i++) {
+		ki = mc->mc_ki[i];
+		if (ki >= NUMKEYS(mc->mc_pg[i])) {
+			pos += scale;
+			break;
+		}
+		if ((rc = mdb_page_weigh(mc, i, ki, &before, &own, &total)) != 0)
+			return rc;
+		pos += scale * before / total;
+		scale *= own / total;
+	}
+	*posp = pos < 1.0 ? pos : 1.0;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_set_pos(MDB_cursor *mc, double pos, MDB_val *key, MDB_val *data)
+{
+	MDB_page	*mp;
+	MDB_node	*node;
+	MDB_val		 k;
+	double		 before, own, total;
+	unsigned int nkeys, ki;
+	int i, rc;
+
+	if (mc == NULL || key == NULL)
+		return EINVAL;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	mc->mc_flags &= ~(C_INITIALIZED|C_EOF);
+	rc = mdb_page_search(mc, NULL, MDB_PS_ROOTONLY);
+	if (rc)
+		return rc;
+
+	pos = pos < 0.0 ? 0.0 : pos > 1.0 ? 1.0 : pos;
+
+	/* The inverse of mdb_cursor_pos(): at each level pick the entry
+	 * whose share of the page contains the position, then continue
+	 * with the position relative to that entry's share.
+	 */
+	for (i = 0;; i++) {
+		mp = mc->mc_pg[i];
+		nkeys = NUMKEYS(mp);
+		if ((rc = mdb_page_weigh(mc, i, 0, &before, &own, &total)) != 0)
+			return rc;
+		pos *= total;
+		for (ki = 0;; ki++) {
+			if ((rc = mdb_entry_weight(mc, i, ki, &own)) != 0)
+				return rc;
+			if (pos < own || ki == nkeys - 1)
+				break;
+			pos -= own;
+		}
+		pos = own > 0.0 ? pos / own : 0.0;
+		pos = pos < 0.0 ? 0.0 : pos > 1.0 ? 1.0 : pos;
+		mc->mc_ki[i] = ki;
+		if (IS_LEAF(mp))
+			break;
+		node = NODEPTR(mp, ki);
+		if ((rc = mdb_page_get(mc, NODEPGNO(node), &mp, NULL)) != 0)
+			return rc;
+		if ((rc = mdb_cursor_push(mc, mp)))
+			return rc;
+	}
+
+	/* Let a regular lookup of the key found there set up the cursor */
+	if (IS_LEAF2(mp)) {
+		k.mv_size = mc->mc_db->md_pad;
+		k.mv_data = LEAF2KEY(mp, ki, k.mv_size);
+	} else {
+		node = NODEPTR(mp, ki);
+		MDB_GET_KEY2(node, k);
+	}
+	*key = k;
+	return mdb_cursor_get(mc, key, data, MDB_SET_KEY);
+}
+
 void
 mdb_cursor_close(MDB_cursor *mc)
 {
@@ -10617,6 +11406,233 @@ mdb_env_copy(MDB_env *env, const char *path)
 	return mdb_env_copy2(env, path, 0);
 }
 
+int ESECT
+mdb_env_walk_pages(MDB_env *env, MDB_page_func *func, void *ctx, MDB_envinfo *info)
+{
+#ifdef MDB_VL32
+	/* Only the meta pages are mapped */
+	return ENOTSUP;
+#else
+	MDB_txn *txn = NULL;
+	mdb_mutexref_t wmutex = NULL;
+	char *metas;
+	mdb_size_t npages, fsize = 0;
+	int rc;
+
+	if (!env || !func || !info)
+		return EINVAL;
+
+	metas = malloc(env->me_psize * NUM_METAS);
+	if (!metas)
+		return ENOMEM;
+
+	/* Same as in #mdb_env_copyfd0(): the meta pages are taken
+	 * while writers are blocked, so they match the snapshot.
+	 */
+	rc = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+	if (rc) {
+		free(metas);
+		return rc;
+	}
+
+	if (env->me_txns) {
+		mdb_txn_end(txn, MDB_END_RESET_TMP);
+
+		wmutex = env->me_wmutex;
+		if (LOCK_MUTEX(rc, env, wmutex))
+			goto leave;
+
+		rc = mdb_txn_renew0(txn);
+		if (rc) {
+			UNLOCK_MUTEX(wmutex);
+			goto leave;
+		}
+	}
+	memcpy(metas, env->me_map, env->me_psize * NUM_METAS);
+	if (wmutex)
+		UNLOCK_MUTEX(wmutex);
+
+	npages = txn->mt_next_pgno;
+	if ((rc = mdb_fsize(env->me_fd, &fsize)))
+		goto leave;
+	if (npages > fsize / env->me_psize)
+		npages = fsize / env->me_psize;
+
+	mdb_env_info(env, info);
+	info->me_last_pgno = npages - 1;
+	info->me_last_txnid = txn->mt_txnid;
+
+	rc = func(ctx, 0, metas, NUM_METAS);
+	if (rc == MDB_SUCCESS && npages > NUM_METAS)
+		rc = func(ctx, NUM_METAS, env->me_map + env->me_psize * NUM_METAS, npages - NUM_METAS);
+
+leave:
+	mdb_txn_abort(txn);
+	free(metas);
+	return rc;
+#endif
+}
+
+int ESECT
+mdb_env_replace_file(MDB_env *env, const char *path, mdb_size_t txnid)
+{
+#if defined(_WIN32)
+	/* A mapped file can't be replaced, and the lockfile
+	 * lock can't be upgraded to check for other processes.
+	 */
+	return ERROR_NOT_SUPPORTED;
+#elif defined(MDB_VL32)
+	return ENOTSUP;
+#else
+	MDB_name fname = {0}, tname;
+	mdb_mutexref_t wmutex = NULL;
+	struct flock lock_info;
+	MDB_page *mp, *newest = NULL;
+	MDB_meta *mm, meta;
+	HANDLE fd = INVALID_HANDLE_VALUE, newfd = INVALID_HANDLE_VALUE, newmfd = INVALID_HANDLE_VALUE;
+	char *metas = NULL;
+	size_t msize;
+	txnid_t last;
+	unsigned int i;
+	int rc, excl = 0;
+	void *old;
+
+	if (!env || !path || !env->me_map || env->me_txn)
+		return EINVAL;
+	if (env->me_flags & MDB_RDONLY)
+		return EACCES;
+
+	msize = env->me_psize * NUM_METAS;
+	metas = malloc(msize);
+	if (!metas)
+		return ENOMEM;
+
+	if (env->me_txns) {
+		/* Block writers until the file is replaced */
+		wmutex = env->me_wmutex;
+		if (LOCK_MUTEX(rc, env, wmutex)) {
+			free(metas);
+			return rc;
+		}
+
+		/* Other processes would keep using the old file.
+		 * Like in #mdb_env_excl_lock(), nobody else has the
+		 * environment open if the lockfile lock can be upgraded.
+		 */
+		memset((void *)&lock_info, 0, sizeof(lock_info));
+		lock_info.l_type = F_WRLCK;
+		lock_info.l_whence = SEEK_SET;
+		lock_info.l_start = 0;
+		lock_info.l_len = 1;
+		while ((rc = fcntl(env->me_lfd, F_SETLK, &lock_info)) &&
+				(rc = ErrCode()) == EINTR) ;
+		if (rc) {
+			rc = EBUSY;
+			goto leave;
+		}
+		excl = 1;
+
+		/* No reader may use the map meanwhile */
+		for (i = 0; i < env->me_txns->mti_numreaders; i++) {
+			MDB_reader *mr = &env->me_txns->mti_readers[i];
+			if (mr->mr_pid && mr->mr_txnid != (txnid_t)-1) {
+				rc = EBUSY;
+				goto leave;
+			}
+		}
+		last = env->me_txns->mti_txnid;
+	} else {
+		last = mdb_env_pick_meta(env)->mm_txnid;
+	}
+
+	/* The copy is missing whatever was committed since */
+	if (last != txnid) {
+		rc = EAGAIN;
+		goto leave;
+	}
+
+	/* Open the copy, before it replaces the file */
+	rc = mdb_fname_init(path, MDB_NOSUBDIR|MDB_NOLOCK, &tname);
+	if (rc)
+		goto leave;
+	rc = mdb_fopen(env, &tname, MDB_O_RDWR, 0, &fd);
+	if (rc == MDB_SUCCESS)
+		rc = mdb_fopen(env, &tname, MDB_O_META, 0, &newmfd);
+	mdb_fname_destroy(tname);
+	if (rc)
+		goto leave;
+
+	/* Stamp the meta pages of the copy with the current txnid,
+	 * so that it matches the lockfile. A compacted copy has txnid 1.
+	 */
+	if (pread(fd, metas, msize, 0) != (ssize_t)msize) {
+		rc = MDB_INVALID;
+		goto leave;
+	}
+	for (i = 0; i < NUM_METAS; i++) {
+		mp = (MDB_page *)(metas + i * env->me_psize);
+		mm = (MDB_meta *)METADATA(mp);
+		if (!F_ISSET(mp->mp_flags, P_META) || mm->mm_magic != MDB_MAGIC ||
+			mm->mm_version != MDB_DATA_VERSION || mm->mm_psize != env->me_psize) {
+			rc = MDB_INVALID;
+			goto leave;
+		}
+		if (!newest || mm->mm_txnid > ((MDB_meta *)METADATA(newest))->mm_txnid)
+			newest = mp;
+	}
+	meta = *(MDB_meta *)METADATA(newest);
+	for (i = 0; i < NUM_METAS; i++) {
+		mp = (MDB_page *)(metas + i * env->me_psize);
+		mm = (MDB_meta *)METADATA(mp);
+		*mm = meta;
+		mm->mm_txnid = (i == (txnid & 1)) ? txnid : (txnid ? txnid - 1 : 0);
+	}
+	if (pwrite(fd, metas, msize, 0) != (ssize_t)msize || MDB_FDATASYNC(fd)) {
+		rc = ErrCode();
+		goto leave;
+	}
+
+	rc = mdb_fname_init(env->me_path, env->me_flags | MDB_NOLOCK, &fname);
+	if (rc)
+		goto leave;
+	if (fname.mn_alloced)
+		mdb_name_cpy(fname.mn_val + fname.mn_len, mdb_suffixes[0][0]);
+	if (rename(path, fname.mn_val)) {
+		rc = ErrCode();
+		goto leave;
+	}
+
+	/* From here on, the environment must use the new file */
+	munmap(env->me_map, env->me_mapsize);
+	newfd = env->me_fd;
+	env->me_fd = fd;
+	fd = newfd;
+	newfd = env->me_mfd;
+	env->me_mfd = newmfd;
+	newmfd = newfd;
+	old = (env->me_flags & MDB_FIXEDMAP) ? env->me_map : NULL;
+	rc = mdb_env_map(env, old);
+	if (rc)
+		env->me_flags |= MDB_FATAL_ERROR;
+
+leave:
+	if (excl) {
+		lock_info.l_type = F_RDLCK;
+		while ((fcntl(env->me_lfd, F_SETLK, &lock_info)) &&
+				ErrCode() == EINTR) ;
+	}
+	if (wmutex)
+		UNLOCK_MUTEX(wmutex);
+	if (fd != INVALID_HANDLE_VALUE)
+		close(fd);
+	if (newmfd != INVALID_HANDLE_VALUE)
+		close(newmfd);
+	mdb_fname_destroy(fname);
+	free(metas);
+	return rc;
+#endif
+}
+
 int ESECT
 mdb_env_set_flags(MDB_env *env, unsigned int flag, int onoff)
 {
@@ -10736,6 +11752,164 @@ mdb_env_info(MDB_env *env, MDB_envinfo *arg)
 	return MDB_SUCCESS;
 }
 
+int ESECT
+mdb_env_get_written(MDB_env *env, mdb_size_t *bytes)
+{
+	if (env == NULL || bytes == NULL)
+		return EINVAL;
+
+	*bytes = env->me_written;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_advise(MDB_env *env, mdb_size_t pgno, mdb_size_t count, int advice)
+{
+#if defined(_WIN32)
+	return ERROR_NOT_SUPPORTED;
+#elif defined(MDB_VL32)
+	return ENOTSUP;
+#else
+	mdb_size_t maxpgs;
+	char *start, *end;
+	int adv;
+
+	if (!env || !env->me_map)
+		return EINVAL;
+	switch (advice) {
+#ifdef MADV_NORMAL
+	case MDB_ADVICE_NORMAL:		adv = MADV_NORMAL; break;
+	case MDB_ADVICE_RANDOM:		adv = MADV_RANDOM; break;
+	case MDB_ADVICE_SEQUENTIAL:	adv = MADV_SEQUENTIAL; break;
+	case MDB_ADVICE_WILLNEED:	adv = MADV_WILLNEED; break;
+	case MDB_ADVICE_DONTNEED:	adv = MADV_DONTNEED; break;
+#else
+	case MDB_ADVICE_NORMAL:		adv = POSIX_MADV_NORMAL; break;
+	case MDB_ADVICE_RANDOM:		adv = POSIX_MADV_RANDOM; break;
+	case MDB_ADVICE_SEQUENTIAL:	adv = POSIX_MADV_SEQUENTIAL; break;
+	case MDB_ADVICE_WILLNEED:	adv = POSIX_MADV_WILLNEED; break;
+	case MDB_ADVICE_DONTNEED:	adv = POSIX_MADV_DONTNEED; break;
+#endif
+	default:
+		return EINVAL;
+	}
+
+	maxpgs = env->me_mapsize / env->me_psize;
+	if (pgno >= maxpgs || !count)
+		return MDB_SUCCESS;
+	if (count > maxpgs - pgno)
+		count = maxpgs - pgno;
+
+	/* The map starts on an OS page, round the start down to one */
+	start = env->me_map + env->me_psize * pgno;
+	start -= (start - env->me_map) & (env->me_os_psize - 1);
+	end = env->me_map + env->me_psize * (pgno + count);
+#ifdef MADV_NORMAL
+	if (madvise(start, end - start, adv))
+		return ErrCode();
+	return MDB_SUCCESS;
+#else
+	return posix_madvise(start, end - start, adv);
+#endif
+#endif
+}
+
+/** Number of pages checked by each mincore() call of #mdb_env_resident() */
+#define MDB_RESIDENT_CHUNK	65536
+
+int ESECT
+mdb_env_resident(MDB_env *env, mdb_size_t pgno, mdb_size_t count, unsigned char *vec)
+{
+#if defined(_WIN32)
+	return ERROR_NOT_SUPPORTED;
+#elif defined(MDB_VL32)
+	return ENOTSUP;
+#else
+	unsigned int psize, ospsize;
+	mdb_size_t maxpgs, i, j, n;
+	unsigned char *buf;
+	int rc = MDB_SUCCESS;
+
+	if (!env || !env->me_map || !vec)
+		return EINVAL;
+	psize = env->me_psize;
+	ospsize = env->me_os_psize;
+
+	memset(vec, 0, count);
+	maxpgs = env->me_mapsize / psize;
+	if (pgno >= maxpgs)
+		return MDB_SUCCESS;
+	if (count > maxpgs - pgno)
+		count = maxpgs - pgno;
+
+	/* A chunk of pages spans at most this many OS pages */
+	buf = malloc((MDB_RESIDENT_CHUNK * (size_t)psize + ospsize - 1) / ospsize + 1);
+	if (!buf)
+		return ENOMEM;
+
+	for (i = 0; i < count; i += n) {
+		char *start, *end;
+		size_t off;
+		n = count - i;
+		if (n > MDB_RESIDENT_CHUNK)
+			n = MDB_RESIDENT_CHUNK;
+
+		start = env->me_map + (size_t)psize * (pgno + i);
+		off = (start - env->me_map) & (ospsize - 1);
+		start -= off;
+		end = env->me_map + (size_t)psize * (pgno + i + n);
+		if (mincore(start, end - start, (void *)buf)) {
+			rc = ErrCode();
+			break;
+		}
+
+		/* The OS pages of each page, from the rounded start */
+		for (j = 0; j < n; j++) {
+			size_t first = (off + (size_t)psize * j) / ospsize;
+			size_t last = (off + (size_t)psize * (j + 1) - 1) / ospsize;
+			vec[i + j] = 1;
+			for (; first <= last; first++) {
+				if (!(buf[first] & 1)) {
+					vec[i + j] = 0;
+					break;
+				}
+			}
+		}
+	}
+
+	free(buf);
+	return rc;
+#endif
+}
+
+int ESECT
+mdb_env_lock(MDB_env *env, mdb_size_t pgno, mdb_size_t count, int lock)
+{
+#if defined(_WIN32)
+	return ERROR_NOT_SUPPORTED;
+#elif defined(MDB_VL32)
+	return ENOTSUP;
+#else
+	mdb_size_t maxpgs;
+	char *start, *end;
+
+	if (!env || !env->me_map)
+		return EINVAL;
+	maxpgs = env->me_mapsize / env->me_psize;
+	if (pgno >= maxpgs || !count)
+		return MDB_SUCCESS;
+	if (count > maxpgs - pgno)
+		count = maxpgs - pgno;
+
+	start = env->me_map + env->me_psize * pgno;
+	start -= (start - env->me_map) & (env->me_os_psize - 1);
+	end = env->me_map + env->me_psize * (pgno + count);
+	if (lock ? mlock(start, end - start) : munlock(start, end - start))
+		return ErrCode();
+	return MDB_SUCCESS;
+#endif
+}
+
 /** Set the default comparison functions for a database.
  * Called immediately after a database is opened to set the defaults.
  * The user can then override them with #mdb_set_compare() or
@@ -10896,6 +12070,71 @@ mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *arg)
 	return mdb_stat0(txn->mt_env, &txn->mt_dbs[dbi], arg);
 }
 
+#ifndef MDB_VL32
+/** Pass the pages of a subtree to the function of #mdb_dbi_walk().
+ * @param[in] mc A cursor of the database, to get the pages.
+ * @param[in] pgno The root page of the subtree.
+ * @param[in] depth The depth of the subtree, 1 for a leaf page.
+ * @param[in] level The level of the page, 1 for the root.
+ * @param[in] flags The flags of #mdb_dbi_walk().
+ * @param[in] func The function that receives the pages.
+ * @param[in] ctx An arbitrary pointer passed to \b func.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_dbi_walk0(MDB_cursor *mc, pgno_t pgno, unsigned int depth, unsigned int level,
+	unsigned int flags, MDB_page_func *func, void *ctx)
+{
+	unsigned int levels = flags >> 8;
+	MDB_page *mp;
+	unsigned int i, n;
+	int rc;
+
+	if ((rc = mdb_page_get(mc, pgno, &mp, NULL)))
+		return rc;
+	if (depth <= 1)
+		return (flags & MDB_WALK_LEAVES) ? func(ctx, pgno, mp, 1) : MDB_SUCCESS;
+
+	/* The page isn't read before this call */
+	if ((rc = func(ctx, pgno, mp, 1)))
+		return rc;
+	if (levels && level >= levels)
+		return MDB_SUCCESS;
+	if (!IS_BRANCH(mp))
+		return MDB_CORRUPTED;
+	n = NUMKEYS(mp);
+	for (i = 0; i < n; i++) {
+		if ((rc = mdb_dbi_walk0(mc, NODEPGNO(NODEPTR(mp, i)), depth - 1, level + 1, flags, func, ctx)))
+			return rc;
+	}
+	return MDB_SUCCESS;
+}
+#endif
+
+int
+mdb_dbi_walk(MDB_txn *txn, MDB_dbi dbi, unsigned int flags, MDB_page_func *func, void *ctx)
+{
+#ifdef MDB_VL32
+	return ENOTSUP;
+#else
+	MDB_cursor mc;
+	MDB_xcursor mx;
+
+	if (!func || !TXN_DBI_EXIST(txn, dbi, DB_VALID))
+		return EINVAL;
+
+	if (txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	/* Reads the DB's root if it's stale */
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+	if (txn->mt_dbs[dbi].md_root == P_INVALID)
+		return MDB_SUCCESS;
+	return mdb_dbi_walk0(&mc, txn->mt_dbs[dbi].md_root, txn->mt_dbs[dbi].md_depth, 1,
+		flags, func, ctx);
+#endif
+}
+
 void mdb_dbi_close(MDB_env *env, MDB_dbi dbi)
 {
 	char *ptr;
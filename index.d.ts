@@ -39,6 +39,8 @@ declare module "node-lmdb" {
         lastTxnId: number;
         maxReaders: number;
         numReaders: number;
+        /** pages locked in memory by the lockBranchPages option */
+        lockedPages: number;
     }
 
 
@@ -106,6 +108,26 @@ declare module "node-lmdb" {
     interface EnvOptions {
         path?: string;
         mapSize?: number;
+        autoGrow?: {
+            step: number;
+            max?: number;
+        };
+        /** sync in the background every this many ms, if something was committed */
+        syncInterval?: number;
+        /** sync in the background once commits have written this many bytes */
+        syncEveryBytes?: number;
+        /** clear the stale readers of crashed processes every this many ms */
+        readerCheckInterval?: number;
+        /** measure the latency of the operations, see env.metrics() */
+        metrics?: boolean;
+        /** record the phases of the async work, see env.traceEvents() */
+        trace?: boolean | { size: number };
+        /** read the whole data file into memory when it's mapped */
+        mapPopulate?: boolean;
+        /** ask for transparent huge pages on the map */
+        hugePages?: boolean;
+        /** keep the branch pages of the open Dbis locked in memory, the top levels first within maxBytes */
+        lockBranchPages?: boolean | { maxBytes: number };
         maxDbs?: number;
         maxReaders?: number;
         noSubdir?: boolean;
@@ -124,6 +146,103 @@ declare module "node-lmdb" {
         readOnly: boolean;
     }
 
+    interface CopyIncrementalOptions {
+        /** path to write the signature of this backup to */
+        signature: string;
+        /** path to the signature of the previous backup, every page is copied without it */
+        since?: string;
+    }
+
+    interface CopyIncrementalResult {
+        txnId: number;
+        /** the transaction of the previous backup, 0 when every page was copied */
+        baseTxnId: number;
+        pages: number;
+        changedPages: number;
+    }
+
+    /**
+     * Apply a delta made by env.copyIncremental() onto a copy of the
+     * environment, which must be at the base transaction of the delta.
+     */
+    function applyDelta(
+        path: string,
+        deltaPath: string,
+        callback: (err: Error | null, result: { txnId: number }) => void
+    ): void;
+    function applyDelta(path: string, deltaPath: string): Promise<{ txnId: number }>;
+
+    interface CopyToStreamOptions {
+        /** leave out free pages and renumber the pages */
+        compact?: boolean;
+        /** don't copy faster than this */
+        bytesPerSecond?: number;
+        /** end the stream when the copy is finished (default is true) */
+        end?: boolean;
+    }
+
+    interface OperationMetrics {
+        count: number;
+        totalTime: number;
+        maxTime: number;
+        p50: number;
+        p90: number;
+        p99: number;
+        p999: number;
+    }
+
+    interface CommitStats {
+        dirtyPages: number;
+        spilledPages: number;
+        spillWrites: number;
+        writtenPages: number;
+        writes: number;
+        spillTime: number;
+        freelistTime: number;
+        writeTime: number;
+        syncTime: number;
+        metaTime: number;
+    }
+
+    interface TraceEvent {
+        name: string;
+        cat: 'node-lmdb';
+        ph: 'X';
+        /** start in µs */
+        ts: number;
+        /** duration in µs */
+        dur: number;
+        pid: number;
+        tid: number;
+        args: { triggerAsyncId: number; actions?: number; bytes?: number };
+    }
+
+    interface WarmupResult {
+        branchPages: number;
+        leafPages: number;
+        bytes: number;
+    }
+
+    interface Residency {
+        totalPages: number;
+        residentPages: number;
+        ratio: number;
+        dbis: {
+            branchPages: number;
+            residentBranchPages: number;
+            leafPages: number;
+            residentLeafPages: number;
+            ratio: number;
+        }[];
+    }
+
+    type Advice = 'normal' | 'random' | 'sequential' | 'willneed' | 'dontneed';
+
+    interface SharedEnv {
+        path: string;
+        dbis: { dbi: number }[];
+    }
+
     class Env {
         open(options: EnvOptions): void;
 
@@ -133,6 +252,18 @@ declare module "node-lmdb" {
          */
         openDbi(options: DbiOptions): Dbi;
 
+        /**
+         * Get a handle to the environment and some of its databases, which
+         * can be posted to a worker thread and attached there.
+         */
+        share(dbis?: Dbi[]): SharedEnv;
+
+        /**
+         * Open this Env on an environment shared by another thread, and
+         * return the shared databases in the order they were shared.
+         */
+        attach(handle: SharedEnv): Dbi[];
+
         /**
          * Begin a transaction
          */
@@ -156,6 +287,120 @@ declare module "node-lmdb" {
          */
         info(): Info;
 
+        /**
+         * Statistics of the background sync enabled by the syncInterval and
+         * syncEveryBytes options, or null. Times are in milliseconds.
+         */
+        syncStats(): {
+            syncs: number;
+            errors: number;
+            lastTxnId: number;
+            lastTime: number;
+            maxTime: number;
+            totalTime: number;
+        } | null;
+
+        /**
+         * The slots of the reader lock table that are in use, by any
+         * process. txnId is null when no transaction uses the slot.
+         */
+        readers(): { pid: number; thread: string; txnId: number | null }[];
+
+        /**
+         * Clear the reader slots of processes that no longer exist and
+         * return their number.
+         */
+        readerCheck(): number;
+
+        /**
+         * Statistics of the free pages, to tell when the file is
+         * fragmented. txn is about the current write transaction.
+         */
+        freeStats(): {
+            totalPages: number;
+            freePages: number;
+            reusablePages: number;
+            /** free pages that the oldest reader keeps from being reused */
+            pinnedPages: number;
+            oldestTxnId: number;
+            entries: number;
+            /** runs of contiguous free pages */
+            runs: number;
+            largestRun: number;
+            txn: {
+                dirtyPages: number;
+                spilledPages: number;
+                dirtyRoom: number;
+                spilledRatio: number;
+            } | null;
+        };
+
+        /**
+         * Latencies of the operations in ms, when the environment was
+         * opened with the metrics option.
+         */
+        metrics(options?: { reset?: boolean }): Record<
+            | 'get' | 'put' | 'del' | 'cursor' | 'txnBegin' | 'commit' | 'commitWrite'
+            | 'commitSync' | 'batchQueueWait' | 'batch',
+            OperationMetrics
+        > & { bytesRead: number; bytesWritten: number };
+        /**
+         * The metrics in the text format of Prometheus.
+         */
+        metrics(options: { format: 'prometheus'; labels?: Record<string, string>; reset?: boolean }): string;
+
+        /**
+         * The spans of the async work recorded since the last call, when the
+         * environment was opened with the trace option.
+         */
+        traceEvents(): TraceEvent[];
+
+        /**
+         * Fault the branch pages of the databases, and their leaf pages with
+         * the leaves option, into the page cache in the background.
+         * Not supported on Windows.
+         * @param options.maxBytes no more leaf pages are warmed up after this many bytes
+         * @param options.parallel number of threads faulting the leaf pages in
+         */
+        warmup(
+            options: { dbis: Dbi[]; leaves?: boolean; maxBytes?: number; parallel?: number },
+            callback: (error: Error | null, result?: WarmupResult) => void
+        ): void;
+        warmup(options: { dbis: Dbi[]; leaves?: boolean; maxBytes?: number; parallel?: number }): Promise<WarmupResult>;
+
+        /**
+         * Which pages of the environment, and of the given databases, are in
+         * the page cache. Not supported on Windows.
+         */
+        residency(options: { dbis?: Dbi[] }, callback: (error: Error | null, result?: Residency) => void): void;
+        residency(callback: (error: Error | null, result?: Residency) => void): void;
+        residency(options?: { dbis?: Dbi[] }): Promise<Residency>;
+
+        /**
+         * Tell the OS how the pages of the whole map, of a database or of a
+         * range of bytes are going to be used. The pages of a database are
+         * found in the background. Not supported on Windows.
+         */
+        advise(advice: Advice): void;
+        advise(range: { offset: number; length: number }, advice: Advice): void;
+        advise(dbi: Dbi, advice: Advice, callback: (error: Error | null) => void): void;
+        advise(dbi: Dbi, advice: Advice): Promise<void>;
+
+        /**
+         * Compact the environment while it stays open: a compacted copy
+         * replaces the data file once no transaction is active.
+         * Not supported on Windows.
+         * @param options.tmpPath where the copy is made, on the file system of the data file
+         */
+        compact(
+            options: { tmpPath?: string },
+            callback: (error: Error | null, result?: { pagesBefore: number; pagesAfter: number }) => void
+        ): void;
+        compact(
+            callback: (error: Error | null, result?: { pagesBefore: number; pagesAfter: number }) => void
+        ): void;
+        compact(options?: { tmpPath?: string }): Promise<{ pagesBefore: number; pagesAfter: number }>;
+
         /**
          * Resizes the maximal size of the memory map. It may be called if no transactions are active in this process.
          * @param {number} size maximal size of the memory map (the full environment) in bytes (default is 10485760 bytes)
@@ -178,21 +423,74 @@ declare module "node-lmdb" {
          * @param {object} options
          * @param {Function} options.progress callback function for reporting
          *                                    progress on a batch operation.
-         * @param callback
+         * @param {boolean} options.stats add the statistics of the commit to
+         *                                the results, as `results.stats`.
+         * @param callback a promise is returned instead when it's omitted
          */
         batchWrite(
             operations: (BatchOperation | BatchOperationArray)[],
-            options?: PutOptions & {
+            options: PutOptions & {
                 progress?: (results: BatchResult[]) => void;
+                stats?: boolean;
             },
-            callback?: (err: Error, results: BatchResult[]) => void
+            callback: (err: Error, results: BatchResult[] & { stats?: CommitStats }) => void
         ): void;
+        batchWrite(
+            operations: (BatchOperation | BatchOperationArray)[],
+            callback: (err: Error, results: BatchResult[]) => void
+        ): void;
+        batchWrite(
+            operations: (BatchOperation | BatchOperationArray)[],
+            options?: PutOptions & {
+                progress?: (results: BatchResult[]) => void;
+                stats?: boolean;
+            }
+        ): Promise<BatchResult[] & { stats?: CommitStats }>;
 
         copy(
             path: string,
-            compact?: boolean,
-            callback?: (err: Error) => void
+            compact: boolean,
+            callback: (err: Error) => void
         ): void;
+        copy(path: string, callback: (err: Error) => void): void;
+        copy(path: string, compact?: boolean): Promise<void>;
+
+        /**
+         * Copy the environment into a writable stream, while it's in use.
+         */
+        copyToStream(
+            stream: NodeJS.WritableStream,
+            options: CopyToStreamOptions,
+            callback: (err: Error | null) => void
+        ): void;
+        copyToStream(
+            stream: NodeJS.WritableStream,
+            callback: (err: Error | null) => void
+        ): void;
+        copyToStream(
+            stream: NodeJS.WritableStream,
+            options?: CopyToStreamOptions
+        ): Promise<void>;
+
+        /**
+         * Copy the pages that changed since a previous backup into a delta.
+         */
+        copyIncremental(
+            path: string,
+            options: CopyIncrementalOptions,
+            callback: (err: Error | null, result: CopyIncrementalResult) => void
+        ): void;
+        copyIncremental(
+            path: string,
+            options: CopyIncrementalOptions
+        ): Promise<CopyIncrementalResult>;
+
+        /**
+         * Flush the data buffers to disk on a background thread, even with
+         * the noSync option.
+         */
+        sync(callback: (err: Error | null) => void): void;
+        sync(): Promise<void>;
 
         /**
          * Close the environment
@@ -202,6 +500,11 @@ declare module "node-lmdb" {
 
     type DropOptions = { txn?: Txn; justFreePages: boolean };
 
+    type CountRangeOptions = {
+        /** walk the range instead of estimating its size */
+        exact?: boolean;
+    } & KeyType;
+
     /**
      * Database Instance: represents a single K/V store.
      */
@@ -209,6 +512,94 @@ declare module "node-lmdb" {
         close(): void;
         drop(options?: DropOptions): void;
         stat(tx: Txn): Stat;
+
+        /**
+         * Count the entries with keys from `start` (inclusive) up to `end`
+         * (exclusive). Either bound may be null to leave that end open.
+         * Large ranges are estimated from the B-tree in O(log n) time
+         * unless `exact` is set.
+         */
+        countRange(
+            tx: Txn,
+            start: Key | null,
+            end: Key | null,
+            options?: CountRangeOptions
+        ): number;
+
+        /**
+         * Estimate the number of entries and the bytes of database pages
+         * in the range from `start` (inclusive) up to `end` (exclusive),
+         * in O(log n) time. Either bound may be null.
+         */
+        estimateSize(
+            tx: Txn,
+            start: Key | null,
+            end: Key | null,
+            options?: KeyType
+        ): { entries: number; bytes: number };
+
+        /**
+         * Return up to `parts - 1` keys that split the database into
+         * `parts` ranges of roughly the same size, without scanning it.
+         */
+        splitPoints<T extends Key = Key>(tx: Txn, parts: number, options?: KeyType): T[];
+
+        /**
+         * Scan the database on multiple threads, all reading the same
+         * snapshot, and reduce its entries natively.
+         */
+        parallelScan<T extends Key = Key>(
+            options: ParallelScanOptions,
+            callback: (err: Error | null, result: ParallelScanResult<T>) => void
+        ): void;
+        parallelScan<T extends Key = Key>(
+            options: ParallelScanOptions
+        ): Promise<ParallelScanResult<T>>;
+
+        /**
+         * Return the data items that all of the given keys have, in sorted
+         * order. The Dbi must be opened with dupSort and dupFixed; with
+         * integerDup the result is a Uint32Array or a BigUint64Array.
+         */
+        intersectDups(tx: Txn, keys: Key[], options?: DupsOptions): DupsResult;
+        /** Return the data items that any of the given keys have. */
+        unionDups(tx: Txn, keys: Key[], options?: DupsOptions): DupsResult;
+        /**
+         * Return the data items of the first key that none of the other
+         * keys have.
+         */
+        differenceDups(tx: Txn, keys: Key[], options?: DupsOptions): DupsResult;
+    };
+
+    type DupsOptions = {
+        /** the maximum number of data items to return */
+        limit?: number;
+    } & KeyType;
+
+    type DupsResult = Uint32Array | BigUint64Array | Buffer;
+
+    type ParallelScanOptions = {
+        /** number of threads, the number of CPUs by default */
+        threads?: number;
+        /** reducers to run, ['count'] by default */
+        reduce?: Array<"count" | "sum" | "min" | "max" | "keyRange" | "sizeHistogram">;
+        /** numeric field of the data read by sum, min and max */
+        field?: { offset?: number; type?: "double" | "float" | "int32" | "uint32" };
+        /** first key of the scanned range (inclusive) */
+        start?: Key;
+        /** end of the scanned range (exclusive) */
+        end?: Key;
+    } & KeyType;
+
+    type ParallelScanResult<T extends Key = Key> = {
+        count?: number;
+        sum?: number;
+        min?: number | null;
+        max?: number | null;
+        firstKey?: T | null;
+        lastKey?: T | null;
+        /** index i counts data of at least 2^(i-1) and less than 2^i bytes */
+        sizeHistogram?: number[];
     };
 
     /**
@@ -246,6 +637,20 @@ declare module "node-lmdb" {
          */
         commit(): void;
 
+        /**
+         * Commit and close a write transaction, and return how many pages it
+         * wrote and how long each step of the commit took, in ms
+         */
+        commit(options: { stats: true }): CommitStats;
+
+        /**
+         * Commit the transaction, syncing it to disk on a background thread.
+         * The transaction can't be used anymore, and no other write
+         * transaction can begin until the callback is called.
+         */
+        commitAsync(callback: (err: Error | null) => void): void;
+        commitAsync(): Promise<void>;
+
         /**
          * Abort and close the transaction
          */
@@ -266,6 +671,11 @@ declare module "node-lmdb" {
     interface DelOptions {
         noDupData: boolean;
     }
+
+    type CursorPutOptions = PutOptions & {
+        /** replace the item at the current cursor position */
+        current?: boolean;
+    };
     class Cursor<T extends Key = string> {
         constructor(txn: Txn, dbi: Dbi, keyType?: KeyType);
 
@@ -293,6 +703,39 @@ declare module "node-lmdb" {
 
         del(options?: DelOptions): void;
 
+        /**
+         * Store a key/data pair and position the cursor at it.
+         */
+        put(key: T, data: Value, options?: CursorPutOptions): void;
+
+        /**
+         * Reserve `size` bytes for the data of `key` and return a Buffer
+         * pointing into the database, which must be filled before the next
+         * write operation. Not supported for dupSort databases.
+         */
+        putReserve(key: T, size: number, options?: CursorPutOptions): Buffer;
+
+        /**
+         * Replace the data of the item the cursor is pointing to.
+         */
+        replace(data: Value): void;
+
+        /**
+         * Return the number of data items of the current key (dupSort only).
+         */
+        countDups(): number;
+
+        /**
+         * Bind the cursor to another read-only transaction, for example
+         * after the transaction it was opened with has been reset or
+         * aborted. Only cursors of read-only transactions can be renewed.
+         */
+        renew(txn: Txn): void;
+
+        /**
+         * Close the cursor. Cursors of read-only transactions are kept by
+         * the Dbi and reused by the next cursor opened on it.
+         */
         close(): void;
     }
 }
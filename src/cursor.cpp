@@ -27,6 +27,9 @@
 using namespace v8;
 using namespace node;
 
+// Maximum number of closed cursors that a Dbi keeps for reuse
+#define MAX_CACHED_CURSORS (16)
+
 CursorWrap::CursorWrap(MDB_cursor *cursor) {
     this->cursor = cursor;
     this->keyType = NodeLmdbKeyType::StringKey;
@@ -70,9 +73,22 @@ NAN_METHOD(CursorWrap::ctor) {
 
     // Open the cursor
     MDB_cursor *cursor;
-    int rc = mdb_cursor_open(tw->txn, dw->dbi, &cursor);
-    if (rc != 0) {
-        return throwLmdbError(rc);
+    int rc;
+    if ((tw->flags & MDB_RDONLY) && dw->cursorCache.size()) {
+        // Reuse a cursor closed earlier, which spares allocating a new one
+        cursor = dw->cursorCache.back();
+        dw->cursorCache.pop_back();
+        rc = mdb_cursor_renew(tw->txn, cursor);
+        if (rc != 0) {
+            mdb_cursor_close(cursor);
+            return throwLmdbError(rc);
+        }
+    }
+    else {
+        rc = mdb_cursor_open(tw->txn, dw->dbi, &cursor);
+        if (rc != 0) {
+            return throwLmdbError(rc);
+        }
     }
 
     // Create wrapper
@@ -91,12 +107,49 @@ NAN_METHOD(CursorWrap::close) {
     Nan::HandleScope scope;
 
     CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
-    mdb_cursor_close(cw->cursor);
+    if ((cw->tw->flags & MDB_RDONLY) && cw->dw->isOpen && cw->dw->cursorCache.size() < MAX_CACHED_CURSORS) {
+        // Cursors of read-only transactions can be renewed, so keep it for the next cursor of this Dbi
+        cw->dw->cursorCache.push_back(cw->cursor);
+    }
+    else {
+        mdb_cursor_close(cw->cursor);
+    }
     cw->dw->Unref();
     cw->tw->Unref();
     cw->cursor = nullptr;
 }
 
+NAN_METHOD(CursorWrap::renew) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 1 || !info[0]->IsObject()) {
+        return Nan::ThrowError("cursor.renew should be called with a single argument which is a txn.");
+    }
+
+    CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(Local<Object>::Cast(info[0]));
+
+    if (!cw->cursor) {
+        return Nan::ThrowError("The cursor is already closed.");
+    }
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (!(tw->flags & MDB_RDONLY) || !(cw->tw->flags & MDB_RDONLY)) {
+        return Nan::ThrowError("Only cursors of read-only transactions can be renewed.");
+    }
+
+    int rc = mdb_cursor_renew(tw->txn, cw->cursor);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    // The cursor now belongs to the new transaction
+    tw->Ref();
+    cw->tw->Unref();
+    cw->tw = tw;
+}
+
 NAN_METHOD(CursorWrap::del) {
     Nan::HandleScope scope;
 
@@ -116,9 +169,13 @@ NAN_METHOD(CursorWrap::del) {
     }
 
     CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    MetricTimer timer(cw->tw->ew ? cw->tw->ew->envMetrics : nullptr, Metric::Del);
 
     int rc = mdb_cursor_del(cw->cursor, flags);
     if (rc != 0) {
+        if (rc == MDB_MAP_FULL && cw->tw->ew) {
+            cw->tw->ew->handleMapFull();
+        }
         return throwLmdbError(rc);
     }
 }
@@ -135,6 +192,7 @@ Nan::NAN_METHOD_RETURN_TYPE CursorWrap::getCommon(
 
     int al = info.Length();
     CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    MetricTimer timer(cw->tw->ew ? cw->tw->ew->envMetrics : nullptr, Metric::Cursor);
 
     // When a new key is manually set
     if (setKey) {
@@ -195,6 +253,7 @@ Nan::NAN_METHOD_RETURN_TYPE CursorWrap::getCommon(
 
     Local<Value> dataHandle = Nan::Undefined();
     if (convertFunc) {
+        timer.read(cw->data.mv_size);
         dataHandle = convertFunc(cw->data);
 
         if (al > 0) {
@@ -270,24 +329,25 @@ MAKE_GET_FUNC(goToNextDup, MDB_NEXT_DUP);
 
 MAKE_GET_FUNC(goToPrevDup, MDB_PREV_DUP);
 
-static void fillDataFromArg1(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB_val &data) {
-    if (info[1]->IsString()) {
-        CustomExternalStringResource::writeTo(Local<String>::Cast(info[1]), &data);
+template<size_t dataIndex>
+static void fillDataFromArg(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB_val &data) {
+    if (info[dataIndex]->IsString()) {
+        CustomExternalStringResource::writeTo(Local<String>::Cast(info[dataIndex]), &data);
     }
-    else if (node::Buffer::HasInstance(info[1])) {
-        data.mv_size = node::Buffer::Length(info[1]);
-        data.mv_data = node::Buffer::Data(info[1]);
+    else if (node::Buffer::HasInstance(info[dataIndex])) {
+        data.mv_size = node::Buffer::Length(info[dataIndex]);
+        data.mv_data = node::Buffer::Data(info[dataIndex]);
     }
-    else if (info[1]->IsNumber()) {
+    else if (info[dataIndex]->IsNumber()) {
         data.mv_size = sizeof(double);
         data.mv_data = new double;
-        auto local = Nan::To<v8::Number>(info[1]).ToLocalChecked();
+        auto local = Nan::To<v8::Number>(info[dataIndex]).ToLocalChecked();
         *((double*)data.mv_data) = local->Value();
     }
-    else if (info[1]->IsBoolean()) {
-        data.mv_size = sizeof(double);
+    else if (info[dataIndex]->IsBoolean()) {
+        data.mv_size = sizeof(bool);
         data.mv_data = new bool;
-        auto local = Nan::To<v8::Boolean>(info[1]).ToLocalChecked();
+        auto local = Nan::To<v8::Boolean>(info[dataIndex]).ToLocalChecked();
         *((bool*)data.mv_data) = local->Value();
     }
     else {
@@ -295,17 +355,18 @@ static void fillDataFromArg1(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB
     }
 }
 
-static void freeDataFromArg1(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB_val &data) {
-    if (info[1]->IsString()) {
+template<size_t dataIndex>
+static void freeDataFromArg(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB_val &data) {
+    if (info[dataIndex]->IsString()) {
         delete[] (uint16_t*)data.mv_data;
     }
-    else if (node::Buffer::HasInstance(info[1])) {
+    else if (node::Buffer::HasInstance(info[dataIndex])) {
         // I think the data is owned by the node::Buffer so we don't need to free it - need to clarify
     }
-    else if (info[1]->IsNumber()) {
+    else if (info[dataIndex]->IsNumber()) {
         delete (double*)data.mv_data;
     }
-    else if (info[1]->IsBoolean()) {
+    else if (info[dataIndex]->IsBoolean()) {
         delete (bool*)data.mv_data;
     }
     else {
@@ -313,6 +374,10 @@ static void freeDataFromArg1(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB
     }
 }
 
+static bool isValidData(const Local<Value> &val) {
+    return val->IsString() || node::Buffer::HasInstance(val) || val->IsNumber() || val->IsBoolean();
+}
+
 template<size_t keyIndex, size_t optionsIndex>
 inline argtokey_callback_t cursorArgToKey(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDB_val &key, bool &keyIsValid) {
     auto keyType = inferAndValidateKeyType(info[keyIndex], info[optionsIndex], cw->keyType, keyIsValid);
@@ -340,14 +405,182 @@ NAN_METHOD(CursorWrap::goToDup) {
     if (info.Length() != 2 && info.Length() != 3) {
         return Nan::ThrowError("You called cursor.goToDup with an incorrect number of arguments. Arguments are: key (mandatory), data (mandatory), options (optional).");
     }
-    return getCommon(info, MDB_GET_BOTH, cursorArgToKey<0, 2>, fillDataFromArg1, freeDataFromArg1, nullptr);
+    return getCommon(info, MDB_GET_BOTH, cursorArgToKey<0, 2>, fillDataFromArg<1>, freeDataFromArg<1>, nullptr);
 }
 
 NAN_METHOD(CursorWrap::goToDupRange) {
     if (info.Length() != 2 && info.Length() != 3) {
         return Nan::ThrowError("You called cursor.goToDupRange with an incorrect number of arguments. Arguments are: key (mandatory), data (mandatory), options (optional).");
     }
-    return getCommon(info, MDB_GET_BOTH_RANGE, cursorArgToKey<0, 2>, fillDataFromArg1, freeDataFromArg1, nullptr);
+    return getCommon(info, MDB_GET_BOTH_RANGE, cursorArgToKey<0, 2>, fillDataFromArg<1>, freeDataFromArg<1>, nullptr);
+}
+
+static int putFlagsFromOptions(const Local<Value> &options) {
+    int flags = 0;
+    if (options->IsObject()) {
+        auto obj = Local<Object>::Cast(options);
+        setFlagFromValue(&flags, MDB_NODUPDATA, "noDupData", false, obj);
+        setFlagFromValue(&flags, MDB_NOOVERWRITE, "noOverwrite", false, obj);
+        setFlagFromValue(&flags, MDB_APPEND, "append", false, obj);
+        setFlagFromValue(&flags, MDB_APPENDDUP, "appendDup", false, obj);
+        setFlagFromValue(&flags, MDB_CURRENT, "current", false, obj);
+    }
+    return flags;
+}
+
+NAN_METHOD(CursorWrap::put) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 2 && info.Length() != 3) {
+        return Nan::ThrowError("You called cursor.put with an incorrect number of arguments. Arguments are: key (mandatory), data (mandatory), options (optional).");
+    }
+
+    CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    if (!cw->cursor) {
+        return Nan::ThrowError("The cursor is already closed.");
+    }
+    if (!isValidData(info[1])) {
+        return Nan::ThrowError("Invalid data type.");
+    }
+    MetricTimer timer(cw->tw->ew ? cw->tw->ew->envMetrics : nullptr, Metric::Put);
+
+    MDB_val key, data;
+    bool keyIsValid;
+    auto freeKey = cursorArgToKey<0, 2>(cw, info, key, keyIsValid);
+    if (!keyIsValid) {
+        // cursorArgToKey already threw an error
+        return;
+    }
+    fillDataFromArg<1>(cw, info, data);
+
+    // Keep a copy of the original key and data, so we can free them
+    MDB_val originalKey = key;
+    MDB_val originalData = data;
+
+    int rc = mdb_cursor_put(cw->cursor, &key, &data, putFlagsFromOptions(info[2]));
+
+    if (freeKey) {
+        freeKey(originalKey);
+    }
+    freeDataFromArg<1>(cw, info, originalData);
+
+    if (rc == 0) {
+        timer.written(originalKey.mv_size + originalData.mv_size);
+    }
+    else {
+        if (rc == MDB_MAP_FULL && cw->tw->ew) {
+            cw->tw->ew->handleMapFull();
+        }
+        return throwLmdbError(rc);
+    }
+}
+
+NAN_METHOD(CursorWrap::putReserve) {
+    Nan::HandleScope scope;
+
+    if ((info.Length() != 2 && info.Length() != 3) || !info[1]->IsUint32()) {
+        return Nan::ThrowError("You called cursor.putReserve with incorrect arguments. Arguments are: key (mandatory), size (mandatory), options (optional).");
+    }
+
+    CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    if (!cw->cursor) {
+        return Nan::ThrowError("The cursor is already closed.");
+    }
+    if (cw->dw->flags & MDB_DUPSORT) {
+        return Nan::ThrowError("cursor.putReserve can't be used with a dupSort database.");
+    }
+    MetricTimer timer(cw->tw->ew ? cw->tw->ew->envMetrics : nullptr, Metric::Put);
+
+    MDB_val key, data;
+    bool keyIsValid;
+    auto freeKey = cursorArgToKey<0, 2>(cw, info, key, keyIsValid);
+    if (!keyIsValid) {
+        // cursorArgToKey already threw an error
+        return;
+    }
+    data.mv_size = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    data.mv_data = nullptr;
+
+    MDB_val originalKey = key;
+    int rc = mdb_cursor_put(cw->cursor, &key, &data, putFlagsFromOptions(info[2]) | MDB_RESERVE);
+
+    if (freeKey) {
+        freeKey(originalKey);
+    }
+
+    if (rc != 0) {
+        if (rc == MDB_MAP_FULL && cw->tw->ew) {
+            cw->tw->ew->handleMapFull();
+        }
+        return throwLmdbError(rc);
+    }
+
+    // The buffer points to the space reserved inside LMDB
+    timer.written(originalKey.mv_size + data.mv_size);
+    return info.GetReturnValue().Set(valToBinaryUnsafe(data));
+}
+
+NAN_METHOD(CursorWrap::replace) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 1) {
+        return Nan::ThrowError("You called cursor.replace with an incorrect number of arguments. Arguments are: data (mandatory).");
+    }
+
+    CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    if (!cw->cursor) {
+        return Nan::ThrowError("The cursor is already closed.");
+    }
+    if (!isValidData(info[0])) {
+        return Nan::ThrowError("Invalid data type.");
+    }
+    MetricTimer timer(cw->tw->ew ? cw->tw->ew->envMetrics : nullptr, Metric::Put);
+
+    // Get the current key, LMDB needs it even with MDB_CURRENT
+    MDB_val key, currentData;
+    int rc = mdb_cursor_get(cw->cursor, &key, &currentData, MDB_GET_CURRENT);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    // The current key points inside the page that is about to be modified, so copy it first
+    std::vector<char> keyCopy((char*)key.mv_data, (char*)key.mv_data + key.mv_size);
+    key.mv_data = keyCopy.data();
+
+    MDB_val data;
+    fillDataFromArg<0>(cw, info, data);
+    MDB_val originalData = data;
+
+    rc = mdb_cursor_put(cw->cursor, &key, &data, MDB_CURRENT);
+
+    freeDataFromArg<0>(cw, info, originalData);
+
+    if (rc == 0) {
+        timer.written(key.mv_size + originalData.mv_size);
+    }
+    else {
+        if (rc == MDB_MAP_FULL && cw->tw->ew) {
+            cw->tw->ew->handleMapFull();
+        }
+        return throwLmdbError(rc);
+    }
+}
+
+NAN_METHOD(CursorWrap::countDups) {
+    Nan::HandleScope scope;
+
+    CursorWrap *cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.This());
+    if (!cw->cursor) {
+        return Nan::ThrowError("The cursor is already closed.");
+    }
+
+    mdb_size_t count;
+    int rc = mdb_cursor_count(cw->cursor, &count);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>((double) count));
 }
 
 void CursorWrap::setupExports(Local<Object> exports) {
@@ -357,6 +590,7 @@ void CursorWrap::setupExports(Local<Object> exports) {
     cursorTpl->InstanceTemplate()->SetInternalFieldCount(1);
     // CursorWrap: Add functions to the prototype
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("close").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::close));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("renew").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::renew));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("getCurrentString").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::getCurrentString));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("getCurrentStringUnsafe").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::getCurrentStringUnsafe));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("getCurrentBinary").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::getCurrentBinary));
@@ -376,6 +610,10 @@ void CursorWrap::setupExports(Local<Object> exports) {
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("goToDup").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::goToDup));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("goToDupRange").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::goToDupRange));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("del").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::del));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("put").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::put));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("putReserve").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::putReserve));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("replace").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::replace));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("countDups").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::countDups));
 
     // Set exports
     exports->Set(Nan::GetCurrentContext(), Nan::New<String>("Cursor").ToLocalChecked(), cursorTpl->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
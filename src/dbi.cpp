@@ -23,6 +23,10 @@
 
 #include "node-lmdb.h"
 #include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <thread>
 
 using namespace v8;
 using namespace node;
@@ -34,6 +38,7 @@ DbiWrap::DbiWrap(MDB_env *env, MDB_dbi dbi) {
     this->dbi = dbi;
     this->keyType = NodeLmdbKeyType::StringKey;
     this->isOpen = false;
+    this->isShared = false;
     this->ew = nullptr;
 }
 
@@ -51,11 +56,20 @@ DbiWrap::~DbiWrap() {
     // For this reason, we will never call mdb_dbi_close
     // NOTE: according to LMDB authors, it is perfectly fine if mdb_dbi_close is never called on an MDB_dbi
 
+    this->clearCursorCache();
+
     if (this->ew) {
         this->ew->Unref();
     }
 }
 
+void DbiWrap::clearCursorCache() {
+    for (MDB_cursor *cursor : this->cursorCache) {
+        mdb_cursor_close(cursor);
+    }
+    this->cursorCache.clear();
+}
+
 NAN_METHOD(DbiWrap::ctor) {
     Nan::HandleScope scope;
 
@@ -71,6 +85,28 @@ NAN_METHOD(DbiWrap::ctor) {
     bool isOpen = false;
 
     EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(Local<Object>::Cast(info[0]));
+
+    // A Dbi shared by another Env of the process (see env.share), whose handle is already open
+    if (info[2]->IsUint32()) {
+        shared_dbi_t shared;
+        if (!ew->env || !ew->findSharedDbi(info[2]->Uint32Value(Nan::GetCurrentContext()).FromJust(), &shared)) {
+            return Nan::ThrowError("The Dbi isn't shared by the environment.");
+        }
+
+        DbiWrap* dw = new DbiWrap(ew->env, shared.dbi);
+        dw->ew = ew;
+        dw->ew->Ref();
+        dw->keyType = shared.keyType;
+        dw->flags = shared.flags;
+        dw->isOpen = true;
+        dw->isShared = true;
+        dw->Wrap(info.This());
+        if (ew->branchLocker) {
+            ew->branchLocker->addDbi(dbi);
+        }
+
+        return info.GetReturnValue().Set(info.This());
+    }
     
     if (info[1]->IsObject()) {
         Local<Object> options = Local<Object>::Cast(info[1]);
@@ -167,6 +203,10 @@ NAN_METHOD(DbiWrap::ctor) {
     dw->isOpen = isOpen;
     dw->Wrap(info.This());
 
+    if (isOpen && ew->branchLocker) {
+        ew->branchLocker->addDbi(dbi);
+    }
+
     return info.GetReturnValue().Set(info.This());
 }
 
@@ -175,7 +215,17 @@ NAN_METHOD(DbiWrap::close) {
 
     DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
     if (dw->isOpen) {
-        mdb_dbi_close(dw->env, dw->dbi);
+        dw->clearCursorCache();
+        if (dw->ew->branchLocker) {
+            dw->ew->branchLocker->removeDbi(dw->dbi);
+        }
+        // A shared handle stays open for the other Envs, until the environment is closed
+        if (!dw->isShared) {
+            // The background work that walks the Dbis stops at its next page, and walks them again afterwards
+            dw->ew->beginCloseDbi();
+            mdb_dbi_close(dw->env, dw->dbi);
+            dw->ew->endCloseDbi();
+        }
         dw->isOpen = false;
         dw->ew->Unref();
         dw->ew = nullptr;
@@ -227,8 +277,14 @@ NAN_METHOD(DbiWrap::drop) {
         }
     }
 
-    // Drop database
+    // Drop database, deleting it also closes the handle, which stops the background work that walks the Dbis meanwhile
+    if (del) {
+        dw->ew->beginCloseDbi();
+    }
     rc = mdb_drop(txn, dw->dbi, del);
+    if (del) {
+        dw->ew->endCloseDbi();
+    }
     if (rc != 0) {
         if (needsTransaction) {
             mdb_txn_abort(txn);
@@ -242,10 +298,19 @@ NAN_METHOD(DbiWrap::drop) {
         if (rc != 0) {
             return throwLmdbError(rc);
         }
+        dw->ew->committed();
     }
     
     // Only close database if del == 1
     if (del == 1) {
+        // mdb_drop closed the handle for every Env
+        if (dw->isShared) {
+            dw->ew->unshareDbi(dw->dbi);
+        }
+        dw->clearCursorCache();
+        if (dw->ew->branchLocker) {
+            dw->ew->branchLocker->removeDbi(dw->dbi);
+        }
         dw->isOpen = false;
         dw->ew->Unref();
         dw->ew = nullptr;
@@ -277,3 +342,761 @@ NAN_METHOD(DbiWrap::stat) {
 
     info.GetReturnValue().Set(obj);
 }
+
+// Ranges estimated to be smaller than this are counted exactly, it's cheap and the estimate is least accurate for them
+#define EXACT_COUNT_THRESHOLD (256)
+
+// Key range given to a Dbi method as start (inclusive) and end (exclusive) keys, either of which can be null
+struct KeyRange {
+    MDB_val bounds[2];
+    bool hasBound[2] = { false, false };
+    argtokey_callback_t freeBound[2] = { nullptr, nullptr };
+
+    ~KeyRange() {
+        for (int i = 0; i < 2; i++) {
+            if (freeBound[i]) {
+                freeBound[i](bounds[i]);
+            }
+        }
+    }
+
+    // Reads the keys from the given arguments, returns false if an error was thrown
+    bool fromArgs(NodeLmdbKeyType dbiKeyType, const Local<Value> &start, const Local<Value> &end, const Local<Value> &options) {
+        Local<Value> args[2] = { start, end };
+        for (int i = 0; i < 2; i++) {
+            if (args[i]->IsNull() || args[i]->IsUndefined()) {
+                continue;
+            }
+
+            bool keyIsValid;
+            auto keyType = inferAndValidateKeyType(args[i], options, dbiKeyType, keyIsValid);
+            if (keyIsValid) {
+                freeBound[i] = argToKey(args[i], bounds[i], keyType, keyIsValid);
+            }
+            if (!keyIsValid) {
+                // inferAndValidateKeyType or argToKey already threw an error
+                return false;
+            }
+            hasBound[i] = true;
+        }
+        return true;
+    }
+
+    // Gets the relative positions of the start and the end of the range in the database
+    int positions(MDB_cursor *cursor, double *startPos, double *endPos) {
+        double *pos[2] = { startPos, endPos };
+        *startPos = 0.0;
+        *endPos = 1.0;
+
+        for (int i = 0; i < 2; i++) {
+            if (!hasBound[i]) {
+                continue;
+            }
+
+            MDB_val key = bounds[i], data;
+            int rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_RANGE);
+            if (rc == MDB_NOTFOUND) {
+                *pos[i] = 1.0;
+                continue;
+            }
+            if (rc == 0) {
+                rc = mdb_cursor_pos(cursor, pos[i]);
+            }
+            if (rc != 0) {
+                return rc;
+            }
+        }
+        return 0;
+    }
+};
+
+// Gets the options argument at the given index, which may be omitted
+static Local<Value> optionsArg(Nan::NAN_METHOD_ARGS_TYPE info, int index) {
+    return info.Length() > index ? info[index] : Local<Value>(Nan::Undefined());
+}
+
+NAN_METHOD(DbiWrap::countRange) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 3 && info.Length() != 4) {
+        return Nan::ThrowError("dbi.countRange should be called with a txn, a start key, an end key and optionally an options object.");
+    }
+
+    DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(Local<Object>::Cast(info[0]));
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (!dw->isOpen) {
+        return Nan::ThrowError("The Dbi is not open, you can't use it.");
+    }
+
+    Local<Value> options = optionsArg(info, 3);
+    int exact = 0;
+    if (options->IsObject()) {
+        setFlagFromValue(&exact, 1, "exact", false, Local<Object>::Cast(options));
+    }
+
+    KeyRange range;
+    if (!range.fromArgs(dw->keyType, info[1], info[2], options)) {
+        return;
+    }
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(tw->txn, dw->dbi, &cursor);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    double count = 0;
+
+    if (!exact) {
+        MDB_stat stat;
+        double startPos, endPos;
+
+        rc = mdb_stat(tw->txn, dw->dbi, &stat);
+        if (rc == 0) {
+            rc = range.positions(cursor, &startPos, &endPos);
+        }
+        if (rc == 0) {
+            count = endPos > startPos ? (endPos - startPos) * stat.ms_entries : 0.0;
+            exact = count < EXACT_COUNT_THRESHOLD;
+            count = exact ? 0 : std::round(count);
+        }
+    }
+
+    if (rc == 0 && exact) {
+        MDB_val key, data;
+        bool dupSort = dw->flags & MDB_DUPSORT;
+
+        if (range.hasBound[0]) {
+            key = range.bounds[0];
+            rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_RANGE);
+        }
+        else {
+            rc = mdb_cursor_get(cursor, &key, &data, MDB_FIRST);
+        }
+
+        while (rc == 0) {
+            if (range.hasBound[1] && mdb_cmp(tw->txn, dw->dbi, &key, &range.bounds[1]) >= 0) {
+                break;
+            }
+
+            if (dupSort) {
+                mdb_size_t dups;
+                rc = mdb_cursor_count(cursor, &dups);
+                if (rc != 0) {
+                    break;
+                }
+                count += dups;
+            }
+            else {
+                count++;
+            }
+
+            rc = mdb_cursor_get(cursor, &key, &data, dupSort ? MDB_NEXT_NODUP : MDB_NEXT);
+        }
+        if (rc == MDB_NOTFOUND) {
+            rc = 0;
+        }
+    }
+
+    mdb_cursor_close(cursor);
+
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>(count));
+}
+
+NAN_METHOD(DbiWrap::estimateSize) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 3 && info.Length() != 4) {
+        return Nan::ThrowError("dbi.estimateSize should be called with a txn, a start key, an end key and optionally an options object.");
+    }
+
+    DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(Local<Object>::Cast(info[0]));
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (!dw->isOpen) {
+        return Nan::ThrowError("The Dbi is not open, you can't use it.");
+    }
+
+    KeyRange range;
+    if (!range.fromArgs(dw->keyType, info[1], info[2], optionsArg(info, 3))) {
+        return;
+    }
+
+    MDB_stat stat;
+    MDB_cursor *cursor;
+    double startPos = 0.0, endPos = 0.0;
+
+    int rc = mdb_stat(tw->txn, dw->dbi, &stat);
+    if (rc == 0) {
+        rc = mdb_cursor_open(tw->txn, dw->dbi, &cursor);
+    }
+    if (rc == 0) {
+        rc = range.positions(cursor, &startPos, &endPos);
+        mdb_cursor_close(cursor);
+    }
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    // Pages are assumed to be used evenly across the database
+    double fraction = endPos > startPos ? endPos - startPos : 0.0;
+    double pages = (double) stat.ms_branch_pages + stat.ms_leaf_pages + stat.ms_overflow_pages;
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+    (void)obj->Set(context, Nan::New<String>("entries").ToLocalChecked(), Nan::New<Number>(std::round(fraction * stat.ms_entries)));
+    (void)obj->Set(context, Nan::New<String>("bytes").ToLocalChecked(), Nan::New<Number>(std::round(fraction * pages * stat.ms_psize)));
+
+    info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(DbiWrap::splitPoints) {
+    Nan::HandleScope scope;
+
+    if (info.Length() != 2 && info.Length() != 3) {
+        return Nan::ThrowError("dbi.splitPoints should be called with a txn, the number of parts and optionally an options object.");
+    }
+
+    DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(Local<Object>::Cast(info[0]));
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (!dw->isOpen) {
+        return Nan::ThrowError("The Dbi is not open, you can't use it.");
+    }
+    if (!info[1]->IsUint32() || info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust() == 0) {
+        return Nan::ThrowError("The number of parts should be a positive integer.");
+    }
+    uint32_t parts = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+
+    auto keyType = keyTypeFromOptions(optionsArg(info, 2), dw->keyType);
+    if (keyType == NodeLmdbKeyType::InvalidKey) {
+        // keyTypeFromOptions already threw an error
+        return;
+    }
+    if (dw->keyType == NodeLmdbKeyType::Uint32Key && keyType != NodeLmdbKeyType::Uint32Key) {
+        return Nan::ThrowError("You specified keyIsUint32 on the Dbi, so you can't use other key types with it.");
+    }
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(tw->txn, dw->dbi, &cursor);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Array> result = Nan::New<Array>();
+    uint32_t count = 0;
+
+    // Each part starts at a split point, the first one at the first key
+    MDB_val previous, key, data;
+    rc = mdb_cursor_get(cursor, &previous, &data, MDB_FIRST);
+
+    for (uint32_t i = 1; rc == 0 && i < parts; i++) {
+        rc = mdb_cursor_set_pos(cursor, (double) i / parts, &key, &data);
+        // Small databases can have fewer distinct split points than requested
+        if (rc == 0 && mdb_cmp(tw->txn, dw->dbi, &key, &previous) > 0) {
+            (void)result->Set(context, count++, keyToHandle(key, keyType));
+            previous = key;
+        }
+    }
+
+    mdb_cursor_close(cursor);
+
+    if (rc != 0 && rc != MDB_NOTFOUND) {
+        return throwLmdbError(rc);
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+// Reducers that dbi.parallelScan can run, as a bit mask
+#define SCAN_COUNT (1)
+#define SCAN_SUM (2)
+#define SCAN_MIN (4)
+#define SCAN_MAX (8)
+#define SCAN_KEY_RANGE (16)
+#define SCAN_SIZE_HISTOGRAM (32)
+#define SCAN_FIELD (SCAN_SUM | SCAN_MIN | SCAN_MAX)
+
+// Number of buckets of the value size histogram, enough for values of up to 4 GiB
+#define SCAN_HISTOGRAM_BUCKETS (33)
+
+// The key range is split into this many parts per thread, so that threads that finish early can take over work
+#define SCAN_PARTS_PER_THREAD (4)
+
+// How many times to try to begin the read transactions of a scan on the same snapshot
+#define SCAN_SNAPSHOT_ATTEMPTS (16)
+
+// Type of the numeric field of values that the sum, min and max reducers read
+enum class ScanFieldType {
+    Double,
+    Float,
+    Int32,
+    Uint32
+};
+
+// Reduced results of a part of a scan
+struct ScanResult {
+    double count = 0;
+    double sum = 0;
+    double min = INFINITY;
+    double max = -INFINITY;
+    bool hasKeys = false;
+    std::vector<char> firstKey, lastKey;
+    double sizeHistogram[SCAN_HISTOGRAM_BUCKETS] = {};
+};
+
+// Part of the key range of a scan, an empty end means the end of the database
+struct ScanPart {
+    std::vector<char> start, end;
+    bool hasStart = false;
+    bool hasEnd = false;
+    ScanResult result;
+};
+
+// Scans the parts on its own threads, and on the thread of the pool that runs it, which it holds until the scan is finished
+class ScanWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    ScanWorker(Nan::Callback *callback, MDB_dbi dbi, int reducers, ScanFieldType fieldType, uint32_t fieldOffset, NodeLmdbKeyType keyType, EnvWrap *ew)
+      : PromiseWorker(callback, "node-lmdb:ParallelScan"), dbi(dbi), reducers(reducers), fieldType(fieldType), fieldOffset(fieldOffset), keyType(keyType), ew(ew) {}
+
+    ~ScanWorker() {
+        // In case the scan was never started
+        for (MDB_txn *txn : txns) {
+            mdb_txn_abort(txn);
+        }
+        ew->backgroundReaders -= readers;
+        // Growing the map may have been waiting for the scan to finish
+        ew->runIdleCallbacks();
+    }
+
+    // Begins one read transaction per thread, all on the same snapshot
+    int beginTxns(MDB_env *env, unsigned int threads) {
+        for (int attempt = 0; attempt < SCAN_SNAPSHOT_ATTEMPTS; attempt++) {
+            int rc = 0;
+            while (rc == 0 && txns.size() < threads) {
+                MDB_txn *txn;
+                rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+                if (rc == 0) {
+                    txns.push_back(txn);
+                }
+            }
+            if (rc == 0 && mdb_txn_id(txns.front()) == mdb_txn_id(txns.back())) {
+                readers = (int) txns.size();
+                ew->backgroundReaders += readers;
+                return 0;
+            }
+
+            // Either an error or a write transaction was committed in the meantime
+            for (MDB_txn *txn : txns) {
+                mdb_txn_abort(txn);
+            }
+            txns.clear();
+            if (rc != 0) {
+                return rc;
+            }
+        }
+        return MDB_BAD_TXN;
+    }
+
+    // Splits the given range into parts at keys that divide it evenly
+    int split(KeyRange &range) {
+        MDB_txn *txn = txns.front();
+        MDB_cursor *cursor;
+        double startPos, endPos;
+        size_t count = txns.size() * SCAN_PARTS_PER_THREAD;
+
+        int rc = mdb_cursor_open(txn, dbi, &cursor);
+        if (rc != 0) {
+            return rc;
+        }
+        rc = range.positions(cursor, &startPos, &endPos);
+
+        ScanPart first;
+        if (range.hasBound[0]) {
+            first.hasStart = true;
+            first.start.assign((char*) range.bounds[0].mv_data, (char*) range.bounds[0].mv_data + range.bounds[0].mv_size);
+        }
+        parts.push_back(first);
+
+        for (size_t i = 1; rc == 0 && i < count && endPos > startPos; i++) {
+            MDB_val key, data;
+            rc = mdb_cursor_set_pos(cursor, startPos + (endPos - startPos) * i / count, &key, &data);
+            if (rc != 0) {
+                break;
+            }
+
+            // Small ranges have fewer distinct split points than parts
+            MDB_val previous = { parts.back().start.size(), parts.back().start.data() };
+            if (parts.back().hasStart && mdb_cmp(txn, dbi, &key, &previous) <= 0) {
+                continue;
+            }
+            if (range.hasBound[1] && mdb_cmp(txn, dbi, &key, &range.bounds[1]) >= 0) {
+                break;
+            }
+
+            ScanPart part;
+            part.hasStart = true;
+            part.start.assign((char*) key.mv_data, (char*) key.mv_data + key.mv_size);
+            parts.back().hasEnd = true;
+            parts.back().end = part.start;
+            parts.push_back(part);
+        }
+        if (range.hasBound[1]) {
+            parts.back().hasEnd = true;
+            parts.back().end.assign((char*) range.bounds[1].mv_data, (char*) range.bounds[1].mv_data + range.bounds[1].mv_size);
+        }
+
+        mdb_cursor_close(cursor);
+        return rc == MDB_NOTFOUND ? 0 : rc;
+    }
+
+    void Execute() {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < txns.size(); i++) {
+            threads.emplace_back(&ScanWorker::scanParts, this, txns[i]);
+        }
+        scanParts(txns.front());
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        // The transactions are not bound to threads because of MDB_NOTLS
+        for (MDB_txn *txn : txns) {
+            mdb_txn_abort(txn);
+        }
+        txns.clear();
+
+        if (error) {
+            SetErrorMessage(mdb_strerror(error));
+        }
+    }
+
+    Local<Value> result() {
+        ScanResult total;
+        for (ScanPart &part : parts) {
+            ScanResult &r = part.result;
+            total.count += r.count;
+            total.sum += r.sum;
+            total.min = std::min(total.min, r.min);
+            total.max = std::max(total.max, r.max);
+            for (int i = 0; i < SCAN_HISTOGRAM_BUCKETS; i++) {
+                total.sizeHistogram[i] += r.sizeHistogram[i];
+            }
+            if (r.hasKeys) {
+                if (!total.hasKeys) {
+                    total.firstKey = r.firstKey;
+                }
+                total.lastKey = r.lastKey;
+                total.hasKeys = true;
+            }
+        }
+
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Object> obj = Nan::New<Object>();
+        auto numberOrNull = [](double value) -> Local<Value> {
+            return std::isfinite(value) ? Local<Value>(Nan::New<Number>(value)) : Local<Value>(Nan::Null());
+        };
+        auto keyOrNull = [this](std::vector<char> &key, bool hasKey) -> Local<Value> {
+            MDB_val val = { key.size(), key.data() };
+            return hasKey ? keyToHandle(val, keyType) : Local<Value>(Nan::Null());
+        };
+
+        if (reducers & SCAN_COUNT) {
+            (void)obj->Set(context, Nan::New<String>("count").ToLocalChecked(), Nan::New<Number>(total.count));
+        }
+        if (reducers & SCAN_SUM) {
+            (void)obj->Set(context, Nan::New<String>("sum").ToLocalChecked(), Nan::New<Number>(total.sum));
+        }
+        if (reducers & SCAN_MIN) {
+            (void)obj->Set(context, Nan::New<String>("min").ToLocalChecked(), numberOrNull(total.min));
+        }
+        if (reducers & SCAN_MAX) {
+            (void)obj->Set(context, Nan::New<String>("max").ToLocalChecked(), numberOrNull(total.max));
+        }
+        if (reducers & SCAN_KEY_RANGE) {
+            (void)obj->Set(context, Nan::New<String>("firstKey").ToLocalChecked(), keyOrNull(total.firstKey, total.hasKeys));
+            (void)obj->Set(context, Nan::New<String>("lastKey").ToLocalChecked(), keyOrNull(total.lastKey, total.hasKeys));
+        }
+        if (reducers & SCAN_SIZE_HISTOGRAM) {
+            Local<Array> histogram = Nan::New<Array>(SCAN_HISTOGRAM_BUCKETS);
+            for (int i = 0; i < SCAN_HISTOGRAM_BUCKETS; i++) {
+                (void)histogram->Set(context, i, Nan::New<Number>(total.sizeHistogram[i]));
+            }
+            (void)obj->Set(context, Nan::New<String>("sizeHistogram").ToLocalChecked(), histogram);
+        }
+        return obj;
+    }
+
+  private:
+    // Takes parts of the range and scans them until there are none left, runs on its own thread
+    void scanParts(MDB_txn *txn) {
+        size_t i;
+        while (!error && (i = nextPart++) < parts.size()) {
+            int rc = scanPart(txn, parts[i]);
+            if (rc != 0) {
+                error = rc;
+            }
+        }
+    }
+
+    int scanPart(MDB_txn *txn, ScanPart &part) {
+        ScanResult &r = part.result;
+        MDB_cursor *cursor;
+        MDB_val key, data, lastKey, end = { part.end.size(), part.end.data() };
+
+        int rc = mdb_cursor_open(txn, dbi, &cursor);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (part.hasStart) {
+            key.mv_size = part.start.size();
+            key.mv_data = part.start.data();
+            rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_RANGE);
+        }
+        else {
+            rc = mdb_cursor_get(cursor, &key, &data, MDB_FIRST);
+        }
+
+        for (; rc == 0; rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) {
+            if (part.hasEnd && mdb_cmp(txn, dbi, &key, &end) >= 0) {
+                break;
+            }
+
+            r.count++;
+            if (reducers & SCAN_FIELD) {
+                double value;
+                if (readField(data, &value)) {
+                    r.sum += value;
+                    r.min = std::min(r.min, value);
+                    r.max = std::max(r.max, value);
+                }
+            }
+            if (reducers & SCAN_SIZE_HISTOGRAM) {
+                int bucket = 0;
+                for (size_t size = data.mv_size; size && bucket < SCAN_HISTOGRAM_BUCKETS - 1; size >>= 1) {
+                    bucket++;
+                }
+                r.sizeHistogram[bucket]++;
+            }
+            if ((reducers & SCAN_KEY_RANGE) && !r.hasKeys) {
+                r.firstKey.assign((char*) key.mv_data, (char*) key.mv_data + key.mv_size);
+                r.hasKeys = true;
+            }
+            lastKey = key;
+        }
+
+        // The last key points into the map, which is valid until the transaction ends
+        if (r.hasKeys) {
+            r.lastKey.assign((char*) lastKey.mv_data, (char*) lastKey.mv_data + lastKey.mv_size);
+        }
+
+        mdb_cursor_close(cursor);
+        return rc == MDB_NOTFOUND ? 0 : rc;
+    }
+
+    // Reads the numeric field of a value, values too short to have it are skipped
+    bool readField(const MDB_val &data, double *value) {
+        const char *p = (const char*) data.mv_data + fieldOffset;
+        switch (fieldType) {
+        case ScanFieldType::Double: {
+            double v;
+            if (data.mv_size < fieldOffset + sizeof(v)) return false;
+            memcpy(&v, p, sizeof(v));
+            *value = v;
+            return true;
+        }
+        case ScanFieldType::Float: {
+            float v;
+            if (data.mv_size < fieldOffset + sizeof(v)) return false;
+            memcpy(&v, p, sizeof(v));
+            *value = v;
+            return true;
+        }
+        case ScanFieldType::Int32: {
+            int32_t v;
+            if (data.mv_size < fieldOffset + sizeof(v)) return false;
+            memcpy(&v, p, sizeof(v));
+            *value = v;
+            return true;
+        }
+        case ScanFieldType::Uint32: {
+            uint32_t v;
+            if (data.mv_size < fieldOffset + sizeof(v)) return false;
+            memcpy(&v, p, sizeof(v));
+            *value = v;
+            return true;
+        }
+        }
+        return false;
+    }
+
+    MDB_dbi dbi;
+    int reducers;
+    ScanFieldType fieldType;
+    uint32_t fieldOffset;
+    NodeLmdbKeyType keyType;
+    EnvWrap *ew;
+    int readers = 0;
+    std::vector<MDB_txn*> txns;
+    std::vector<ScanPart> parts;
+    std::atomic<size_t> nextPart { 0 };
+    std::atomic<int> error { 0 };
+};
+
+NAN_METHOD(DbiWrap::parallelScan) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || info.Length() > 2 || !info[0]->IsObject()) {
+        return Nan::ThrowError("dbi.parallelScan should be called with an options object and optionally a callback.");
+    }
+
+    DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
+    if (!dw->isOpen) {
+        return Nan::ThrowError("The Dbi is not open, you can't use it.");
+    }
+    if (!dw->ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> options = Local<Object>::Cast(info[0]);
+
+    // Number of threads, defaults to the number of CPUs
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+    Local<Value> threadsOption = options->Get(context, Nan::New<String>("threads").ToLocalChecked()).ToLocalChecked();
+    if (threadsOption->IsUint32() && threadsOption->Uint32Value(context).FromJust() > 0) {
+        threads = threadsOption->Uint32Value(context).FromJust();
+    }
+    else if (!threadsOption->IsUndefined()) {
+        return Nan::ThrowError("The threads option should be a positive integer.");
+    }
+
+    // Reducers to run, counting is the default
+    int reducers = 0;
+    Local<Value> reduceOption = options->Get(context, Nan::New<String>("reduce").ToLocalChecked()).ToLocalChecked();
+    if (reduceOption->IsUndefined()) {
+        reducers = SCAN_COUNT;
+    }
+    else if (reduceOption->IsArray()) {
+        Local<Array> reduceArray = Local<Array>::Cast(reduceOption);
+        for (uint32_t i = 0; i < reduceArray->Length(); i++) {
+            Nan::Utf8String name(reduceArray->Get(context, i).ToLocalChecked());
+            if (!*name) {
+                return Nan::ThrowError("Invalid reducer name.");
+            }
+            else if (!strcmp(*name, "count")) {
+                reducers |= SCAN_COUNT;
+            }
+            else if (!strcmp(*name, "sum")) {
+                reducers |= SCAN_SUM;
+            }
+            else if (!strcmp(*name, "min")) {
+                reducers |= SCAN_MIN;
+            }
+            else if (!strcmp(*name, "max")) {
+                reducers |= SCAN_MAX;
+            }
+            else if (!strcmp(*name, "keyRange")) {
+                reducers |= SCAN_KEY_RANGE;
+            }
+            else if (!strcmp(*name, "sizeHistogram")) {
+                reducers |= SCAN_SIZE_HISTOGRAM;
+            }
+            else {
+                return Nan::ThrowError("Unknown reducer. Supported reducers are: count, sum, min, max, keyRange and sizeHistogram.");
+            }
+        }
+    }
+    else {
+        return Nan::ThrowError("The reduce option should be an array of reducer names.");
+    }
+
+    // Numeric field read by the sum, min and max reducers
+    ScanFieldType fieldType = ScanFieldType::Double;
+    uint32_t fieldOffset = 0;
+    Local<Value> fieldOption = options->Get(context, Nan::New<String>("field").ToLocalChecked()).ToLocalChecked();
+    if (fieldOption->IsObject()) {
+        Local<Object> field = Local<Object>::Cast(fieldOption);
+        Local<Value> offset = field->Get(context, Nan::New<String>("offset").ToLocalChecked()).ToLocalChecked();
+        if (offset->IsUint32()) {
+            fieldOffset = offset->Uint32Value(context).FromJust();
+        }
+        else if (!offset->IsUndefined()) {
+            return Nan::ThrowError("The field offset should be a non-negative integer.");
+        }
+
+        Local<Value> type = field->Get(context, Nan::New<String>("type").ToLocalChecked()).ToLocalChecked();
+        if (!type->IsUndefined()) {
+            Nan::Utf8String typeName(type);
+            if (*typeName && !strcmp(*typeName, "double")) {
+                fieldType = ScanFieldType::Double;
+            }
+            else if (*typeName && !strcmp(*typeName, "float")) {
+                fieldType = ScanFieldType::Float;
+            }
+            else if (*typeName && !strcmp(*typeName, "int32")) {
+                fieldType = ScanFieldType::Int32;
+            }
+            else if (*typeName && !strcmp(*typeName, "uint32")) {
+                fieldType = ScanFieldType::Uint32;
+            }
+            else {
+                return Nan::ThrowError("Unknown field type. Supported types are: double, float, int32 and uint32.");
+            }
+        }
+    }
+    else if (!fieldOption->IsUndefined()) {
+        return Nan::ThrowError("The field option should be an object.");
+    }
+
+    auto keyType = keyTypeFromOptions(options, dw->keyType);
+    if (keyType == NodeLmdbKeyType::InvalidKey) {
+        // keyTypeFromOptions already threw an error
+        return;
+    }
+
+    KeyRange range;
+    Local<Value> start = options->Get(context, Nan::New<String>("start").ToLocalChecked()).ToLocalChecked();
+    Local<Value> end = options->Get(context, Nan::New<String>("end").ToLocalChecked()).ToLocalChecked();
+    if (!range.fromArgs(dw->keyType, start, end, options)) {
+        return;
+    }
+
+    // Every thread has a read transaction, leave a slot of the reader lock table for the other transactions
+    unsigned int freeReaders = dw->ew->freeReaders();
+    threads = std::min(threads, freeReaders > 1 ? freeReaders - 1 : 1u);
+
+    Nan::Callback *callback = callbackArgument(info[1]);
+    ScanWorker *worker = new ScanWorker(callback, dw->dbi, reducers, fieldType, fieldOffset, keyType, dw->ew);
+
+    int rc = worker->beginTxns(dw->ew->env, threads);
+    if (rc == 0) {
+        rc = worker->split(range);
+    }
+    if (rc != 0) {
+        delete worker;
+        return throwLmdbError(rc);
+    }
+
+    // Keep the environment and the database alive while the scan is running
+    worker->SaveToPersistent("env", dw->ew->handle());
+    worker->SaveToPersistent("dbi", info.This());
+    worker->promiseUnlessCallback(info);
+    Nan::AsyncQueueWorker(worker);
+}
@@ -22,11 +22,28 @@
 // THE SOFTWARE.
 
 #include "node-lmdb.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace v8;
 using namespace node;
 
 #define IGNORE_NOTFOUND    (1)
+// Largest chunk of a copy that is passed to a stream
+#define COPY_CHUNK_SIZE (256 * 1024)
+// Number of chunks that may be waiting to be written by the stream
+#define COPY_CHUNKS_IN_FLIGHT (4)
+// How often the background sync checks the bytes written for syncEveryBytes, in nanoseconds
+#define SYNC_POLL_INTERVAL (10 * 1000 * 1000)
 thread_local Nan::Persistent<Function>* EnvWrap::txnCtor;
 thread_local Nan::Persistent<Function>* EnvWrap::dbiCtor;
 //Nan::Persistent<Function> EnvWrap::txnCtor;
@@ -40,17 +57,204 @@ uv_mutex_t* EnvWrap::initMutex() {
     return mutex;
 }
 
+/*
+    Background thread of the syncInterval and syncEveryBytes options.
+    It only syncs the environment when a transaction was committed since the last sync.
+*/
+class SyncThread {
+  public:
+    SyncThread(MDB_env *env, uint64_t interval, mdb_size_t everyBytes)
+      : env(env), interval(interval), everyBytes(everyBytes) {
+        uv_mutex_init(&mutex);
+        uv_mutex_init(&mapLock);
+        uv_cond_init(&wakeup);
+
+        MDB_envinfo envinfo;
+        mdb_env_info(env, &envinfo);
+        syncedTxnId = envinfo.me_last_txnid;
+        mdb_env_get_written(env, &syncedBytes);
+
+        uv_thread_create(&thread, run, this);
+    }
+
+    ~SyncThread() {
+        uv_mutex_lock(&mutex);
+        stopping = true;
+        uv_cond_signal(&wakeup);
+        uv_mutex_unlock(&mutex);
+        uv_thread_join(&thread);
+
+        // Don't lose what was committed since the last sync
+        syncIfNeeded(true);
+
+        uv_cond_destroy(&wakeup);
+        uv_mutex_destroy(&mapLock);
+        uv_mutex_destroy(&mutex);
+    }
+
+    // Keeps the thread from using the map while it's being resized
+    void pause() {
+        uv_mutex_lock(&mapLock);
+    }
+
+    void resume() {
+        uv_mutex_unlock(&mapLock);
+    }
+
+    Local<Object> stats() {
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Object> obj = Nan::New<Object>();
+
+        uv_mutex_lock(&mutex);
+        (void)obj->Set(context, Nan::New<String>("syncs").ToLocalChecked(), Nan::New<Number>(syncs));
+        (void)obj->Set(context, Nan::New<String>("errors").ToLocalChecked(), Nan::New<Number>(errors));
+        (void)obj->Set(context, Nan::New<String>("lastTxnId").ToLocalChecked(), Nan::New<Number>(lastTxnId));
+        (void)obj->Set(context, Nan::New<String>("lastTime").ToLocalChecked(), Nan::New<Number>(lastTime));
+        (void)obj->Set(context, Nan::New<String>("maxTime").ToLocalChecked(), Nan::New<Number>(maxTime));
+        (void)obj->Set(context, Nan::New<String>("totalTime").ToLocalChecked(), Nan::New<Number>(totalTime));
+        uv_mutex_unlock(&mutex);
+
+        return obj;
+    }
+
+  private:
+    static void run(void *arg) {
+        SyncThread *st = (SyncThread*) arg;
+        uint64_t nextTick = uv_hrtime() + st->interval;
+
+        uv_mutex_lock(&st->mutex);
+        while (!st->stopping) {
+            // Wake up for the next tick of syncInterval, and regularly to check syncEveryBytes
+            uint64_t now = uv_hrtime();
+            uint64_t wait = SYNC_POLL_INTERVAL;
+            if (st->interval) {
+                wait = nextTick > now ? nextTick - now : 0;
+                if (st->everyBytes && wait > SYNC_POLL_INTERVAL) {
+                    wait = SYNC_POLL_INTERVAL;
+                }
+            }
+            if (wait) {
+                uv_cond_timedwait(&st->wakeup, &st->mutex, wait);
+                if (st->stopping) {
+                    break;
+                }
+            }
+            uv_mutex_unlock(&st->mutex);
+
+            bool tick = st->interval && uv_hrtime() >= nextTick;
+            if (st->syncIfNeeded(tick) || tick) {
+                nextTick = uv_hrtime() + st->interval;
+            }
+
+            uv_mutex_lock(&st->mutex);
+        }
+        uv_mutex_unlock(&st->mutex);
+    }
+
+    bool syncIfNeeded(bool due) {
+        bool synced = false;
+        uv_mutex_lock(&mapLock);
+
+        MDB_envinfo envinfo;
+        mdb_size_t written;
+        mdb_env_info(env, &envinfo);
+        mdb_env_get_written(env, &written);
+        if (everyBytes && written - syncedBytes >= everyBytes) {
+            due = true;
+        }
+
+        if (due && envinfo.me_last_txnid != syncedTxnId) {
+            uint64_t start = uv_hrtime();
+            int rc = mdb_env_sync(env, 1);
+            double time = (uv_hrtime() - start) / 1e6;
+
+            uv_mutex_lock(&mutex);
+            if (rc == 0) {
+                syncedTxnId = envinfo.me_last_txnid;
+                syncedBytes = written;
+                synced = true;
+                syncs++;
+                lastTxnId = (double) syncedTxnId;
+                lastTime = time;
+                maxTime = std::max(maxTime, time);
+                totalTime += time;
+            }
+            else {
+                // Tried again at the next tick
+                errors++;
+            }
+            uv_mutex_unlock(&mutex);
+        }
+
+        uv_mutex_unlock(&mapLock);
+        return synced;
+    }
+
+    MDB_env *env;
+    // Settings, the interval is in nanoseconds, zero means the option isn't used
+    uint64_t interval;
+    mdb_size_t everyBytes;
+
+    uv_thread_t thread;
+    // Protects the stopping flag and the statistics
+    uv_mutex_t mutex;
+    uv_cond_t wakeup;
+    bool stopping = false;
+    // Held while the thread uses the map
+    uv_mutex_t mapLock;
+
+    // State of the last sync
+    mdb_size_t syncedTxnId;
+    mdb_size_t syncedBytes;
+
+    // Statistics, the times are in milliseconds
+    double syncs = 0;
+    double errors = 0;
+    double lastTxnId = 0;
+    double lastTime = 0;
+    double maxTime = 0;
+    double totalTime = 0;
+};
+
 EnvWrap::EnvWrap() {
     this->env = nullptr;
     this->currentWriteTxn = nullptr;
+    this->backgroundReaders = 0;
+    this->backgroundWriters = 0;
+    this->growStep = 0;
+    this->growMax = 0;
+    this->syncThread = nullptr;
+    this->readerCheckTimer = nullptr;
+    this->envMetrics = nullptr;
+    this->traceBuffer = nullptr;
+    this->branchLocker = nullptr;
+    uv_rwlock_init(&this->dbiLock);
+    this->closingDbis = 0;
 }
 
 EnvWrap::~EnvWrap() {
     // Close if not closed already
     if (this->env) {
         this->cleanupStrayTxns();
+        delete this->syncThread;
+        this->stopReaderCheck();
         mdb_env_close(env);
     }
+    delete this->envMetrics;
+    delete this->traceBuffer;
+    delete this->branchLocker;
+    uv_rwlock_destroy(&this->dbiLock);
+}
+
+void EnvWrap::stopReaderCheck() {
+    if (!readerCheckTimer) {
+        return;
+    }
+    uv_timer_stop(readerCheckTimer);
+    uv_close((uv_handle_t*) readerCheckTimer, [](uv_handle_t *handle) -> void {
+        delete (uv_timer_t*) handle;
+    });
+    readerCheckTimer = nullptr;
 }
 
 void EnvWrap::cleanupStrayTxns() {
@@ -67,6 +271,158 @@ void EnvWrap::cleanupStrayTxns() {
     }
 }
 
+bool EnvWrap::isIdle() {
+    return !currentWriteTxn && readTxns.empty() && !backgroundReaders && !backgroundWriters && !(branchLocker && branchLocker->isRunning());
+}
+
+void EnvWrap::whenIdle(std::function<void()> callback) {
+    idleCallbacks.push_back(callback);
+    runIdleCallbacks();
+}
+
+void EnvWrap::runIdleCallbacks() {
+    if (!isIdle() || idleCallbacks.empty()) {
+        return;
+    }
+
+    // Callbacks may start new work, which waits for the next time the environment is idle
+    auto callbacks = std::move(idleCallbacks);
+    idleCallbacks.clear();
+    for (auto &callback : callbacks) {
+        callback();
+    }
+}
+
+int EnvWrap::growMap(mdb_size_t fullSize) {
+    if (!env) {
+        return EINVAL;
+    }
+
+    MDB_envinfo envinfo;
+    int rc = mdb_env_info(env, &envinfo);
+    if (rc != 0) {
+        return rc;
+    }
+    if (envinfo.me_mapsize > fullSize) {
+        // Another write has already made it grow
+        return 0;
+    }
+    if (!growStep || fullSize >= growMax) {
+        return MDB_MAP_FULL;
+    }
+    // Only this Env's transactions are known to be finished, the other Envs of the process
+    // (in other threads, or attached with env.attach) may be reading from the map
+    if (openCount() > 1) {
+        return MDB_MAP_FULL;
+    }
+
+    return setMapSize(std::min(fullSize + growStep, growMax));
+}
+
+int EnvWrap::setMapSize(mdb_size_t size) {
+    if (syncThread) {
+        syncThread->pause();
+    }
+    int rc = mdb_env_set_mapsize(env, size);
+    if (syncThread) {
+        syncThread->resume();
+    }
+    if (branchLocker) {
+        // The new map isn't locked
+        branchLocker->reset();
+        branchLocker->refresh();
+    }
+    return rc;
+}
+
+int EnvWrap::replaceFile(const char *path, mdb_size_t txnId) {
+    if (syncThread) {
+        syncThread->pause();
+    }
+    int rc = mdb_env_replace_file(env, path, txnId);
+    if (syncThread) {
+        syncThread->resume();
+    }
+    if (rc == 0 && branchLocker) {
+        // The copy is mapped instead, without the locks
+        branchLocker->reset();
+        branchLocker->refresh();
+    }
+    return rc;
+}
+
+int EnvWrap::openCount() {
+    int count = 0;
+    uv_mutex_lock(envsLock);
+    for (env_path_t &envPath : envs) {
+        if (envPath.env == env) {
+            count = envPath.count;
+        }
+    }
+    uv_mutex_unlock(envsLock);
+    return count;
+}
+
+bool EnvWrap::findSharedDbi(MDB_dbi dbi, shared_dbi_t *result) {
+    bool found = false;
+    uv_mutex_lock(envsLock);
+    for (env_path_t &envPath : envs) {
+        if (envPath.env == env) {
+            for (shared_dbi_t &shared : envPath.sharedDbis) {
+                if (shared.dbi == dbi) {
+                    *result = shared;
+                    found = true;
+                }
+            }
+        }
+    }
+    uv_mutex_unlock(envsLock);
+    return found;
+}
+
+void EnvWrap::unshareDbi(MDB_dbi dbi) {
+    uv_mutex_lock(envsLock);
+    for (env_path_t &envPath : envs) {
+        if (envPath.env == env) {
+            auto &sharedDbis = envPath.sharedDbis;
+            sharedDbis.erase(std::remove_if(sharedDbis.begin(), sharedDbis.end(), [dbi](const shared_dbi_t &shared) {
+                return shared.dbi == dbi;
+            }), sharedDbis.end());
+        }
+    }
+    uv_mutex_unlock(envsLock);
+}
+
+void EnvWrap::growIfAlmostFull() {
+    if (!growStep || !env || !isIdle()) {
+        return;
+    }
+
+    MDB_envinfo envinfo;
+    MDB_stat stat;
+    if (mdb_env_info(env, &envinfo) != 0 || mdb_env_stat(env, &stat) != 0) {
+        return;
+    }
+
+    // Keep at least a quarter of the step free, so that most writes never hit MDB_MAP_FULL
+    mdb_size_t used = (envinfo.me_last_pgno + 1) * stat.ms_psize;
+    if (envinfo.me_mapsize < growMax && envinfo.me_mapsize - std::min(used, envinfo.me_mapsize) < growStep / 4) {
+        growMap(envinfo.me_mapsize);
+    }
+}
+
+void EnvWrap::handleMapFull() {
+    MDB_envinfo envinfo;
+    if (!growStep || !env || mdb_env_info(env, &envinfo) != 0) {
+        return;
+    }
+
+    mdb_size_t fullSize = envinfo.me_mapsize;
+    whenIdle([this, fullSize]() -> void {
+        growMap(fullSize);
+    });
+}
+
 NAN_METHOD(EnvWrap::ctor) {
     Nan::HandleScope scope;
 
@@ -97,65 +453,854 @@ int applyUint32Setting(int (*f)(MDB_env *, T), MDB_env* e, Local<Object> options
         rc = f(e, dflt);
     }
 
-    return rc;
-}
+    return rc;
+}
+
+class SyncWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    SyncWorker(MDB_env* env, TraceBuffer *traceBuffer, Nan::Callback *callback)
+      : PromiseWorker(callback, "node-lmdb:Sync"), env(env), trace(traceBuffer, "node-lmdb:Sync") {}
+
+    void Execute() {
+        trace.executing();
+        int rc = mdb_env_sync(env, 1);
+        if (rc != 0) {
+            SetErrorMessage(mdb_strerror(rc));
+        }
+        trace.executed();
+    }
+
+    void WorkComplete() {
+        trace.callingBack();
+        Nan::AsyncWorker::WorkComplete();
+        trace.calledBack();
+    }
+
+  private:
+    MDB_env* env;
+    WorkTrace trace;
+};
+
+class CopyWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    CopyWorker(MDB_env* env, char* inPath, int flags, TraceBuffer *traceBuffer, Nan::Callback *callback)
+      : PromiseWorker(callback, "node-lmdb:Copy"), env(env), flags(flags), path(strdup(inPath)), trace(traceBuffer, "node-lmdb:Copy") {
+      }
+    ~CopyWorker() {
+        free(path);
+    }
+
+    void Execute() {
+        trace.executing();
+        int rc = mdb_env_copy2(env, path, flags);
+        if (rc != 0) {
+            fprintf(stderr, "Error on copy code: %u\n", rc);
+            SetErrorMessage("Error on copy");
+        }
+        trace.executed();
+    }
+
+    void WorkComplete() {
+        trace.callingBack();
+        Nan::AsyncWorker::WorkComplete();
+        trace.calledBack();
+    }
+
+  private:
+    MDB_env* env;
+    char* path;
+    int flags;
+    WorkTrace trace;
+};
+
+#ifdef _WIN32
+typedef HANDLE pipe_end_t;
+static bool openPipe(pipe_end_t ends[2]) {
+    return CreatePipe(&ends[0], &ends[1], nullptr, 0);
+}
+static int readPipe(pipe_end_t end, char *buffer, size_t size) {
+    DWORD count;
+    if (!ReadFile(end, buffer, (DWORD) size, &count, nullptr)) {
+        // The copy closed its end
+        return GetLastError() == ERROR_BROKEN_PIPE ? 0 : -1;
+    }
+    return (int) count;
+}
+static void closePipe(pipe_end_t end) {
+    CloseHandle(end);
+}
+#else
+typedef int pipe_end_t;
+static bool openPipe(pipe_end_t ends[2]) {
+    return pipe(ends) == 0;
+}
+static int readPipe(pipe_end_t end, char *buffer, size_t size) {
+    ssize_t count;
+    do {
+        count = read(end, buffer, size);
+    } while (count < 0 && errno == EINTR);
+    return (int) count;
+}
+static void closePipe(pipe_end_t end) {
+    close(end);
+}
+#endif
+
+/*
+    Copies the environment into a writable stream: a thread writes the copy into a pipe with `mdb_env_copyfd2`,
+    and another one reads it and hands it to the main thread in chunks, at most bytesPerSecond and no faster than the stream writes them.
+    Neither of them is a thread of the libuv pool, which a throttled copy would hold for its whole duration.
+    The copy is cancelled when the stream fails, or is closed or destroyed before the copy is finished.
+*/
+class CopyStream {
+  public:
+    CopyStream(EnvWrap *ew, int flags, double bytesPerSecond, bool end, AsyncCompletion *completion)
+      : ew(ew), env(ew->env), flags(flags), bytesPerSecond(bytesPerSecond), end(end), completion(completion), resource("node-lmdb:CopyToStream") {
+        uv_sem_init(&credits, COPY_CHUNKS_IN_FLIGHT);
+        uv_mutex_init(&mutex);
+        // The copy is a read transaction, the environment can't be closed or resized until it's finished
+        ew->backgroundReaders++;
+    }
+
+    ~CopyStream() {
+        envObject.Reset();
+        stream.Reset();
+        writeDoneFunction.Reset();
+        cancelFunction.Reset();
+        uv_mutex_destroy(&mutex);
+        uv_sem_destroy(&credits);
+        delete completion;
+    }
+
+    void start(Local<Object> envObject, Local<Object> stream) {
+        this->envObject.Reset(envObject);
+        this->stream.Reset(stream);
+        writeDoneFunction.Reset(Nan::GetFunction(Nan::New<FunctionTemplate>(writeDone, Nan::New<External>(this))).ToLocalChecked());
+        cancelFunction.Reset(Nan::GetFunction(Nan::New<FunctionTemplate>(cancel, Nan::New<External>(this))).ToLocalChecked());
+        listen("on", "error");
+        listen("on", "close");
+
+        async = new uv_async_t;
+        uv_async_init(Nan::GetCurrentEventLoop(), async, [](uv_async_t *handle) -> void {
+            ((CopyStream*) handle->data)->deliver();
+        });
+        async->data = this;
+        uv_thread_create(&thread, run, this);
+    }
+
+    // Called by the stream when it has written a chunk
+    static NAN_METHOD(writeDone) {
+        CopyStream *cs = (CopyStream*) Local<External>::Cast(info.Data())->Value();
+        cs->inFlight--;
+        if (!info[0]->IsNull() && !info[0]->IsUndefined()) {
+            cs->abort(info[0], "The stream failed.");
+        }
+        uv_sem_post(&cs->credits);
+        cs->completeIfDone();
+        cs->release();
+    }
+
+    // Called when the stream emits an error, or is closed
+    static NAN_METHOD(cancel) {
+        CopyStream *cs = (CopyStream*) Local<External>::Cast(info.Data())->Value();
+        cs->abort(info[0], "The stream was closed before the copy was finished.");
+        cs->completeIfDone();
+    }
+
+  private:
+    // Reads the copy from the pipe, on its own thread
+    static void run(void *arg) {
+        CopyStream *cs = (CopyStream*) arg;
+        pipe_end_t ends[2];
+        if (!openPipe(ends)) {
+            cs->finishReading("Couldn't create a pipe for the copy.");
+            return;
+        }
+
+        int copyResult = 0;
+        std::thread copier([cs, &ends, &copyResult]() -> void {
+            copyResult = mdb_env_copyfd2(cs->env, ends[1], cs->flags);
+            // Lets the reader see the end of the copy
+            closePipe(ends[1]);
+        });
+
+        size_t chunkSize = COPY_CHUNK_SIZE;
+        if (cs->bytesPerSecond) {
+            // Smaller chunks make a smoother rate
+            chunkSize = std::max((size_t) 4096, std::min(chunkSize, (size_t) (cs->bytesPerSecond / 10)));
+        }
+        double sent = 0;
+        auto start = std::chrono::steady_clock::now();
+        bool readError = false;
+        bool finished = false;
+
+        while (!finished && !cs->aborted) {
+            std::vector<char> chunk(chunkSize);
+            size_t filled = 0;
+            while (filled < chunkSize) {
+                int count = readPipe(ends[0], chunk.data() + filled, chunkSize - filled);
+                if (count <= 0) {
+                    readError = count < 0;
+                    finished = true;
+                    break;
+                }
+                filled += count;
+            }
+            if (!filled || readError) {
+                break;
+            }
+            chunk.resize(filled);
+
+            if (cs->bytesPerSecond) {
+                // Sleeps in steps, so that a cancelled copy doesn't wait for a slow rate
+                auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((sent + filled) / cs->bytesPerSecond));
+                while (!cs->aborted && std::chrono::steady_clock::now() < due) {
+                    std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(50)));
+                }
+            }
+
+            // Waits until the stream has room for another chunk
+            uv_sem_wait(&cs->credits);
+            if (cs->aborted) {
+                break;
+            }
+            uv_mutex_lock(&cs->mutex);
+            cs->chunks.push_back(std::move(chunk));
+            uv_mutex_unlock(&cs->mutex);
+            uv_async_send(cs->async);
+            sent += filled;
+        }
+
+        // When the copy is stopped early, this makes it fail instead of waiting for a reader
+        closePipe(ends[0]);
+        copier.join();
+
+        if (copyResult != 0) {
+            cs->finishReading(mdb_strerror(copyResult));
+        }
+        else if (readError) {
+            cs->finishReading("Couldn't read the copy from the pipe.");
+        }
+        else {
+            cs->finishReading(nullptr);
+        }
+    }
+
+    void finishReading(const char *error) {
+        uv_mutex_lock(&mutex);
+        if (error) {
+            copyError = error;
+        }
+        readerDone = true;
+        uv_mutex_unlock(&mutex);
+        uv_async_send(async);
+    }
+
+    // Passes the chunks that were read to the stream, on the main thread
+    void deliver() {
+        Nan::HandleScope scope;
+        std::vector<std::vector<char>> ready;
+        uv_mutex_lock(&mutex);
+        ready.swap(chunks);
+        bool done = readerDone;
+        uv_mutex_unlock(&mutex);
+
+        // The stream may call back synchronously
+        refs++;
+        Local<Object> streamObject = Nan::New(stream);
+        for (auto &chunk : ready) {
+            if (aborted || completed) {
+                break;
+            }
+            inFlight++;
+            refs++;
+            Local<Value> argv[] = {
+                Nan::CopyBuffer(chunk.data(), chunk.size()).ToLocalChecked(),
+                Nan::New(writeDoneFunction)
+            };
+            resource.runInAsyncScope(streamObject, "write", 2, argv);
+        }
+
+        if (done && !readerJoined) {
+            uv_thread_join(&thread);
+            readerJoined = true;
+            uv_close((uv_handle_t*) async, [](uv_handle_t *handle) -> void {
+                delete (uv_async_t*) handle;
+            });
+        }
+        completeIfDone();
+        release();
+    }
+
+    // Stops the copy, the first error is the one reported
+    void abort(Local<Value> error, const char *defaultMessage) {
+        if (aborted || completed) {
+            return;
+        }
+        if (error->IsObject()) {
+            error = Local<Object>::Cast(error)->Get(Nan::GetCurrentContext(), Nan::New<String>("message").ToLocalChecked()).ToLocalChecked();
+        }
+        Nan::Utf8String message(error);
+        streamError = (error->IsString() && *message) ? *message : defaultMessage;
+        aborted = true;
+        // Wakes up the reader if it waits for the stream
+        for (int i = 0; i < COPY_CHUNKS_IN_FLIGHT; i++) {
+            uv_sem_post(&credits);
+        }
+    }
+
+    // Calls back once the reader has stopped, and the stream has written every chunk unless it failed
+    void completeIfDone() {
+        if (completed || !readerJoined || (inFlight && !aborted)) {
+            return;
+        }
+        completed = true;
+        Nan::HandleScope scope;
+        listen("removeListener", "error");
+        listen("removeListener", "close");
+        ew->backgroundReaders--;
+        ew->runIdleCallbacks();
+
+        Local<Value> error = Nan::Null();
+        if (aborted) {
+            error = Nan::Error(streamError.c_str());
+        }
+        else if (!copyError.empty()) {
+            error = Nan::Error(copyError.c_str());
+        }
+        else if (end) {
+            resource.runInAsyncScope(Nan::New(stream), "end", 0, nullptr);
+        }
+        completion->settle(error, Nan::Undefined(), &resource);
+        release();
+    }
+
+    void listen(const char *method, const char *event) {
+        Local<Value> argv[] = {
+            Nan::New<String>(event).ToLocalChecked(),
+            Nan::New(cancelFunction)
+        };
+        resource.runInAsyncScope(Nan::New(stream), method, 2, argv);
+    }
+
+    // The stream may call back the writes after the copy is finished
+    void release() {
+        if (--refs == 0) {
+            delete this;
+        }
+    }
+
+    EnvWrap *ew;
+    MDB_env *env;
+    int flags;
+    double bytesPerSecond;
+    bool end;
+    AsyncCompletion *completion;
+    Nan::AsyncResource resource;
+    Nan::Persistent<Object> envObject;
+    Nan::Persistent<Object> stream;
+    Nan::Persistent<Function> writeDoneFunction;
+    Nan::Persistent<Function> cancelFunction;
+    uv_thread_t thread;
+    uv_async_t *async = nullptr;
+    // Chunks that may still be passed to the stream
+    uv_sem_t credits;
+    // Protects the chunks, readerDone and copyError
+    uv_mutex_t mutex;
+    std::vector<std::vector<char>> chunks;
+    bool readerDone = false;
+    std::string copyError;
+    // Only used on the main thread
+    bool readerJoined = false;
+    bool completed = false;
+    int inFlight = 0;
+    // The copy itself and the writes that weren't called back yet
+    int refs = 1;
+    // Set when the stream fails or is closed
+    std::atomic<bool> aborted{false};
+    std::string streamError;
+};
+
+// Identifies the files of incremental backups
+#define DELTA_MAGIC "LMDBDLT1"
+#define SIGNATURE_MAGIC "LMDBSIG1"
+
+/*
+    Header of the files of incremental backups.
+    A signature holds a 64-bit hash of every page of a snapshot,
+    a delta holds runs of the pages that changed since the base snapshot: the number of the first page and the number of pages, followed by the pages.
+*/
+struct BackupHeader {
+    char magic[8];
+    uint32_t pageSize;
+    uint32_t reserved;
+    uint64_t baseTxnId;
+    uint64_t txnId;
+    uint64_t pageCount;
+};
+
+struct BackupRun {
+    uint64_t pgno;
+    uint64_t count;
+};
+
+static uint64_t pageHash(const char *page, size_t size) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, page + i, 8);
+        word *= 0x87c37b91114253d5ULL;
+        hash ^= (word << 31) | (word >> 33);
+        hash = ((hash << 27) | (hash >> 37)) * 0x4cf5ad432745937fULL + 0x52dce729;
+    }
+    return hash ^ (hash >> 32);
+}
+
+static bool seekFile(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+static bool syncFile(FILE *file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+/*
+    Writes the pages that changed since the signature of a previous backup (or every page when there isn't one) into a delta,
+    and the signature of this backup.
+*/
+class IncrementalCopyWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    IncrementalCopyWorker(EnvWrap *ew, const char *path, const char *sincePath, const char *signaturePath, Nan::Callback *callback)
+      : PromiseWorker(callback, "node-lmdb:IncrementalCopy"), ew(ew), env(ew->env), path(path), sincePath(sincePath ? sincePath : ""), signaturePath(signaturePath),
+        delta(nullptr), since(nullptr), signature(nullptr), changedPages(0) {
+        memset(&sinceHeader, 0, sizeof(sinceHeader));
+        memset(&info, 0, sizeof(info));
+        // The copy is a read transaction, the environment can't be closed or resized until it's finished
+        ew->backgroundReaders++;
+    }
+
+    ~IncrementalCopyWorker() {
+        ew->backgroundReaders--;
+        ew->runIdleCallbacks();
+    }
+
+    void Execute() {
+        MDB_stat stat;
+        mdb_env_stat(env, &stat);
+        pageSize = stat.ms_psize;
+
+        if (!sincePath.empty()) {
+            since = fopen(sincePath.c_str(), "rb");
+            if (!since) {
+                return fail("Couldn't open the signature of the previous backup");
+            }
+            if (fread(&sinceHeader, sizeof(sinceHeader), 1, since) != 1 || memcmp(sinceHeader.magic, SIGNATURE_MAGIC, 8)) {
+                return fail("The signature of the previous backup is not valid.", false);
+            }
+            if (sinceHeader.pageSize != pageSize) {
+                return fail("The signature of the previous backup has a different page size.", false);
+            }
+        }
+
+        delta = fopen(path.c_str(), "wb");
+        if (!delta) {
+            return fail("Couldn't create the delta");
+        }
+        // The signature replaces the previous one (that may be the same file) when the delta is complete
+        std::string newSignaturePath = signaturePath + ".tmp";
+        signature = fopen(newSignaturePath.c_str(), "wb");
+        if (!signature) {
+            return fail("Couldn't create the signature");
+        }
+
+        int rc = mdb_env_walk_pages(env, [](void *ctx, mdb_size_t pgno, const void *pages, mdb_size_t count) -> int {
+            return ((IncrementalCopyWorker*) ctx)->takePages(pgno, (const char*) pages, count);
+        }, this, &info);
+        if (rc != 0) {
+            remove(newSignaturePath.c_str());
+            return fail(mdb_strerror(rc), false);
+        }
+
+        bool written = syncFile(delta) && syncFile(signature);
+        written = fclose(delta) == 0 && written;
+        written = fclose(signature) == 0 && written;
+        delta = signature = nullptr;
+        if (!written) {
+            remove(newSignaturePath.c_str());
+            return fail("Couldn't write the backup");
+        }
+#ifdef _WIN32
+        remove(signaturePath.c_str());
+#endif
+        if (rename(newSignaturePath.c_str(), signaturePath.c_str()) != 0) {
+            return fail("Couldn't replace the signature");
+        }
+        closeFiles();
+    }
+
+    Local<Value> result() {
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Object> obj = Nan::New<Object>();
+        (void)obj->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>((double) info.me_last_txnid));
+        (void)obj->Set(context, Nan::New<String>("baseTxnId").ToLocalChecked(), Nan::New<Number>((double) sinceHeader.txnId));
+        (void)obj->Set(context, Nan::New<String>("pages").ToLocalChecked(), Nan::New<Number>((double) (info.me_last_pgno + 1)));
+        (void)obj->Set(context, Nan::New<String>("changedPages").ToLocalChecked(), Nan::New<Number>((double) changedPages));
+        return obj;
+    }
+
+  private:
+    // Called with the meta pages first, and then with the rest of the pages
+    int takePages(mdb_size_t pgno, const char *pages, mdb_size_t count) {
+        if (pgno == 0) {
+            BackupHeader header;
+            memset(&header, 0, sizeof(header));
+            header.pageSize = pageSize;
+            header.baseTxnId = sinceHeader.txnId;
+            header.txnId = info.me_last_txnid;
+            header.pageCount = info.me_last_pgno + 1;
+            memcpy(header.magic, DELTA_MAGIC, 8);
+            if (fwrite(&header, sizeof(header), 1, delta) != 1) {
+                return EIO;
+            }
+            header.baseTxnId = 0;
+            memcpy(header.magic, SIGNATURE_MAGIC, 8);
+            if (fwrite(&header, sizeof(header), 1, signature) != 1) {
+                return EIO;
+            }
+        }
+
+        mdb_size_t runStart = 0, runLength = 0;
+        for (mdb_size_t i = 0; i < count; i++) {
+            uint64_t hash = pageHash(pages + i * pageSize, pageSize);
+            if (fwrite(&hash, sizeof(hash), 1, signature) != 1) {
+                return EIO;
+            }
+
+            // The previous signature is read along, it has the hashes in the same order
+            uint64_t previousHash;
+            bool known = since && pgno + i < sinceHeader.pageCount && fread(&previousHash, sizeof(previousHash), 1, since) == 1;
+            // The meta pages are always copied
+            if (pgno == 0 || !known || previousHash != hash) {
+                if (!runLength) {
+                    runStart = i;
+                }
+                runLength++;
+            }
+            else if (runLength) {
+                if (!writeRun(pgno + runStart, pages + runStart * pageSize, runLength)) {
+                    return EIO;
+                }
+                runLength = 0;
+            }
+        }
+        if (runLength && !writeRun(pgno + runStart, pages + runStart * pageSize, runLength)) {
+            return EIO;
+        }
+        return 0;
+    }
+
+    bool writeRun(mdb_size_t pgno, const char *pages, mdb_size_t count) {
+        BackupRun run = { pgno, count };
+        changedPages += count;
+        return fwrite(&run, sizeof(run), 1, delta) == 1 && fwrite(pages, pageSize, count, delta) == count;
+    }
+
+    void fail(const char *message, bool withErrno = true) {
+        std::string error = message;
+        if (withErrno) {
+            error = error + ": " + strerror(errno);
+        }
+        closeFiles();
+        SetErrorMessage(error.c_str());
+    }
+
+    void closeFiles() {
+        if (delta) {
+            fclose(delta);
+        }
+        if (since) {
+            fclose(since);
+        }
+        if (signature) {
+            fclose(signature);
+        }
+        delta = since = signature = nullptr;
+    }
+
+    EnvWrap *ew;
+    MDB_env *env;
+    std::string path;
+    std::string sincePath;
+    std::string signaturePath;
+    FILE *delta;
+    FILE *since;
+    FILE *signature;
+    BackupHeader sinceHeader;
+    MDB_envinfo info;
+    unsigned int pageSize;
+    mdb_size_t changedPages;
+};
+
+/*
+    Applies a delta onto a copy of the environment, which must be at the base transaction of the delta (or not exist, when the delta has every page).
+    The meta pages are written last, so the copy stays at the base transaction until every other page is written.
+*/
+class ApplyDeltaWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    ApplyDeltaWorker(const char *path, const char *deltaPath, Nan::Callback *callback)
+      : PromiseWorker(callback, "node-lmdb:ApplyDelta"), path(path), deltaPath(deltaPath), delta(nullptr), target(nullptr) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    void Execute() {
+        delta = fopen(deltaPath.c_str(), "rb");
+        if (!delta) {
+            return fail("Couldn't open the delta");
+        }
+        if (fread(&header, sizeof(header), 1, delta) != 1 || memcmp(header.magic, DELTA_MAGIC, 8) || !header.pageSize) {
+            return fail("The delta is not valid.", false);
+        }
+
+        std::string error = checkBase();
+        if (!error.empty()) {
+            return fail(error.c_str(), false);
+        }
+
+        target = fopen(path.c_str(), header.baseTxnId ? "r+b" : "wb");
+        if (!target) {
+            return fail("Couldn't open the file to restore");
+        }
+
+        std::vector<char> metas;
+        std::vector<char> buffer;
+        BackupRun run;
+        while (fread(&run, sizeof(run), 1, delta) == 1) {
+            if (run.pgno + run.count > header.pageCount) {
+                return fail("The delta is not valid.", false);
+            }
+            for (uint64_t i = 0; i < run.count; i++) {
+                buffer.resize(header.pageSize);
+                if (fread(buffer.data(), header.pageSize, 1, delta) != 1) {
+                    return fail("The delta is truncated.", false);
+                }
+                uint64_t pgno = run.pgno + i;
+                // The meta pages (0 and 1) come first in a delta, they are kept until the end
+                if (pgno < 2) {
+                    metas.insert(metas.end(), buffer.begin(), buffer.end());
+                    continue;
+                }
+                if (!seekFile(target, pgno * header.pageSize) || fwrite(buffer.data(), header.pageSize, 1, target) != 1) {
+                    return fail("Couldn't write the file to restore");
+                }
+            }
+        }
+        if (!feof(delta) || ferror(delta) || metas.size() != 2 * (size_t) header.pageSize) {
+            return fail("The delta is truncated.", false);
+        }
+
+        // The data pages must be on the disk before the meta pages point at them
+        if (!syncFile(target) || !seekFile(target, 0) || fwrite(metas.data(), metas.size(), 1, target) != 1 || !syncFile(target)) {
+            return fail("Couldn't write the file to restore");
+        }
+        closeFiles();
+    }
+
+    Local<Value> result() {
+        Local<Object> obj = Nan::New<Object>();
+        (void)obj->Set(Nan::GetCurrentContext(), Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>((double) header.txnId));
+        return obj;
+    }
 
-class SyncWorker : public Nan::AsyncWorker {
-  public:
-    SyncWorker(MDB_env* env, Nan::Callback *callback)
-      : Nan::AsyncWorker(callback), env(env) {}
+  private:
+    // Checks that the delta was made on top of the file
+    std::string checkBase() {
+        if (!header.baseTxnId) {
+            FILE *existing = fopen(path.c_str(), "rb");
+            if (!existing) {
+                return "";
+            }
+            bool empty = fgetc(existing) == EOF;
+            fclose(existing);
+            return empty ? "" : "The delta has every page, it must be applied to a new file.";
+        }
 
-    void Execute() {
-        int rc = mdb_env_sync(env, 1);
+        MDB_env *base;
+        MDB_envinfo info;
+        MDB_stat stat;
+        int rc = mdb_env_create(&base);
+        if (rc == 0) {
+            rc = mdb_env_open(base, path.c_str(), MDB_NOSUBDIR | MDB_RDONLY | MDB_NOLOCK, 0664);
+            if (rc == 0) {
+                mdb_env_info(base, &info);
+                mdb_env_stat(base, &stat);
+            }
+            mdb_env_close(base);
+        }
         if (rc != 0) {
-            SetErrorMessage(mdb_strerror(rc));
+            return std::string("Couldn't open the file to restore: ") + mdb_strerror(rc);
+        }
+        if (stat.ms_psize != header.pageSize) {
+            return "The delta doesn't apply to this file, it has a different page size.";
         }
+        if (info.me_last_txnid != header.baseTxnId) {
+            return "The delta doesn't apply to this file, it was made after transaction " + std::to_string(header.baseTxnId) +
+                " and the file is at transaction " + std::to_string(info.me_last_txnid) + ".";
+        }
+        return "";
     }
 
-    void HandleOKCallback() {
-        Nan::HandleScope scope;
-        v8::Local<v8::Value> argv[] = {
-            Nan::Null()
-        };
+    void fail(const char *message, bool withErrno = true) {
+        std::string error = message;
+        if (withErrno) {
+            error = error + ": " + strerror(errno);
+        }
+        closeFiles();
+        SetErrorMessage(error.c_str());
+    }
 
-        callback->Call(1, argv, async_resource);
+    void closeFiles() {
+        if (delta) {
+            fclose(delta);
+        }
+        if (target) {
+            fclose(target);
+        }
+        delta = target = nullptr;
     }
 
-  private:
-    MDB_env* env;
+    std::string path;
+    std::string deltaPath;
+    FILE *delta;
+    FILE *target;
+    BackupHeader header;
 };
 
-class CopyWorker : public Nan::AsyncWorker {
+#ifndef _WIN32
+// Number of compacting copies that are made before giving up, when something is committed during each copy
+#define COMPACT_ATTEMPTS (3)
+
+/*
+    Makes a compacted copy of the environment, which replaces the data file once the environment is idle.
+    The copy is made again if something was committed meanwhile.
+*/
+class CompactWorker : public Nan::AsyncWorker {
   public:
-    CopyWorker(MDB_env* env, char* inPath, int flags, Nan::Callback *callback)
-      : Nan::AsyncWorker(callback), env(env), flags(flags), path(strdup(inPath)) {
-      }
-    ~CopyWorker() {
-        free(path);
+    CompactWorker(EnvWrap *ew, std::string tmpPath, int attempts, double pagesBefore, AsyncCompletion *completion)
+      : Nan::AsyncWorker(nullptr, "node-lmdb:Compact"), ew(ew), tmpPath(tmpPath), attempts(attempts), pagesBefore(pagesBefore), completion(completion) {
+        MDB_envinfo envinfo;
+        mdb_env_info(ew->env, &envinfo);
+        txnId = envinfo.me_last_txnid;
+        // The copy is a read transaction, the environment can't be closed or resized until it's finished
+        ew->backgroundReaders++;
+    }
+
+    static void start(EnvWrap *ew, std::string tmpPath, int attempts, double pagesBefore, AsyncCompletion *completion) {
+        Nan::AsyncQueueWorker(new CompactWorker(ew, tmpPath, attempts, pagesBefore, completion));
     }
 
     void Execute() {
-        int rc = mdb_env_copy2(env, path, flags);
+        struct stat dataStat;
+        mdb_filehandle_t dataFd;
+        mdb_env_get_fd(ew->env, &dataFd);
+        int mode = fstat(dataFd, &dataStat) == 0 ? (dataStat.st_mode & 0777) : 0644;
+
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+        if (fd < 0) {
+            return SetErrorMessage(strerror(errno));
+        }
+        int rc = mdb_env_copyfd2(ew->env, fd, MDB_CP_COMPACT);
+        if (rc == 0 && fsync(fd) != 0) {
+            rc = errno;
+        }
+        close(fd);
         if (rc != 0) {
-            fprintf(stderr, "Error on copy code: %u\n", rc);
-            SetErrorMessage("Error on copy");
+            unlink(tmpPath.c_str());
+            SetErrorMessage(mdb_strerror(rc));
         }
     }
 
+    void WorkComplete() {
+        ew->backgroundReaders--;
+        Nan::AsyncWorker::WorkComplete();
+        ew->runIdleCallbacks();
+    }
+
     void HandleOKCallback() {
-        Nan::HandleScope scope;
-        v8::Local<v8::Value> argv[] = {
-            Nan::Null()
-        };
+        EnvWrap *ew = this->ew;
+        std::string tmpPath = this->tmpPath;
+        mdb_size_t txnId = this->txnId;
+        int attempts = this->attempts;
+        double pagesBefore = this->pagesBefore;
+        AsyncCompletion *completion = this->completion;
+        ew->whenIdle([ew, tmpPath, txnId, attempts, pagesBefore, completion]() -> void {
+            replace(ew, tmpPath, txnId, attempts, pagesBefore, completion);
+        });
+    }
 
-        callback->Call(1, argv, async_resource);
+    void HandleErrorCallback() {
+        Nan::HandleScope scope;
+        completion->settle(Nan::Error(ErrorMessage()), Nan::Undefined(), async_resource);
+        delete completion;
     }
 
   private:
-    MDB_env* env;
-    char* path;
-    int flags;
+    // Replaces the data file with the copy, once no transaction uses it
+    static void replace(EnvWrap *ew, std::string tmpPath, mdb_size_t txnId, int attempts, double pagesBefore, AsyncCompletion *completion) {
+        Nan::HandleScope scope;
+        Local<Value> error = Nan::Null();
+        Local<Value> result = Nan::Undefined();
+
+        if (!ew->env) {
+            error = Nan::Error("The environment was closed before it could be compacted.");
+        }
+        else if (ew->openCount() > 1) {
+            error = Nan::Error("The environment can't be compacted while it's opened more than once in this process.");
+        }
+        else {
+            int rc = ew->replaceFile(tmpPath.c_str(), txnId);
+            if (rc == EAGAIN && attempts > 1) {
+                // Something was committed during the copy
+                return start(ew, tmpPath, attempts - 1, pagesBefore, completion);
+            }
+            if (rc != 0) {
+                error = Nan::Error(mdb_strerror(rc));
+            }
+            else {
+                MDB_envinfo envinfo;
+                mdb_env_info(ew->env, &envinfo);
+                Local<Object> obj = Nan::New<Object>();
+                (void)obj->Set(Nan::GetCurrentContext(), Nan::New<String>("pagesBefore").ToLocalChecked(), Nan::New<Number>(pagesBefore));
+                (void)obj->Set(Nan::GetCurrentContext(), Nan::New<String>("pagesAfter").ToLocalChecked(), Nan::New<Number>((double) (envinfo.me_last_pgno + 1)));
+                result = obj;
+            }
+        }
+        unlink(tmpPath.c_str());
+
+        Nan::AsyncResource resource("node-lmdb:Compact");
+        completion->settle(error, result, &resource);
+        delete completion;
+    }
+
+    EnvWrap *ew;
+    std::string tmpPath;
+    mdb_size_t txnId;
+    int attempts;
+    double pagesBefore;
+    // Called when the data file is replaced, which can be after this worker is gone
+    AsyncCompletion *completion;
 };
+#endif
 
 struct condition_t {
     MDB_val key;
@@ -175,23 +1320,36 @@ struct action_t {
 
 int deleteValue; // pointer to this as the value represents a delete
 
-class BatchWorker : public Nan::AsyncProgressWorker {
+class BatchWorker : public PromiseWorker<Nan::AsyncProgressWorker> {
   public:
-    BatchWorker(MDB_env* env, action_t *actions, int actionCount, int putFlags, Nan::Callback *callback, Nan::Callback *progress)
-      : Nan::AsyncProgressWorker(callback, "node-lmdb:Batch"),
+    BatchWorker(EnvWrap *ew, action_t *actions, int actionCount, int putFlags, bool stats, Nan::Callback *callback, Nan::Callback *progress)
+      : PromiseWorker(callback, "node-lmdb:Batch"),
       actions(actions),
       actionCount(actionCount),
       putFlags(putFlags),
-      env(env),
-      progress(progress) {
+      stats(stats),
+      env(ew->env),
+      ew(ew),
+      autoGrow(ew->growStep != 0),
+      progress(progress),
+      metrics(ew->envMetrics),
+      queuedAt(ew->envMetrics ? uv_hrtime() : 0),
+      trace(ew->traceBuffer, "node-lmdb:Batch") {
         results = new int[actionCount];
     }
 
     ~BatchWorker() {
         for (int i = 0; i < actionCount; i++) {
             action_t* action = &actions[i];
+            // Keys are kept until the end, in case the batch is written again after growing the map
+            if (action->freeKey) {
+                action->freeKey(action->key);
+            }
             condition_t* condition = action->condition;
             if (condition) {
+                if (condition->freeKey) {
+                    condition->freeKey(condition->key);
+                }
                 delete condition;
             }
         }
@@ -201,12 +1359,31 @@ class BatchWorker : public Nan::AsyncProgressWorker {
     }
 
     void Execute(const ExecutionProgress& executionProgress) {
+        if (metrics) {
+            metrics->record(Metric::BatchQueueWait, uv_hrtime() - queuedAt);
+        }
+        MetricTimer timer(metrics, Metric::Batch);
+        trace.executing();
+        write(executionProgress, timer);
+        trace.executed(actionCount, written);
+    }
+
+    // Writes the batch in one transaction
+    void write(const ExecutionProgress& executionProgress, MetricTimer &timer) {
+        if (growError) {
+            return SetErrorMessage(mdb_strerror(growError));
+        }
+
         MDB_txn *txn;
         int rc = mdb_txn_begin(env, nullptr, 0, &txn);
         if (rc != 0) {
             return SetErrorMessage(mdb_strerror(rc));
         }
+        if (stats) {
+            mdb_txn_commit_stat(txn, &commitStat);
+        }
         int getCount = 0;
+        written = 0;
 
         for (int i = 0; i < actionCount;) {
             action_t* action = &actions[i];
@@ -247,17 +1424,20 @@ class BatchWorker : public Nan::AsyncProgressWorker {
                     }
                 } else {
                     rc = mdb_put(txn, action->dbi, &action->key, &action->data, putFlags);
+                    written += action->key.mv_size + action->data.mv_size;
                 }
             }
 
-            if (action->freeKey) { // if we created a key and needs to be cleaned up, do it now
-                action->freeKey(action->key);
-            }
             if (rc != 0) {
                 if (rc == MDB_BAD_VALSIZE)
                     results[i] = 3;
                 else {
                     mdb_txn_abort(txn);
+                    mapFull = autoGrow && rc == MDB_MAP_FULL;
+                    if (mapFull) {
+                        // Written again once the map has grown
+                        return;
+                    }
                     return SetErrorMessage(mdb_strerror(rc));
                 }
             }
@@ -268,9 +1448,51 @@ class BatchWorker : public Nan::AsyncProgressWorker {
         }
 
         rc = mdb_txn_commit(txn);
-        if (rc != 0) {
+        mapFull = autoGrow && rc == MDB_MAP_FULL;
+        if (rc != 0 && !mapFull) {
             return SetErrorMessage(mdb_strerror(rc));
         }
+        if (rc == 0) {
+            timer.written(written);
+        }
+    }
+
+    void WorkComplete() {
+        ew->backgroundWriters--;
+        retrying = mapFull;
+        trace.callingBack();
+
+        if (mapFull) {
+            // Grow the map once nothing uses it, then write the whole batch again
+            MDB_envinfo envinfo;
+            mdb_env_info(env, &envinfo);
+            mdb_size_t fullSize = envinfo.me_mapsize;
+            mapFull = false;
+
+            ew->whenIdle([this, fullSize]() -> void {
+                growError = ew->growMap(fullSize);
+                resultIndex = 0;
+                ew->backgroundWriters++;
+                queuedAt = metrics ? uv_hrtime() : 0;
+                trace.queued();
+                Nan::AsyncQueueWorker(this);
+            });
+            return;
+        }
+
+        if (!ErrorMessage()) {
+            ew->committed();
+        }
+        Nan::AsyncProgressWorker::WorkComplete();
+        trace.calledBack();
+        ew->runIdleCallbacks();
+    }
+
+    void Destroy() {
+        // The worker is reused when the batch is written again
+        if (!retrying) {
+            Nan::AsyncProgressWorker::Destroy();
+        }
     }
 
     v8::Local<v8::Array> updatedResultsArray(int currentIndex) {
@@ -298,25 +1520,38 @@ class BatchWorker : public Nan::AsyncProgressWorker {
         progress->Call(1, argv, async_resource);
     }
 
-    void HandleOKCallback() {
-        Nan::HandleScope scope;
-        v8::Local<v8::Value> argv[] = {
-            Nan::Null(),
-            updatedResultsArray(actionCount)
-        };
-
-        callback->Call(2, argv, async_resource);
+    Local<Value> result() {
+        v8::Local<v8::Array> resultsArray = updatedResultsArray(actionCount);
+        if (stats) {
+            // On the results, so that it's also there when batchWrite returns a promise
+            (void)resultsArray->Set(Nan::GetCurrentContext(), Nan::New<String>("stats").ToLocalChecked(), commitStatToObject(commitStat));
+        }
+        return resultsArray;
     }
 
   private:
     MDB_env* env;
+    EnvWrap* ew;
+    bool autoGrow;
+    bool mapFull = false;
+    bool retrying = false;
+    int growError = 0;
     int actionCount;
     int* results;
     int resultIndex = 0;
     bool hasResultsArray = false;
     action_t* actions;
     int putFlags;
+    // Whether to collect the statistics of the commit
+    bool stats;
+    MDB_commit_stat commitStat;
     Nan::Callback* progress;
+    EnvMetrics *metrics;
+    // When the batch was queued, if the metrics are enabled
+    uint64_t queuedAt;
+    WorkTrace trace;
+    // Bytes of the keys and values put by the batch
+    size_t written = 0;
 };
 
 
@@ -336,15 +1571,138 @@ NAN_METHOD(EnvWrap::open) {
 
     Local<Object> options = Local<Object>::Cast(info[0]);
     Local<String> path = Local<String>::Cast(options->Get(Nan::GetCurrentContext(), Nan::New<String>("path").ToLocalChecked()).ToLocalChecked());
+
+    // Parse the autoGrow option, which belongs to this Env even if the environment is shared
+    Local<Value> autoGrowOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("autoGrow").ToLocalChecked()).ToLocalChecked();
+    if (autoGrowOption->IsObject()) {
+        Local<Object> autoGrow = Local<Object>::Cast(autoGrowOption);
+        Local<Value> step = autoGrow->Get(Nan::GetCurrentContext(), Nan::New<String>("step").ToLocalChecked()).ToLocalChecked();
+        Local<Value> max = autoGrow->Get(Nan::GetCurrentContext(), Nan::New<String>("max").ToLocalChecked()).ToLocalChecked();
+        if (!step->IsNumber() || step->IntegerValue(Nan::GetCurrentContext()).FromJust() <= 0) {
+            return Nan::ThrowError("The autoGrow option needs a step, which is a positive number of bytes.");
+        }
+        if (!max->IsUndefined() && !max->IsNumber()) {
+            return Nan::ThrowError("The max of the autoGrow option should be a number of bytes.");
+        }
+        ew->growStep = step->IntegerValue(Nan::GetCurrentContext()).FromJust();
+        ew->growMax = max->IsNumber() ? max->IntegerValue(Nan::GetCurrentContext()).FromJust() : (mdb_size_t) -1;
+    }
+    else if (!autoGrowOption->IsUndefined()) {
+        return Nan::ThrowError("The autoGrow option should be an object with step and max properties.");
+    }
+
+    // Parse the background sync options, which also belong to this Env
+    Local<Value> syncIntervalOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("syncInterval").ToLocalChecked()).ToLocalChecked();
+    Local<Value> syncEveryBytesOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("syncEveryBytes").ToLocalChecked()).ToLocalChecked();
+    if (!syncIntervalOption->IsUndefined() && (!syncIntervalOption->IsNumber() || syncIntervalOption->NumberValue(Nan::GetCurrentContext()).FromJust() <= 0)) {
+        return Nan::ThrowError("The syncInterval option should be a positive number of milliseconds.");
+    }
+    if (!syncEveryBytesOption->IsUndefined() && (!syncEveryBytesOption->IsNumber() || syncEveryBytesOption->IntegerValue(Nan::GetCurrentContext()).FromJust() <= 0)) {
+        return Nan::ThrowError("The syncEveryBytes option should be a positive number of bytes.");
+    }
+    uint64_t syncInterval = syncIntervalOption->IsNumber() ? (uint64_t) (syncIntervalOption->NumberValue(Nan::GetCurrentContext()).FromJust() * 1e6) : 0;
+    mdb_size_t syncEveryBytes = syncEveryBytesOption->IsNumber() ? syncEveryBytesOption->IntegerValue(Nan::GetCurrentContext()).FromJust() : 0;
+    auto startSyncThread = [ew, syncInterval, syncEveryBytes]() -> void {
+        unsigned int envFlags = 0;
+        mdb_env_get_flags(ew->env, &envFlags);
+        // There is nothing to sync in a read-only environment
+        if ((syncInterval || syncEveryBytes) && !(envFlags & MDB_RDONLY)) {
+            ew->syncThread = new SyncThread(ew->env, syncInterval, syncEveryBytes);
+        }
+    };
+
+    // Parse the readerCheckInterval option, which also belongs to this Env
+    Local<Value> readerCheckIntervalOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("readerCheckInterval").ToLocalChecked()).ToLocalChecked();
+    if (!readerCheckIntervalOption->IsUndefined() && (!readerCheckIntervalOption->IsNumber() || readerCheckIntervalOption->IntegerValue(Nan::GetCurrentContext()).FromJust() <= 0)) {
+        return Nan::ThrowError("The readerCheckInterval option should be a positive number of milliseconds.");
+    }
+    uint64_t readerCheckInterval = readerCheckIntervalOption->IsNumber() ? readerCheckIntervalOption->IntegerValue(Nan::GetCurrentContext()).FromJust() : 0;
+    auto startReaderCheck = [ew, readerCheckInterval]() -> void {
+        if (!readerCheckInterval) {
+            return;
+        }
+        ew->readerCheckTimer = new uv_timer_t;
+        uv_timer_init(Nan::GetCurrentEventLoop(), ew->readerCheckTimer);
+        ew->readerCheckTimer->data = ew;
+        uv_timer_start(ew->readerCheckTimer, [](uv_timer_t *timer) -> void {
+            int dead;
+            mdb_reader_check(((EnvWrap*) timer->data)->env, &dead);
+        }, readerCheckInterval, readerCheckInterval);
+        // The check doesn't keep the process alive
+        uv_unref((uv_handle_t*) ew->readerCheckTimer);
+    };
+
+    // Parse the metrics option, which also belongs to this Env
+    Local<Value> metricsOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("metrics").ToLocalChecked()).ToLocalChecked();
+    if (metricsOption->IsTrue() && !ew->envMetrics) {
+        ew->envMetrics = new EnvMetrics();
+    }
+
+    // Parse the trace option, which also belongs to this Env
+    Local<Value> traceOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("trace").ToLocalChecked()).ToLocalChecked();
+    size_t traceSize = 0;
+    if (traceOption->IsTrue()) {
+        traceSize = 1024;
+    }
+    else if (traceOption->IsObject()) {
+        Local<Value> size = Local<Object>::Cast(traceOption)->Get(Nan::GetCurrentContext(), Nan::New<String>("size").ToLocalChecked()).ToLocalChecked();
+        if (!size->IsNumber() || size->IntegerValue(Nan::GetCurrentContext()).FromJust() <= 0) {
+            return Nan::ThrowError("The size of the trace option should be a positive number of spans.");
+        }
+        traceSize = size->IntegerValue(Nan::GetCurrentContext()).FromJust();
+    }
+    else if (!traceOption->IsUndefined() && !traceOption->IsFalse()) {
+        return Nan::ThrowError("The trace option should be true or an object with a size.");
+    }
+    if (traceSize && !ew->traceBuffer) {
+        ew->traceBuffer = new TraceBuffer(traceSize);
+    }
+
+    // Parse the lockBranchPages option, which also belongs to this Env
+    Local<Value> lockBranchPagesOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("lockBranchPages").ToLocalChecked()).ToLocalChecked();
+    double lockMaxBytes = 0;
+    if (lockBranchPagesOption->IsObject()) {
+        Local<Value> maxBytes = Local<Object>::Cast(lockBranchPagesOption)->Get(Nan::GetCurrentContext(), Nan::New<String>("maxBytes").ToLocalChecked()).ToLocalChecked();
+        if (!maxBytes->IsNumber() || maxBytes->NumberValue(Nan::GetCurrentContext()).FromJust() <= 0) {
+            return Nan::ThrowError("The maxBytes of the lockBranchPages option should be a positive number of bytes.");
+        }
+        lockMaxBytes = maxBytes->NumberValue(Nan::GetCurrentContext()).FromJust();
+    }
+    else if (lockBranchPagesOption->IsTrue()) {
+        // No limit
+        lockMaxBytes = -1;
+    }
+    else if (!lockBranchPagesOption->IsUndefined() && !lockBranchPagesOption->IsFalse()) {
+        return Nan::ThrowError("The lockBranchPages option should be true or an object with maxBytes.");
+    }
+    auto startBranchLocker = [ew, lockMaxBytes]() -> void {
+        if (!lockMaxBytes || (ew->branchLocker && !ew->branchLocker->isClosed())) {
+            return;
+        }
+        MDB_stat stat;
+        mdb_env_stat(ew->env, &stat);
+        size_t maxPages = lockMaxBytes < 0 ? SIZE_MAX : (size_t) (lockMaxBytes / stat.ms_psize);
+        // The locker of an Env that was closed may still have a refresh in the thread pool, so it's reused
+        if (ew->branchLocker) {
+            ew->branchLocker->reopen(maxPages);
+        }
+        else {
+            ew->branchLocker = new BranchLocker(ew, maxPages);
+        }
+    };
+
     Nan::Utf8String charPath(path);
     uv_mutex_lock(envsLock);
-    for (env_path_t envPath : envs) {
+    for (env_path_t &envPath : envs) {
         char* existingPath = envPath.path;
         if (!strcmp(existingPath, *charPath)) {
             envPath.count++;
             mdb_env_close(ew->env);
             ew->env = envPath.env;
             uv_mutex_unlock(envsLock);
+            startSyncThread();
+            startReaderCheck();
+            startBranchLocker();
             return;
         }
     }
@@ -374,6 +1732,16 @@ NAN_METHOD(EnvWrap::open) {
         return throwLmdbError(rc);
     }
 
+    // Parse the options of the memory map, they're hints that are ignored where they aren't supported
+    int mapFlags = 0;
+    setFlagFromValue(&mapFlags, MDB_MAP_POPULATE, "mapPopulate", false, options);
+    setFlagFromValue(&mapFlags, MDB_MAP_HUGEPAGE, "hugePages", false, options);
+    rc = mdb_env_set_mapflags(ew->env, mapFlags);
+    if (rc != 0) {
+        uv_mutex_unlock(envsLock);
+        return throwLmdbError(rc);
+    }
+
     // NOTE: MDB_FIXEDMAP is not exposed here since it is "highly experimental" + it is irrelevant for this use case
     // NOTE: MDB_NOTLS is not exposed here because it is irrelevant for this use case, as node will run all this on a single thread anyway
     setFlagFromValue(&flags, MDB_NOSUBDIR, "noSubdir", false, options);
@@ -413,63 +1781,288 @@ NAN_METHOD(EnvWrap::open) {
     envPath.count = 1;
     envs.push_back(envPath);
     uv_mutex_unlock(envsLock);
+
+    startSyncThread();
+    startReaderCheck();
+    startBranchLocker();
+}
+
+NAN_METHOD(EnvWrap::resize) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    // Check that the correct number/type of arguments was given.
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("Call env.resize() with exactly one argument which is a number.");
+    }
+
+    // Since this function may only be called if no transactions are active in this process, check this condition.
+    if (!ew->isIdle()) {
+        return Nan::ThrowError("Only call env.resize() when there are no active transactions. Please close all transactions before calling env.resize().");
+    }
+
+    mdb_size_t mapSizeSizeT = info[0]->IntegerValue(Nan::GetCurrentContext()).FromJust();
+    int rc = ew->setMapSize(mapSizeSizeT);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+}
+
+NAN_METHOD(EnvWrap::close) {
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (ew->backgroundReaders) {
+        return Nan::ThrowError("The environment can't be closed while a parallel scan or a copy is running.");
+    }
+    if (ew->currentWriteTxn && ew->currentWriteTxn->committing) {
+        return Nan::ThrowError("The environment can't be closed while a transaction is being committed.");
+    }
+
+    ew->Unref();
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    // Don't grow the map for transactions that are about to be aborted
+    auto idleCallbacks = std::move(ew->idleCallbacks);
+    ew->idleCallbacks.clear();
+    ew->cleanupStrayTxns();
+
+    // Stops the background sync, after a last sync
+    delete ew->syncThread;
+    ew->syncThread = nullptr;
+    ew->stopReaderCheck();
+    if (ew->branchLocker) {
+        ew->branchLocker->close();
+    }
+
+    uv_mutex_lock(envsLock);
+    for (auto envPath = envs.begin(); envPath != envs.end(); ) {
+        if (envPath->env == ew->env) {
+            envPath->count--;
+            if (envPath->count <= 0) {
+                // last thread using it, we can really close it now
+                envs.erase(envPath);
+                mdb_env_close(ew->env);
+            }
+            break;
+        }
+        ++envPath;
+    }
+    uv_mutex_unlock(envsLock);
+
+    ew->env = nullptr;
+
+    // Let the work that was waiting fail, now that the map can't grow anymore
+    for (auto &callback : idleCallbacks) {
+        callback();
+    }
+}
+
+NAN_METHOD(EnvWrap::stat) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    int rc;
+    MDB_stat stat;
+
+    rc = mdb_env_stat(ew->env, &stat);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+    obj->Set(context, Nan::New<String>("pageSize").ToLocalChecked(), Nan::New<Number>(stat.ms_psize));
+    obj->Set(context, Nan::New<String>("treeDepth").ToLocalChecked(), Nan::New<Number>(stat.ms_depth));
+    obj->Set(context, Nan::New<String>("treeBranchPageCount").ToLocalChecked(), Nan::New<Number>(stat.ms_branch_pages));
+    obj->Set(context, Nan::New<String>("treeLeafPageCount").ToLocalChecked(), Nan::New<Number>(stat.ms_leaf_pages));
+    obj->Set(context, Nan::New<String>("entryCount").ToLocalChecked(), Nan::New<Number>(stat.ms_entries));
+
+    info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(EnvWrap::info) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    int rc;
+    MDB_envinfo envinfo;
+
+    rc = mdb_env_info(ew->env, &envinfo);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+    obj->Set(context, Nan::New<String>("mapAddress").ToLocalChecked(), Nan::New<Number>((uint64_t) envinfo.me_mapaddr));
+    obj->Set(context, Nan::New<String>("mapSize").ToLocalChecked(), Nan::New<Number>(envinfo.me_mapsize));
+    obj->Set(context, Nan::New<String>("lastPageNumber").ToLocalChecked(), Nan::New<Number>(envinfo.me_last_pgno));
+    obj->Set(context, Nan::New<String>("lastTxnId").ToLocalChecked(), Nan::New<Number>(envinfo.me_last_txnid));
+    obj->Set(context, Nan::New<String>("maxReaders").ToLocalChecked(), Nan::New<Number>(envinfo.me_maxreaders));
+    obj->Set(context, Nan::New<String>("numReaders").ToLocalChecked(), Nan::New<Number>(envinfo.me_numreaders));
+    obj->Set(context, Nan::New<String>("lockedPages").ToLocalChecked(), Nan::New<Number>(ew->branchLocker ? ew->branchLocker->lockedPages() : 0));
+
+    info.GetReturnValue().Set(obj);
+}
+
+typedef std::function<void(int pid, const char *thread, const char *txnId)> reader_visitor_t;
+
+// Calls the visitor for each slot of the reader lock table that is in use
+static int forEachReader(MDB_env *env, reader_visitor_t visitor) {
+    // Each slot is a line of text: the pid (decimal), the thread ID (hexadecimal) and the txnid (decimal, or - when it's not used)
+    return mdb_reader_list(env, [](const char *line, void *ctx) -> int {
+        int pid;
+        char thread[32], txnId[32];
+        // Skips the header and the messages when there are no readers
+        if (sscanf(line, "%d %31s %31s", &pid, thread, txnId) == 3) {
+            (*(reader_visitor_t*) ctx)(pid, thread, txnId);
+        }
+        return 0;
+    }, &visitor);
+}
+
+unsigned int EnvWrap::freeReaders() {
+    unsigned int maxReaders = 0;
+    if (mdb_env_get_maxreaders(env, &maxReaders) != 0) {
+        return 0;
+    }
+    unsigned int used = 0;
+    forEachReader(env, [&used](int pid, const char *thread, const char *txnId) -> void {
+        used++;
+    });
+    return used < maxReaders ? maxReaders - used : 0;
 }
 
-NAN_METHOD(EnvWrap::resize) {
+NAN_METHOD(EnvWrap::metrics) {
     Nan::HandleScope scope;
+    Local<Context> context = Nan::GetCurrentContext();
 
     // Get the wrapper
     EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
-
     if (!ew->env) {
         return Nan::ThrowError("The environment is already closed.");
     }
-
-    // Check that the correct number/type of arguments was given.
-    if (info.Length() != 1 || !info[0]->IsNumber()) {
-        return Nan::ThrowError("Call env.resize() with exactly one argument which is a number.");
+    if (!ew->envMetrics) {
+        return Nan::ThrowError("The metrics aren't enabled, open the environment with the metrics option.");
     }
 
-    // Since this function may only be called if no transactions are active in this process, check this condition.
-    if (ew->currentWriteTxn || ew->readTxns.size()) {
-        return Nan::ThrowError("Only call env.resize() when there are no active transactions. Please close all transactions before calling env.resize().");
+    bool prometheus = false;
+    bool reset = false;
+    std::string labels;
+    if (info[0]->IsObject()) {
+        Local<Object> options = Local<Object>::Cast(info[0]);
+        Local<Value> format = options->Get(context, Nan::New<String>("format").ToLocalChecked()).ToLocalChecked();
+        if (format->IsString()) {
+            if (strcmp(*Nan::Utf8String(format), "prometheus")) {
+                return Nan::ThrowError("The only format of env.metrics() is 'prometheus'.");
+            }
+            prometheus = true;
+        }
+        reset = options->Get(context, Nan::New<String>("reset").ToLocalChecked()).ToLocalChecked()->IsTrue();
+
+        // Labels of every sample, such as the name of the environment
+        Local<Value> labelsOption = options->Get(context, Nan::New<String>("labels").ToLocalChecked()).ToLocalChecked();
+        if (labelsOption->IsObject()) {
+            Local<Object> labelsObject = Local<Object>::Cast(labelsOption);
+            Local<Array> names = labelsObject->GetOwnPropertyNames(context).ToLocalChecked();
+            for (unsigned int i = 0; i < names->Length(); i++) {
+                Local<Value> name = names->Get(context, i).ToLocalChecked();
+                Nan::Utf8String value(labelsObject->Get(context, name).ToLocalChecked());
+                if (!labels.empty()) {
+                    labels += ",";
+                }
+                labels += *Nan::Utf8String(name);
+                labels += "=\"";
+                for (const char *c = *value; *c; c++) {
+                    if (*c == '\\' || *c == '"') {
+                        labels += '\\';
+                        labels += *c;
+                    }
+                    else if (*c == '\n') {
+                        labels += "\\n";
+                    }
+                    else {
+                        labels += *c;
+                    }
+                }
+                labels += "\"";
+            }
+        }
     }
 
-    mdb_size_t mapSizeSizeT = info[0]->IntegerValue(Nan::GetCurrentContext()).FromJust();
-    int rc = mdb_env_set_mapsize(ew->env, mapSizeSizeT);
-    if (rc != 0) {
-        return throwLmdbError(rc);
+    if (prometheus) {
+        info.GetReturnValue().Set(Nan::New<String>(ew->envMetrics->toPrometheus(labels)).ToLocalChecked());
+    }
+    else {
+        info.GetReturnValue().Set(ew->envMetrics->toObject());
+    }
+    if (reset) {
+        ew->envMetrics->reset();
     }
 }
 
-NAN_METHOD(EnvWrap::close) {
+NAN_METHOD(EnvWrap::traceEvents) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
     EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
-    ew->Unref();
+    if (!ew->traceBuffer) {
+        return Nan::ThrowError("The tracing isn't enabled, open the environment with the trace option.");
+    }
+
+    info.GetReturnValue().Set(ew->traceBuffer->drain());
+}
 
+NAN_METHOD(EnvWrap::readers) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
     if (!ew->env) {
         return Nan::ThrowError("The environment is already closed.");
     }
-    ew->cleanupStrayTxns();
 
-    uv_mutex_lock(envsLock);
-    for (auto envPath = envs.begin(); envPath != envs.end(); ) {
-        if (envPath->env == ew->env) {
-            envPath->count--;
-            if (envPath->count <= 0) {
-                // last thread using it, we can really close it now
-                envs.erase(envPath);
-                mdb_env_close(ew->env);
-            }
-            break;
+    Local<Array> readers = Nan::New<Array>();
+    int rc = forEachReader(ew->env, [&readers](int pid, const char *thread, const char *txnId) -> void {
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Object> reader = Nan::New<Object>();
+        (void)reader->Set(context, Nan::New<String>("pid").ToLocalChecked(), Nan::New<Number>(pid));
+        (void)reader->Set(context, Nan::New<String>("thread").ToLocalChecked(), Nan::New<String>(thread).ToLocalChecked());
+        if (strcmp(txnId, "-")) {
+            (void)reader->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>((double) strtoull(txnId, nullptr, 10)));
         }
-        ++envPath;
+        else {
+            (void)reader->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::Null());
+        }
+        (void)Nan::Set(readers, readers->Length(), reader);
+    });
+    if (rc < 0) {
+        return Nan::ThrowError("Couldn't list the readers.");
     }
-    uv_mutex_unlock(envsLock);
 
-    ew->env = nullptr;
+    info.GetReturnValue().Set(readers);
 }
 
-NAN_METHOD(EnvWrap::stat) {
+NAN_METHOD(EnvWrap::freeStats) {
     Nan::HandleScope scope;
 
     // Get the wrapper
@@ -478,26 +2071,133 @@ NAN_METHOD(EnvWrap::stat) {
         return Nan::ThrowError("The environment is already closed.");
     }
 
-    int rc;
-    MDB_stat stat;
+    MDB_txn *txn;
+    int rc = mdb_txn_begin(ew->env, nullptr, MDB_RDONLY, &txn);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
 
-    rc = mdb_env_stat(ew->env, &stat);
+    // The pages freed by a transaction can be reused once every reader uses a newer snapshot
+    mdb_size_t oldest = mdb_txn_id(txn);
+    forEachReader(ew->env, [&oldest](int pid, const char *thread, const char *txnId) -> void {
+        if (strcmp(txnId, "-")) {
+            oldest = std::min(oldest, (mdb_size_t) strtoull(txnId, nullptr, 10));
+        }
+    });
+
+    // The free DB has the IDs of the pages freed by each transaction: the key is the txnid,
+    // the data is the number of pages followed by the page numbers
+    MDB_cursor *cursor;
+    rc = mdb_cursor_open(txn, 0, &cursor);
     if (rc != 0) {
+        mdb_txn_abort(txn);
+        return throwLmdbError(rc);
+    }
+    // The lists of page numbers are sorted, they are merged in the map instead of being copied and sorted again
+    struct FreeList {
+        const char *pages;
+        mdb_size_t count;
+        mdb_size_t next;
+        bool ascending;
+        mdb_size_t pgno() const {
+            mdb_size_t pgno;
+            memcpy(&pgno, pages + (ascending ? count - 1 - next : next) * sizeof(mdb_size_t), sizeof(pgno));
+            return pgno;
+        }
+    };
+    auto smaller = [](const FreeList &a, const FreeList &b) -> bool {
+        return a.pgno() < b.pgno();
+    };
+    std::vector<FreeList> lists;
+#ifdef MDB_VL32
+    // Pages are unmapped as the cursor moves on, so the lists are copied
+    std::vector<std::vector<char>> copies;
+#endif
+    double freePages = 0, entries = 0, pinnedPages = 0;
+    MDB_val key, data;
+    while ((rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
+        mdb_size_t freedBy, count;
+        memcpy(&freedBy, key.mv_data, sizeof(freedBy));
+        memcpy(&count, data.mv_data, sizeof(count));
+        entries++;
+        freePages += count;
+        if (freedBy >= oldest) {
+            pinnedPages += count;
+        }
+        if (count) {
+            FreeList list = { (char*) data.mv_data + sizeof(mdb_size_t), count, 0, false };
+#ifdef MDB_VL32
+            copies.emplace_back(list.pages, list.pages + count * sizeof(mdb_size_t));
+            list.pages = copies.back().data();
+#endif
+            // LMDB keeps them in descending order, walking them from the end handles either order
+            list.ascending = count > 1 && list.pgno() < FreeList{ list.pages, count, count - 1, false }.pgno();
+            lists.push_back(list);
+        }
+    }
+    mdb_cursor_close(cursor);
+
+    // Contiguous free pages can hold large values, the runs are counted from the largest page number down
+    std::make_heap(lists.begin(), lists.end(), smaller);
+    double runs = 0, largestRun = 0, run = 0;
+    mdb_size_t previous = 0;
+    while (rc == MDB_NOTFOUND && !lists.empty()) {
+        std::pop_heap(lists.begin(), lists.end(), smaller);
+        FreeList &list = lists.back();
+        mdb_size_t pgno = list.pgno();
+        if (run && pgno + 1 == previous) {
+            run++;
+        }
+        else {
+            runs++;
+            run = 1;
+        }
+        largestRun = std::max(largestRun, run);
+        previous = pgno;
+        if (++list.next < list.count) {
+            std::push_heap(lists.begin(), lists.end(), smaller);
+        }
+        else {
+            lists.pop_back();
+        }
+    }
+    MDB_envinfo envinfo;
+    mdb_env_info(ew->env, &envinfo);
+    mdb_txn_abort(txn);
+    if (rc != MDB_NOTFOUND) {
         return throwLmdbError(rc);
     }
 
     Local<Context> context = Nan::GetCurrentContext();
-    Local<Object> obj = Nan::New<Object>();
-    obj->Set(context, Nan::New<String>("pageSize").ToLocalChecked(), Nan::New<Number>(stat.ms_psize));
-    obj->Set(context, Nan::New<String>("treeDepth").ToLocalChecked(), Nan::New<Number>(stat.ms_depth));
-    obj->Set(context, Nan::New<String>("treeBranchPageCount").ToLocalChecked(), Nan::New<Number>(stat.ms_branch_pages));
-    obj->Set(context, Nan::New<String>("treeLeafPageCount").ToLocalChecked(), Nan::New<Number>(stat.ms_leaf_pages));
-    obj->Set(context, Nan::New<String>("entryCount").ToLocalChecked(), Nan::New<Number>(stat.ms_entries));
+    Local<Object> stats = Nan::New<Object>();
+    (void)stats->Set(context, Nan::New<String>("totalPages").ToLocalChecked(), Nan::New<Number>((double) (envinfo.me_last_pgno + 1)));
+    (void)stats->Set(context, Nan::New<String>("freePages").ToLocalChecked(), Nan::New<Number>(freePages));
+    (void)stats->Set(context, Nan::New<String>("reusablePages").ToLocalChecked(), Nan::New<Number>(freePages - pinnedPages));
+    (void)stats->Set(context, Nan::New<String>("pinnedPages").ToLocalChecked(), Nan::New<Number>(pinnedPages));
+    (void)stats->Set(context, Nan::New<String>("oldestTxnId").ToLocalChecked(), Nan::New<Number>((double) oldest));
+    (void)stats->Set(context, Nan::New<String>("entries").ToLocalChecked(), Nan::New<Number>(entries));
+    (void)stats->Set(context, Nan::New<String>("runs").ToLocalChecked(), Nan::New<Number>(runs));
+    (void)stats->Set(context, Nan::New<String>("largestRun").ToLocalChecked(), Nan::New<Number>(largestRun));
+
+    // The pages of the write transaction of this Env, if there is one
+    TxnWrap *tw = ew->currentWriteTxn;
+    mdb_size_t dirty, spilled, room;
+    if (tw && tw->txn && !tw->committing && mdb_txn_dirty_stat(tw->txn, &dirty, &spilled, &room) == 0) {
+        Local<Object> txnStats = Nan::New<Object>();
+        (void)txnStats->Set(context, Nan::New<String>("dirtyPages").ToLocalChecked(), Nan::New<Number>((double) dirty));
+        (void)txnStats->Set(context, Nan::New<String>("spilledPages").ToLocalChecked(), Nan::New<Number>((double) spilled));
+        (void)txnStats->Set(context, Nan::New<String>("dirtyRoom").ToLocalChecked(), Nan::New<Number>((double) room));
+        (void)txnStats->Set(context, Nan::New<String>("spilledRatio").ToLocalChecked(), Nan::New<Number>(dirty + spilled ? (double) spilled / (dirty + spilled) : 0));
+        (void)stats->Set(context, Nan::New<String>("txn").ToLocalChecked(), txnStats);
+    }
+    else {
+        (void)stats->Set(context, Nan::New<String>("txn").ToLocalChecked(), Nan::Null());
+    }
 
-    info.GetReturnValue().Set(obj);
+    info.GetReturnValue().Set(stats);
 }
 
-NAN_METHOD(EnvWrap::info) {
+NAN_METHOD(EnvWrap::readerCheck) {
     Nan::HandleScope scope;
 
     // Get the wrapper
@@ -506,24 +2206,28 @@ NAN_METHOD(EnvWrap::info) {
         return Nan::ThrowError("The environment is already closed.");
     }
 
-    int rc;
-    MDB_envinfo envinfo;
-
-    rc = mdb_env_info(ew->env, &envinfo);
+    int dead = 0;
+    int rc = mdb_reader_check(ew->env, &dead);
     if (rc != 0) {
         return throwLmdbError(rc);
     }
 
-    Local<Context> context = Nan::GetCurrentContext();
-    Local<Object> obj = Nan::New<Object>();
-    obj->Set(context, Nan::New<String>("mapAddress").ToLocalChecked(), Nan::New<Number>((uint64_t) envinfo.me_mapaddr));
-    obj->Set(context, Nan::New<String>("mapSize").ToLocalChecked(), Nan::New<Number>(envinfo.me_mapsize));
-    obj->Set(context, Nan::New<String>("lastPageNumber").ToLocalChecked(), Nan::New<Number>(envinfo.me_last_pgno));
-    obj->Set(context, Nan::New<String>("lastTxnId").ToLocalChecked(), Nan::New<Number>(envinfo.me_last_txnid));
-    obj->Set(context, Nan::New<String>("maxReaders").ToLocalChecked(), Nan::New<Number>(envinfo.me_maxreaders));
-    obj->Set(context, Nan::New<String>("numReaders").ToLocalChecked(), Nan::New<Number>(envinfo.me_numreaders));
+    info.GetReturnValue().Set(Nan::New<Number>(dead));
+}
 
-    info.GetReturnValue().Set(obj);
+NAN_METHOD(EnvWrap::syncStats) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    if (!ew->syncThread) {
+        return info.GetReturnValue().Set(Nan::Null());
+    }
+    info.GetReturnValue().Set(ew->syncThread->stats());
 }
 
 NAN_METHOD(EnvWrap::copy) {
@@ -538,10 +2242,7 @@ NAN_METHOD(EnvWrap::copy) {
 
     // Check that the correct number/type of arguments was given.
     if (!info[0]->IsString()) {
-        return Nan::ThrowError("Call env.copy(path, compact?, callback) with a file path.");
-    }
-    if (!info[info.Length() - 1]->IsFunction()) {
-        return Nan::ThrowError("Call env.copy(path, compact?, callback) with a file path.");
+        return Nan::ThrowError("Call env.copy(path, compact?, callback?) with a file path.");
     }
     Nan::Utf8String path(info[0].As<String>());
 
@@ -550,17 +2251,169 @@ NAN_METHOD(EnvWrap::copy) {
         flags = MDB_CP_COMPACT;
     }
 
-    Nan::Callback* callback = new Nan::Callback(
-      v8::Local<v8::Function>::Cast(info[info.Length()  > 2 ? 2 : 1])
-    );
+    Nan::Callback* callback = callbackArgument(info[1]->IsFunction() ? info[1] : info[2]);
 
     CopyWorker* worker = new CopyWorker(
-      ew->env, *path, flags, callback
+      ew->env, *path, flags, ew->traceBuffer, callback
+    );
+    // The Env, and its trace buffer, stay alive until the callback returns
+    worker->SaveToPersistent("env", info.This());
+
+    worker->promiseUnlessCallback(info);
+    Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(EnvWrap::copyToStream) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    // Check that the correct number/type of arguments was given.
+    if (!info[0]->IsObject()) {
+        return Nan::ThrowError("Call env.copyToStream(stream, options?, callback?) with a writable stream.");
+    }
+    Local<Object> stream = Local<Object>::Cast(info[0]);
+    Local<Value> write = stream->Get(Nan::GetCurrentContext(), Nan::New<String>("write").ToLocalChecked()).ToLocalChecked();
+    if (!write->IsFunction()) {
+        return Nan::ThrowError("Call env.copyToStream(stream, options?, callback?) with a writable stream.");
+    }
+
+    int flags = 0;
+    double bytesPerSecond = 0;
+    bool end = true;
+    if (info[1]->IsObject() && !info[1]->IsFunction()) {
+        Local<Object> options = Local<Object>::Cast(info[1]);
+        setFlagFromValue(&flags, MDB_CP_COMPACT, "compact", false, options);
+
+        Local<Value> rate = options->Get(Nan::GetCurrentContext(), Nan::New<String>("bytesPerSecond").ToLocalChecked()).ToLocalChecked();
+        if (rate->IsNumber()) {
+            bytesPerSecond = rate->NumberValue(Nan::GetCurrentContext()).FromJust();
+            if (!(bytesPerSecond > 0)) {
+                return Nan::ThrowError("The bytesPerSecond option must be a positive number.");
+            }
+        }
+
+        Local<Value> endValue = options->Get(Nan::GetCurrentContext(), Nan::New<String>("end").ToLocalChecked()).ToLocalChecked();
+        if (endValue->IsBoolean()) {
+            end = endValue->IsTrue();
+        }
+    }
+
+    AsyncCompletion *completion = new AsyncCompletion(info, info[1]->IsFunction() ? info[1] : info[2]);
+
+    CopyStream *copy = new CopyStream(ew, flags, bytesPerSecond, end, completion);
+    // The Env stays alive until the copy is finished
+    copy->start(info.This(), stream);
+}
+
+NAN_METHOD(EnvWrap::copyIncremental) {
+    Nan::HandleScope scope;
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    // Check that the correct number/type of arguments was given.
+    if (!info[0]->IsString() || !info[1]->IsObject()) {
+        return Nan::ThrowError("Call env.copyIncremental(path, { signature, since? }, callback?) with the path of the delta.");
+    }
+    Nan::Utf8String path(info[0].As<String>());
+    Local<Object> options = Local<Object>::Cast(info[1]);
+
+    Local<Value> signature = options->Get(Nan::GetCurrentContext(), Nan::New<String>("signature").ToLocalChecked()).ToLocalChecked();
+    if (!signature->IsString()) {
+        return Nan::ThrowError("The signature option must be the path of the signature of this backup.");
+    }
+    Nan::Utf8String signaturePath(signature);
+
+    Local<Value> since = options->Get(Nan::GetCurrentContext(), Nan::New<String>("since").ToLocalChecked()).ToLocalChecked();
+    if (!since->IsString() && !since->IsUndefined() && !since->IsNull()) {
+        return Nan::ThrowError("The since option must be the path of the signature of the previous backup.");
+    }
+    Nan::Utf8String sincePath(since);
+
+    Nan::Callback* callback = callbackArgument(info[2]);
+
+    IncrementalCopyWorker* worker = new IncrementalCopyWorker(
+      ew, *path, since->IsString() ? *sincePath : nullptr, *signaturePath, callback
     );
 
+    worker->promiseUnlessCallback(info);
+    Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(EnvWrap::applyDelta) {
+    Nan::HandleScope scope;
+
+    // Check that the correct number/type of arguments was given.
+    if (!info[0]->IsString() || !info[1]->IsString()) {
+        return Nan::ThrowError("Call applyDelta(path, deltaPath, callback?) with the path of a copy and the path of a delta.");
+    }
+    Nan::Utf8String path(info[0].As<String>());
+    Nan::Utf8String deltaPath(info[1].As<String>());
+
+    Nan::Callback* callback = callbackArgument(info[2]);
+
+    ApplyDeltaWorker* worker = new ApplyDeltaWorker(*path, *deltaPath, callback);
+
+    worker->promiseUnlessCallback(info);
     Nan::AsyncQueueWorker(worker);
 }
 
+NAN_METHOD(EnvWrap::compact) {
+    Nan::HandleScope scope;
+
+#ifdef _WIN32
+    return Nan::ThrowError("env.compact() is not supported on Windows.");
+#else
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    unsigned int flags = 0;
+    mdb_env_get_flags(ew->env, &flags);
+    if (flags & MDB_RDONLY) {
+        return Nan::ThrowError("A read-only environment can't be compacted.");
+    }
+    if (ew->openCount() > 1) {
+        return Nan::ThrowError("The environment can't be compacted while it's opened more than once in this process.");
+    }
+
+    // The copy is made next to the data file, so that it can be renamed over it
+    const char *envPath = nullptr;
+    mdb_env_get_path(ew->env, &envPath);
+    std::string tmpPath = std::string(envPath) + ((flags & MDB_NOSUBDIR) ? ".compact" : "/data.mdb.compact");
+
+    if (info[0]->IsObject() && !info[0]->IsFunction()) {
+        Local<Object> options = Local<Object>::Cast(info[0]);
+        Local<Value> tmpPathOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("tmpPath").ToLocalChecked()).ToLocalChecked();
+        if (tmpPathOption->IsString()) {
+            tmpPath = *Nan::Utf8String(tmpPathOption);
+        }
+        else if (!tmpPathOption->IsUndefined()) {
+            return Nan::ThrowError("The tmpPath option must be a path on the file system of the environment.");
+        }
+    }
+
+    AsyncCompletion *completion = new AsyncCompletion(info, info[0]->IsFunction() ? info[0] : info[1]);
+
+    MDB_envinfo envinfo;
+    mdb_env_info(ew->env, &envinfo);
+    CompactWorker::start(ew, tmpPath, COMPACT_ATTEMPTS, (double) (envinfo.me_last_pgno + 1), completion);
+#endif
+}
+
 NAN_METHOD(EnvWrap::detachBuffer) {
     Nan::HandleScope scope;
     #if NODE_VERSION_AT_LEAST(12,0,0)
@@ -605,6 +2458,154 @@ NAN_METHOD(EnvWrap::openDbi) {
     info.GetReturnValue().Set(instance);
 }
 
+NAN_METHOD(EnvWrap::share) {
+    Nan::HandleScope scope;
+    Local<Context> context = Nan::GetCurrentContext();
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+    if (!info[0]->IsUndefined() && !info[0]->IsArray()) {
+        return Nan::ThrowError("Call env.share(dbis?) with an array of the Dbis to share.");
+    }
+
+    std::vector<DbiWrap*> dws;
+    if (info[0]->IsArray()) {
+        Local<Array> array = Local<Array>::Cast(info[0]);
+        for (unsigned int i = 0; i < array->Length(); i++) {
+            Local<Value> element = array->Get(context, i).ToLocalChecked();
+            if (!element->IsObject()) {
+                return Nan::ThrowError("Only the open Dbis of this environment can be shared.");
+            }
+            DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(Local<Object>::Cast(element));
+            if (!dw->isOpen || dw->env != ew->env) {
+                return Nan::ThrowError("Only the open Dbis of this environment can be shared.");
+            }
+            dws.push_back(dw);
+        }
+    }
+
+    // The handle finds the environment by the path it was opened with,
+    // and the registry keeps the flags and the key type of the shared Dbis, so that the handle doesn't have to be trusted
+    std::string path;
+    uv_mutex_lock(envsLock);
+    for (env_path_t &envPath : envs) {
+        if (envPath.env == ew->env) {
+            path = envPath.path;
+            for (DbiWrap *dw : dws) {
+                bool registered = false;
+                for (shared_dbi_t &shared : envPath.sharedDbis) {
+                    registered = registered || shared.dbi == dw->dbi;
+                }
+                if (!registered) {
+                    envPath.sharedDbis.push_back({ dw->dbi, dw->flags, dw->keyType });
+                }
+            }
+        }
+    }
+    uv_mutex_unlock(envsLock);
+    if (path.empty()) {
+        return Nan::ThrowError("The environment isn't open.");
+    }
+
+    // Closing any of the Envs' Dbis would close the handle for all of them
+    Local<Array> dbis = Nan::New<Array>();
+    for (unsigned int i = 0; i < dws.size(); i++) {
+        dws[i]->isShared = true;
+        Local<Object> dbi = Nan::New<Object>();
+        (void)dbi->Set(context, Nan::New<String>("dbi").ToLocalChecked(), Nan::New<Number>(dws[i]->dbi));
+        (void)Nan::Set(dbis, i, dbi);
+    }
+
+    Local<Object> handle = Nan::New<Object>();
+    (void)handle->Set(context, Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(path).ToLocalChecked());
+    (void)handle->Set(context, Nan::New<String>("dbis").ToLocalChecked(), dbis);
+    info.GetReturnValue().Set(handle);
+}
+
+NAN_METHOD(EnvWrap::attach) {
+    Nan::HandleScope scope;
+    Local<Context> context = Nan::GetCurrentContext();
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    // Check that the correct number/type of arguments was given.
+    if (!info[0]->IsObject()) {
+        return Nan::ThrowError("Call env.attach(handle) with a handle returned by env.share().");
+    }
+    Local<Object> handle = Local<Object>::Cast(info[0]);
+    Local<Value> path = handle->Get(context, Nan::New<String>("path").ToLocalChecked()).ToLocalChecked();
+    Local<Value> dbis = handle->Get(context, Nan::New<String>("dbis").ToLocalChecked()).ToLocalChecked();
+    if (!path->IsString() || !dbis->IsArray()) {
+        return Nan::ThrowError("Call env.attach(handle) with a handle returned by env.share().");
+    }
+    Local<Array> dbiArray = Local<Array>::Cast(dbis);
+    for (unsigned int i = 0; i < dbiArray->Length(); i++) {
+        Local<Value> dbi = dbiArray->Get(context, i).ToLocalChecked();
+        if (!dbi->IsObject() || !Local<Object>::Cast(dbi)->Get(context, Nan::New<String>("dbi").ToLocalChecked()).ToLocalChecked()->IsUint32()) {
+            return Nan::ThrowError("Call env.attach(handle) with a handle returned by env.share().");
+        }
+    }
+
+    Nan::Utf8String charPath(path);
+    uv_mutex_lock(envsLock);
+    for (env_path_t &envPath : envs) {
+        if (envPath.env == ew->env) {
+            uv_mutex_unlock(envsLock);
+            return Nan::ThrowError("The environment is already open.");
+        }
+    }
+    env_path_t *shared = nullptr;
+    for (env_path_t &envPath : envs) {
+        if (!strcmp(envPath.path, *charPath)) {
+            shared = &envPath;
+            break;
+        }
+    }
+    if (!shared) {
+        uv_mutex_unlock(envsLock);
+        return Nan::ThrowError("The shared environment isn't open in this process anymore.");
+    }
+    // Only the Dbis that were shared (and not dropped since) can be attached
+    std::vector<shared_dbi_t> sharedDbis;
+    for (unsigned int i = 0; i < dbiArray->Length(); i++) {
+        MDB_dbi dbi = Local<Object>::Cast(dbiArray->Get(context, i).ToLocalChecked())->Get(context, Nan::New<String>("dbi").ToLocalChecked()).ToLocalChecked()->Uint32Value(context).FromJust();
+        auto found = std::find_if(shared->sharedDbis.begin(), shared->sharedDbis.end(), [dbi](const shared_dbi_t &sharedDbi) {
+            return sharedDbi.dbi == dbi;
+        });
+        if (found == shared->sharedDbis.end()) {
+            uv_mutex_unlock(envsLock);
+            return Nan::ThrowError("The Dbi isn't shared by the environment.");
+        }
+        sharedDbis.push_back(*found);
+    }
+    shared->count++;
+    mdb_env_close(ew->env);
+    ew->env = shared->env;
+    uv_mutex_unlock(envsLock);
+
+    // The Dbis wrap the same handles, without opening them in a transaction
+    Local<Array> result = Nan::New<Array>(sharedDbis.size());
+    for (unsigned int i = 0; i < sharedDbis.size(); i++) {
+        const unsigned argc = 3;
+        Local<Value> argv[argc] = { info.This(), Nan::Null(), Nan::New<Number>(sharedDbis[i].dbi) };
+        Nan::MaybeLocal<Object> maybeInstance = Nan::NewInstance(Nan::New(*dbiCtor), argc, argv);
+        if (maybeInstance.IsEmpty()) {
+            return;
+        }
+        (void)Nan::Set(result, i, maybeInstance.ToLocalChecked());
+    }
+    info.GetReturnValue().Set(result);
+}
+
 NAN_METHOD(EnvWrap::sync) {
     Nan::HandleScope scope;
 
@@ -614,14 +2615,15 @@ NAN_METHOD(EnvWrap::sync) {
         return Nan::ThrowError("The environment is already closed.");
     }
 
-    Nan::Callback* callback = new Nan::Callback(
-      v8::Local<v8::Function>::Cast(info[0])
-    );
+    Nan::Callback* callback = callbackArgument(info[0]);
 
     SyncWorker* worker = new SyncWorker(
-      ew->env, callback
+      ew->env, ew->traceBuffer, callback
     );
+    // The Env, and its trace buffer, stay alive until the callback returns
+    worker->SaveToPersistent("env", info.This());
 
+    worker->promiseUnlessCallback(info);
     Nan::AsyncQueueWorker(worker);
     return;
 }
@@ -639,9 +2641,10 @@ NAN_METHOD(EnvWrap::batchWrite) {
     v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(info[0]);
 
     int length = array->Length();
-    action_t* actions = new action_t[length];
+    action_t* actions = new action_t[length]();
 
     int putFlags = 0;
+    bool stats = false;
     Nan::Callback* callback;
     Nan::Callback* progress = nullptr;
     Local<Value> options = info[1];
@@ -652,22 +2655,22 @@ NAN_METHOD(EnvWrap::batchWrite) {
         setFlagFromValue(&putFlags, MDB_NOOVERWRITE, "noOverwrite", false, optionsObject);
         setFlagFromValue(&putFlags, MDB_APPEND, "append", false, optionsObject);
         setFlagFromValue(&putFlags, MDB_APPENDDUP, "appendDup", false, optionsObject);
+        stats = optionsObject->Get(context, Nan::New<String>("stats").ToLocalChecked()).ToLocalChecked()->IsTrue();
 
         Local<Value> progressValue = optionsObject->Get(context, Nan::New<String>("progress").ToLocalChecked()).ToLocalChecked();
         if (progressValue->IsFunction()) {
             progress = new Nan::Callback(v8::Local<v8::Function>::Cast(progressValue));
         }
-        callback = new Nan::Callback(
-            v8::Local<v8::Function>::Cast(info[2])
-        );
+        callback = callbackArgument(info[2]);
     } else {
-        callback = new Nan::Callback(
-            v8::Local<v8::Function>::Cast(info[1])
-        );
+        callback = callbackArgument(info[1]);
     }
 
+    // Rather grow the map now than write the batch twice
+    ew->growIfAlmostFull();
+
     BatchWorker* worker = new BatchWorker(
-        ew->env, actions, length, putFlags, callback, progress
+        ew, actions, length, putFlags, stats, callback, progress
     );
     int persistedIndex = 0;
     bool keyIsValid = false;
@@ -764,6 +2767,8 @@ NAN_METHOD(EnvWrap::batchWrite) {
 
     worker->SaveToPersistent("env", info.This());
 
+    ew->backgroundWriters++;
+    worker->promiseUnlessCallback(info);
     Nan::AsyncQueueWorker(worker);
     return;
 }
@@ -781,12 +2786,26 @@ void EnvWrap::setupExports(Local<Object> exports) {
     envTpl->PrototypeTemplate()->Set(isolate, "close", Nan::New<FunctionTemplate>(EnvWrap::close));
     envTpl->PrototypeTemplate()->Set(isolate, "beginTxn", Nan::New<FunctionTemplate>(EnvWrap::beginTxn));
     envTpl->PrototypeTemplate()->Set(isolate, "openDbi", Nan::New<FunctionTemplate>(EnvWrap::openDbi));
+    envTpl->PrototypeTemplate()->Set(isolate, "share", Nan::New<FunctionTemplate>(EnvWrap::share));
+    envTpl->PrototypeTemplate()->Set(isolate, "attach", Nan::New<FunctionTemplate>(EnvWrap::attach));
     envTpl->PrototypeTemplate()->Set(isolate, "sync", Nan::New<FunctionTemplate>(EnvWrap::sync));
     envTpl->PrototypeTemplate()->Set(isolate, "batchWrite", Nan::New<FunctionTemplate>(EnvWrap::batchWrite));
     envTpl->PrototypeTemplate()->Set(isolate, "stat", Nan::New<FunctionTemplate>(EnvWrap::stat));
     envTpl->PrototypeTemplate()->Set(isolate, "info", Nan::New<FunctionTemplate>(EnvWrap::info));
+    envTpl->PrototypeTemplate()->Set(isolate, "syncStats", Nan::New<FunctionTemplate>(EnvWrap::syncStats));
+    envTpl->PrototypeTemplate()->Set(isolate, "readers", Nan::New<FunctionTemplate>(EnvWrap::readers));
+    envTpl->PrototypeTemplate()->Set(isolate, "readerCheck", Nan::New<FunctionTemplate>(EnvWrap::readerCheck));
+    envTpl->PrototypeTemplate()->Set(isolate, "freeStats", Nan::New<FunctionTemplate>(EnvWrap::freeStats));
+    envTpl->PrototypeTemplate()->Set(isolate, "metrics", Nan::New<FunctionTemplate>(EnvWrap::metrics));
+    envTpl->PrototypeTemplate()->Set(isolate, "traceEvents", Nan::New<FunctionTemplate>(EnvWrap::traceEvents));
+    envTpl->PrototypeTemplate()->Set(isolate, "warmup", Nan::New<FunctionTemplate>(EnvWrap::warmup));
+    envTpl->PrototypeTemplate()->Set(isolate, "residency", Nan::New<FunctionTemplate>(EnvWrap::residency));
+    envTpl->PrototypeTemplate()->Set(isolate, "advise", Nan::New<FunctionTemplate>(EnvWrap::advise));
+    envTpl->PrototypeTemplate()->Set(isolate, "compact", Nan::New<FunctionTemplate>(EnvWrap::compact));
     envTpl->PrototypeTemplate()->Set(isolate, "resize", Nan::New<FunctionTemplate>(EnvWrap::resize));
     envTpl->PrototypeTemplate()->Set(isolate, "copy", Nan::New<FunctionTemplate>(EnvWrap::copy));
+    envTpl->PrototypeTemplate()->Set(isolate, "copyToStream", Nan::New<FunctionTemplate>(EnvWrap::copyToStream));
+    envTpl->PrototypeTemplate()->Set(isolate, "copyIncremental", Nan::New<FunctionTemplate>(EnvWrap::copyIncremental));
     envTpl->PrototypeTemplate()->Set(isolate, "detachBuffer", Nan::New<FunctionTemplate>(EnvWrap::detachBuffer));
 
     // TxnWrap: Prepare constructor template
@@ -795,6 +2814,7 @@ void EnvWrap::setupExports(Local<Object> exports) {
     txnTpl->InstanceTemplate()->SetInternalFieldCount(1);
     // TxnWrap: Add functions to the prototype
     txnTpl->PrototypeTemplate()->Set(isolate, "commit", Nan::New<FunctionTemplate>(TxnWrap::commit));
+    txnTpl->PrototypeTemplate()->Set(isolate, "commitAsync", Nan::New<FunctionTemplate>(TxnWrap::commitAsync));
     txnTpl->PrototypeTemplate()->Set(isolate, "abort", Nan::New<FunctionTemplate>(TxnWrap::abort));
     txnTpl->PrototypeTemplate()->Set(isolate, "getString", Nan::New<FunctionTemplate>(TxnWrap::getString));
     txnTpl->PrototypeTemplate()->Set(isolate, "getStringUnsafe", Nan::New<FunctionTemplate>(TxnWrap::getStringUnsafe));
@@ -823,6 +2843,13 @@ void EnvWrap::setupExports(Local<Object> exports) {
     dbiTpl->PrototypeTemplate()->Set(isolate, "close", Nan::New<FunctionTemplate>(DbiWrap::close));
     dbiTpl->PrototypeTemplate()->Set(isolate, "drop", Nan::New<FunctionTemplate>(DbiWrap::drop));
     dbiTpl->PrototypeTemplate()->Set(isolate, "stat", Nan::New<FunctionTemplate>(DbiWrap::stat));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "countRange", Nan::New<FunctionTemplate>(DbiWrap::countRange));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "estimateSize", Nan::New<FunctionTemplate>(DbiWrap::estimateSize));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "splitPoints", Nan::New<FunctionTemplate>(DbiWrap::splitPoints));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "parallelScan", Nan::New<FunctionTemplate>(DbiWrap::parallelScan));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "intersectDups", Nan::New<FunctionTemplate>(DbiWrap::intersectDups));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "unionDups", Nan::New<FunctionTemplate>(DbiWrap::unionDups));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "differenceDups", Nan::New<FunctionTemplate>(DbiWrap::differenceDups));
     // TODO: wrap mdb_stat too
     // DbiWrap: Get constructor
     EnvWrap::dbiCtor = new Nan::Persistent<Function>();
@@ -830,4 +2857,5 @@ void EnvWrap::setupExports(Local<Object> exports) {
 
     // Set exports
     exports->Set(Nan::GetCurrentContext(), Nan::New<String>("Env").ToLocalChecked(), envTpl->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
+    exports->Set(Nan::GetCurrentContext(), Nan::New<String>("applyDelta").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(EnvWrap::applyDelta)).ToLocalChecked());
 }
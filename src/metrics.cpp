@@ -0,0 +1,173 @@
+
+// This file is part of node-lmdb, the Node.js binding for lmdb
+// Copyright (c) 2013-2017 Timur Kristóf
+// Licensed to you under the terms of the MIT license
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "node-lmdb.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace v8;
+using namespace node;
+
+// Names of the operations, as they appear in env.metrics() and in the op label of the Prometheus format
+static const char *metricNames[] = {
+    "get",
+    "put",
+    "del",
+    "cursor",
+    "txnBegin",
+    "commit",
+    "commitWrite",
+    "commitSync",
+    "batchQueueWait",
+    "batch"
+};
+
+// The Prometheus buckets are powers of two nanoseconds from about 1µs to 17s, where the sub-buckets line up
+#define PROMETHEUS_FIRST_BUCKET (10)
+#define PROMETHEUS_LAST_BUCKET (34)
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucketEnd(int index) {
+    if (index < (1 << METRIC_SUB_BUCKET_BITS)) {
+        return index + 1;
+    }
+    int shift = (index >> METRIC_SUB_BUCKET_BITS) - 1;
+    int sub = index & ((1 << METRIC_SUB_BUCKET_BITS) - 1);
+    if (shift + METRIC_SUB_BUCKET_BITS + 1 >= 64 && sub == (1 << METRIC_SUB_BUCKET_BITS) - 1) {
+        // The end of the last bucket is 2^64
+        return UINT64_MAX;
+    }
+    return (uint64_t) ((1 << METRIC_SUB_BUCKET_BITS) + sub + 1) << shift;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) {
+    uint64_t counts[METRIC_BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t) std::ceil(fraction * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketEnd(i), max.load(std::memory_order_relaxed));
+        }
+    }
+    return max.load(std::memory_order_relaxed);
+}
+
+EnvMetrics::EnvMetrics() {
+    bytesRead.store(0);
+    bytesWritten.store(0);
+}
+
+void EnvMetrics::reset() {
+    for (auto &histogram : histograms) {
+        histogram.reset();
+    }
+    bytesRead.store(0, std::memory_order_relaxed);
+    bytesWritten.store(0, std::memory_order_relaxed);
+}
+
+Local<Object> EnvMetrics::toObject() {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+
+    for (int i = 0; i < (int) Metric::Count; i++) {
+        LatencyHistogram &histogram = histograms[i];
+        Local<Object> stats = Nan::New<Object>();
+        (void)stats->Set(context, Nan::New<String>("count").ToLocalChecked(), Nan::New<Number>((double) histogram.count.load(std::memory_order_relaxed)));
+        (void)stats->Set(context, Nan::New<String>("totalTime").ToLocalChecked(), Nan::New<Number>(histogram.sum.load(std::memory_order_relaxed) / 1e6));
+        (void)stats->Set(context, Nan::New<String>("maxTime").ToLocalChecked(), Nan::New<Number>(histogram.max.load(std::memory_order_relaxed) / 1e6));
+        (void)stats->Set(context, Nan::New<String>("p50").ToLocalChecked(), Nan::New<Number>(histogram.percentile(0.5) / 1e6));
+        (void)stats->Set(context, Nan::New<String>("p90").ToLocalChecked(), Nan::New<Number>(histogram.percentile(0.9) / 1e6));
+        (void)stats->Set(context, Nan::New<String>("p99").ToLocalChecked(), Nan::New<Number>(histogram.percentile(0.99) / 1e6));
+        (void)stats->Set(context, Nan::New<String>("p999").ToLocalChecked(), Nan::New<Number>(histogram.percentile(0.999) / 1e6));
+        (void)obj->Set(context, Nan::New<String>(metricNames[i]).ToLocalChecked(), stats);
+    }
+    (void)obj->Set(context, Nan::New<String>("bytesRead").ToLocalChecked(), Nan::New<Number>((double) bytesRead.load(std::memory_order_relaxed)));
+    (void)obj->Set(context, Nan::New<String>("bytesWritten").ToLocalChecked(), Nan::New<Number>((double) bytesWritten.load(std::memory_order_relaxed)));
+
+    return obj;
+}
+
+// Formats a number of a sample of the Prometheus format
+static std::string sampleValue(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+std::string EnvMetrics::toPrometheus(const std::string &labels) {
+    std::string text;
+    std::string labelPrefix = labels.empty() ? "" : labels + ",";
+
+    text += "# HELP node_lmdb_operation_duration_seconds Latency of the operations of node-lmdb.\n";
+    text += "# TYPE node_lmdb_operation_duration_seconds histogram\n";
+    for (int i = 0; i < (int) Metric::Count; i++) {
+        LatencyHistogram &histogram = histograms[i];
+        std::string opLabels = labelPrefix + "op=\"" + metricNames[i] + "\"";
+        uint64_t cumulative = 0;
+        int bucket = 0;
+        for (int power = PROMETHEUS_FIRST_BUCKET; power <= PROMETHEUS_LAST_BUCKET; power++) {
+            uint64_t le = (uint64_t) 1 << power;
+            while (bucket < METRIC_BUCKETS && LatencyHistogram::bucketEnd(bucket) <= le) {
+                cumulative += histogram.buckets[bucket++].load(std::memory_order_relaxed);
+            }
+            text += "node_lmdb_operation_duration_seconds_bucket{" + opLabels + ",le=\"" + sampleValue(le / 1e9) + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        while (bucket < METRIC_BUCKETS) {
+            cumulative += histogram.buckets[bucket++].load(std::memory_order_relaxed);
+        }
+        text += "node_lmdb_operation_duration_seconds_bucket{" + opLabels + ",le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+        text += "node_lmdb_operation_duration_seconds_sum{" + opLabels + "} " + sampleValue(histogram.sum.load(std::memory_order_relaxed) / 1e9) + "\n";
+        text += "node_lmdb_operation_duration_seconds_count{" + opLabels + "} " + std::to_string(cumulative) + "\n";
+    }
+
+    text += "# HELP node_lmdb_read_bytes_total Bytes of the values read by node-lmdb.\n";
+    text += "# TYPE node_lmdb_read_bytes_total counter\n";
+    text += "node_lmdb_read_bytes_total{" + labels + "} " + std::to_string(bytesRead.load(std::memory_order_relaxed)) + "\n";
+    text += "# HELP node_lmdb_written_bytes_total Bytes of the keys and values written by node-lmdb.\n";
+    text += "# TYPE node_lmdb_written_bytes_total counter\n";
+    text += "node_lmdb_written_bytes_total{" + labels + "} " + std::to_string(bytesWritten.load(std::memory_order_relaxed)) + "\n";
+
+    return text;
+}
@@ -254,6 +254,64 @@ void throwLmdbError(int rc) {
     return Nan::ThrowError(err);
 }
 
+Nan::Callback *callbackArgument(Local<Value> callback) {
+    return callback->IsFunction() ? new Nan::Callback(Local<Function>::Cast(callback)) : nullptr;
+}
+
+Local<Promise::Resolver> returnPromise(Nan::NAN_METHOD_ARGS_TYPE info) {
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+    info.GetReturnValue().Set(resolver->GetPromise());
+    return resolver;
+}
+
+void settlePromise(Local<Promise::Resolver> resolver, Local<Value> error, Local<Value> result) {
+    // The continuations of the promise run when the scope ends, like the microtasks after a callback
+    node::CallbackScope scope(Isolate::GetCurrent(), resolver, { 0, 0 });
+    Local<Context> context = Nan::GetCurrentContext();
+    if (!error->IsNull()) {
+        (void) resolver->Reject(context, error);
+    }
+    else {
+        (void) resolver->Resolve(context, result);
+    }
+}
+
+AsyncCompletion::AsyncCompletion(Nan::NAN_METHOD_ARGS_TYPE info, Local<Value> callback) : callback(callbackArgument(callback)) {
+    if (!this->callback) {
+        resolver.Reset(returnPromise(info));
+    }
+}
+
+AsyncCompletion::~AsyncCompletion() {
+    resolver.Reset();
+    delete callback;
+}
+
+void AsyncCompletion::settle(Local<Value> error, Local<Value> result, Nan::AsyncResource *resource) {
+    if (!callback) {
+        return settlePromise(Nan::New(resolver), error, result);
+    }
+    Local<Value> argv[] = { error, result };
+    callback->Call(error->IsNull() ? 2 : 1, argv, resource);
+}
+
+Local<Object> commitStatToObject(const MDB_commit_stat &stat) {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+    (void)obj->Set(context, Nan::New<String>("dirtyPages").ToLocalChecked(), Nan::New<Number>(stat.ms_dirty));
+    (void)obj->Set(context, Nan::New<String>("spilledPages").ToLocalChecked(), Nan::New<Number>(stat.ms_spilled));
+    (void)obj->Set(context, Nan::New<String>("spillWrites").ToLocalChecked(), Nan::New<Number>(stat.ms_spill_writes));
+    (void)obj->Set(context, Nan::New<String>("writtenPages").ToLocalChecked(), Nan::New<Number>(stat.ms_written));
+    (void)obj->Set(context, Nan::New<String>("writes").ToLocalChecked(), Nan::New<Number>(stat.ms_writes));
+    // The times are in ms, like the other timings
+    (void)obj->Set(context, Nan::New<String>("spillTime").ToLocalChecked(), Nan::New<Number>(stat.ms_spill_time / 1e6));
+    (void)obj->Set(context, Nan::New<String>("freelistTime").ToLocalChecked(), Nan::New<Number>(stat.ms_freelist_time / 1e6));
+    (void)obj->Set(context, Nan::New<String>("writeTime").ToLocalChecked(), Nan::New<Number>(stat.ms_write_time / 1e6));
+    (void)obj->Set(context, Nan::New<String>("syncTime").ToLocalChecked(), Nan::New<Number>(stat.ms_sync_time / 1e6));
+    (void)obj->Set(context, Nan::New<String>("metaTime").ToLocalChecked(), Nan::New<Number>(stat.ms_meta_time / 1e6));
+    return obj;
+}
+
 void consoleLog(const char *msg) {
     Local<String> str = Nan::New("console.log('").ToLocalChecked();
     //str = String::Concat(str, Nan::New<String>(msg).ToLocalChecked());
@@ -26,12 +26,18 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
 #include <v8.h>
 #include <node.h>
 #include <node_buffer.h>
 #include <nan.h>
 #include <uv.h>
 #include "lmdb.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace v8;
 using namespace node;
@@ -94,14 +100,321 @@ Local<Value> valToBoolean(MDB_val &data);
 
 void throwLmdbError(int rc);
 
+// Returns the callback of an async method, or nullptr when it isn't a function, and the method returns a promise instead
+Nan::Callback *callbackArgument(Local<Value> callback);
+
+// Makes an async method return a promise, and returns the resolver which settles it
+Local<Promise::Resolver> returnPromise(Nan::NAN_METHOD_ARGS_TYPE info);
+
+// Settles the promise of an async method like its callback would be called: rejected unless the error is null
+void settlePromise(Local<Promise::Resolver> resolver, Local<Value> error, Local<Value> result);
+
+/*
+    Base of the workers of the async methods. They call their callback with (error) or (null, result), or settle
+    the promise that the method returned when it was called without a callback.
+*/
+template<class T>
+class PromiseWorker : public T {
+public:
+    PromiseWorker(Nan::Callback *callback, const char *resourceName) : T(callback, resourceName) {}
+
+    // Makes the method return a promise when it was called without a callback
+    void promiseUnlessCallback(Nan::NAN_METHOD_ARGS_TYPE info) {
+        if (!this->callback) {
+            this->SaveToPersistent("resolver", returnPromise(info));
+        }
+    }
+
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+        settle(Nan::Null(), result());
+    }
+
+    void HandleErrorCallback() {
+        Nan::HandleScope scope;
+        settle(Nan::Error(this->ErrorMessage()), Nan::Undefined());
+    }
+
+protected:
+    // The value of the promise, and the second argument of the callback
+    virtual Local<Value> result() {
+        return Nan::Undefined();
+    }
+
+private:
+    void settle(Local<Value> error, Local<Value> result) {
+        if (!this->callback) {
+            return settlePromise(Local<Promise::Resolver>::Cast(this->GetFromPersistent("resolver")), error, result);
+        }
+        Local<Value> argv[] = { error, result };
+        this->callback->Call(error->IsNull() ? 2 : 1, argv, this->async_resource);
+    }
+};
+
+/*
+    The callback of an async method whose work isn't done by a single worker, or the promise that the method
+    returned when it was called without a callback.
+*/
+class AsyncCompletion {
+public:
+    AsyncCompletion(Nan::NAN_METHOD_ARGS_TYPE info, Local<Value> callback);
+    ~AsyncCompletion();
+    // Calls the callback with (error) or (null, result), or settles the promise
+    void settle(Local<Value> error, Local<Value> result, Nan::AsyncResource *resource);
+
+private:
+    Nan::Callback *callback;
+    Nan::Persistent<Promise::Resolver> resolver;
+};
+
+// Converts the statistics of a commit to the object returned by `txn.commit({ stats: true })` and `batchWrite`
+Local<Object> commitStatToObject(const MDB_commit_stat &stat);
+
 class TxnWrap;
 class DbiWrap;
 class EnvWrap;
 class CursorWrap;
+class SyncThread;
+// A Dbi handle that env.share made available to the other Envs of the process
+struct shared_dbi_t {
+    MDB_dbi dbi;
+    int flags;
+    NodeLmdbKeyType keyType;
+};
 struct env_path_t {
     MDB_env* env;
     char* path;
     int count;
+    std::vector<shared_dbi_t> sharedDbis;
+};
+
+// Operations whose latency is measured when the metrics option is enabled
+enum class Metric {
+    Get,
+    Put,
+    Del,
+    Cursor,
+    TxnBegin,
+    Commit,
+    // The part of a commit which writes the pages
+    CommitWrite,
+    // The part of a commit which syncs them
+    CommitSync,
+    // Time a batch waits in the thread pool before it is written
+    BatchQueueWait,
+    Batch,
+    Count
+};
+
+// Latencies are counted in buckets of a power of two nanoseconds each, split into 4 sub-buckets
+// so that a percentile is within 25% of the real value, like in an HDR histogram
+#define METRIC_SUB_BUCKET_BITS (2)
+#define METRIC_BUCKETS (64 << METRIC_SUB_BUCKET_BITS)
+
+/*
+    Histogram of the latencies of an operation.
+    Updated without locks, with relaxed atomics, so that background threads can record into it too.
+*/
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    void record(uint64_t ns) {
+        buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t currentMax = max.load(std::memory_order_relaxed);
+        while (ns > currentMax && !max.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed));
+    }
+    void reset();
+    // Upper bound of the bucket, in nanoseconds, at the given fraction of the count
+    uint64_t percentile(double fraction);
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < (1 << METRIC_SUB_BUCKET_BITS)) {
+            return (int) ns;
+        }
+        #ifdef _MSC_VER
+        unsigned long msb;
+        _BitScanReverse64(&msb, ns);
+        #else
+        int msb = 63 - __builtin_clzll(ns);
+        #endif
+        int sub = (int) (ns >> (msb - METRIC_SUB_BUCKET_BITS)) & ((1 << METRIC_SUB_BUCKET_BITS) - 1);
+        return ((msb - METRIC_SUB_BUCKET_BITS + 1) << METRIC_SUB_BUCKET_BITS) + sub;
+    }
+    // Smallest latency that falls into the next bucket
+    static uint64_t bucketEnd(int index);
+
+    std::atomic<uint64_t> buckets[METRIC_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+/*
+    Counters and latency histograms of an Env, allocated by the metrics option.
+    Each Env belongs to one JS thread, so the counters aren't shared with other threads than its background work.
+*/
+class EnvMetrics {
+public:
+    LatencyHistogram histograms[(int) Metric::Count];
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> bytesWritten;
+
+    EnvMetrics();
+    void record(Metric metric, uint64_t ns) {
+        histograms[(int) metric].record(ns);
+    }
+    void read(size_t bytes) {
+        bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void written(size_t bytes) {
+        bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void reset();
+    // Statistics in milliseconds, as returned by env.metrics()
+    Local<Object> toObject();
+    // The Prometheus text format, with labels like `name="value"` (or an empty string) on every sample
+    std::string toPrometheus(const std::string &labels);
+};
+
+/*
+    Measures the time of an operation into the metrics of an Env, from its construction until it goes out of scope.
+    Costs a null check when the metrics aren't enabled.
+*/
+class MetricTimer {
+public:
+    MetricTimer(EnvMetrics *metrics, Metric metric) : metrics(metrics), metric(metric), start(metrics ? uv_hrtime() : 0) {}
+    ~MetricTimer() {
+        if (metrics) {
+            metrics->record(metric, uv_hrtime() - start);
+        }
+    }
+    void read(size_t bytes) {
+        if (metrics) {
+            metrics->read(bytes);
+        }
+    }
+    void written(size_t bytes) {
+        if (metrics) {
+            metrics->written(bytes);
+        }
+    }
+
+private:
+    EnvMetrics *metrics;
+    Metric metric;
+    uint64_t start;
+};
+
+// A phase of the work of an async worker, recorded when the trace option is enabled
+struct TraceSpan {
+    // Name of the async resource of the worker, like "node-lmdb:Batch"
+    const char *worker;
+    // "queueWait", "execute" or "callback"
+    const char *phase;
+    // Start and duration in ns, on the clock of uv_hrtime like the trace events of Node.js
+    uint64_t start;
+    uint64_t duration;
+    int threadId;
+    // Execution async id of the JS code which started the work
+    double triggerAsyncId;
+    // Number of operations and bytes of the work, or -1 when they don't apply
+    double actions;
+    double bytes;
+};
+
+/*
+    Ring buffer of the spans of the trace option, which keeps the most recent ones.
+    Background threads add to it too, so it's guarded by a mutex.
+*/
+class TraceBuffer {
+public:
+    TraceBuffer(size_t size);
+    ~TraceBuffer();
+    void add(const TraceSpan &span);
+    // Removes the spans from the buffer and returns them as trace events, oldest first
+    Local<Array> drain();
+
+private:
+    uv_mutex_t lock;
+    std::vector<TraceSpan> spans;
+    // Where the next span goes, and how many spans the buffer holds
+    size_t next;
+    size_t count;
+};
+
+/*
+    Records the phases of the work of an async worker: how long it waited in the thread pool,
+    how long it executed, and how long its callback took. Does nothing without a TraceBuffer.
+*/
+class WorkTrace {
+public:
+    // Called on the main thread when the work is queued
+    WorkTrace(TraceBuffer *buffer, const char *worker);
+    // Called again when the same work is queued again
+    void queued();
+    // Called at the start and at the end of Execute, with the size of the work if it has one
+    void executing();
+    void executed(double actions = -1, double bytes = -1);
+    // Called around the callback
+    void callingBack();
+    void calledBack();
+
+private:
+    void add(const char *phase, uint64_t start, double actions = -1, double bytes = -1);
+    TraceBuffer *buffer;
+    const char *worker;
+    double triggerAsyncId;
+    uint64_t start;
+};
+
+/*
+    Keeps the branch pages of the open Dbis locked in memory for the lockBranchPages option, the top levels
+    of every B-tree first when they don't all fit in the budget. Commits move the branch pages, so they are
+    found again in the background after each commit: the new ones are locked and the old ones unlocked.
+    Used on the main thread only, the worker gets a copy of what it needs.
+*/
+class BranchLocker {
+public:
+    BranchLocker(EnvWrap *ew, size_t maxPages);
+    ~BranchLocker();
+    // Adds or removes a Dbi, once for every Dbi object that has it open
+    void addDbi(MDB_dbi dbi);
+    void removeDbi(MDB_dbi dbi);
+    // Finds and locks the branch pages again in the background, shortly after a commit or a change of the Dbis
+    void refresh();
+    // Forgets the locks, after the map was mapped again without them
+    void reset();
+    // Called before the environment is closed, so that no refresh uses it afterwards
+    void close();
+    // Called when the Env is opened again after it was closed
+    void reopen(size_t maxPages);
+    bool isClosed();
+    // Whether a refresh is queued or running, the map can't be resized meanwhile
+    bool isRunning();
+    size_t lockedPages();
+
+private:
+    // Starts the refresh that the delay was waiting for
+    void start();
+
+    EnvWrap *ew;
+    size_t maxPages;
+    std::vector<MDB_dbi> dbis;
+    // The locked pages, sorted
+    std::vector<mdb_size_t> locked;
+    // Whether a refresh is running, and whether another one is needed after it
+    bool running;
+    bool pending;
+    // Delays the refresh, so that a burst of commits is followed by a single one
+    uv_timer_t *delay;
+    // Held by a refresh while it uses the environment
+    uv_mutex_t closeLock;
+    bool closed;
+    // Incremented when the Env is opened again, so that a refresh queued before doesn't use the new environment
+    unsigned int generation;
+    friend class BranchLockWorker;
 };
 
 /*
@@ -117,6 +430,30 @@ private:
     TxnWrap *currentWriteTxn;
     // List of open read transactions
     std::vector<TxnWrap*> readTxns;
+    // Number of read transactions used by background work such as parallel scans
+    int backgroundReaders;
+    // Number of batch writes in progress
+    int backgroundWriters;
+    // Settings of the autoGrow option, the map doesn't grow automatically if the step is zero
+    mdb_size_t growStep;
+    mdb_size_t growMax;
+    // Work waiting for the environment to be idle
+    std::vector<std::function<void()>> idleCallbacks;
+    // Background sync of the syncInterval and syncEveryBytes options, if enabled
+    SyncThread *syncThread;
+    // Timer of the periodic check for stale readers of the readerCheckInterval option, if enabled
+    uv_timer_t *readerCheckTimer;
+    // Counters and latency histograms of the metrics option, if enabled
+    EnvMetrics *envMetrics;
+    // Spans of the async workers of the trace option, if enabled
+    TraceBuffer *traceBuffer;
+    // Branch pages locked in memory by the lockBranchPages option, if enabled
+    BranchLocker *branchLocker;
+    // Held for reading by the background work that walks Dbis, and for writing while a Dbi handle is closed,
+    // since LMDB doesn't allow using a handle while another thread closes it
+    uv_rwlock_t dbiLock;
+    // Number of Dbi handles waiting for the dbiLock to be closed, the walks let go of it at their next page meanwhile
+    std::atomic<int> closingDbis;
     // Constructor for TxnWrap
     static thread_local Nan::Persistent<Function>* txnCtor;
     // Constructor for DbiWrap
@@ -127,9 +464,59 @@ private:
     static uv_mutex_t* initMutex();
     // Cleans up stray transactions
     void cleanupStrayTxns();
+    // Whether no transaction or refresh of the locked branch pages of this process uses the environment, so that the map can be resized
+    bool isIdle();
+    // Runs the callback once the environment is idle, right away if it already is
+    void whenIdle(std::function<void()> callback);
+    // Runs the callbacks waiting for the environment to be idle, if it is
+    void runIdleCallbacks();
+    // Grows the map by the autoGrow step, unless it has already grown beyond the given size
+    int growMap(mdb_size_t fullSize);
+    // Grows the map in advance if it's almost full and the environment is idle
+    void growIfAlmostFull();
+    // Makes the map grow once the environment is idle, after a write failed with MDB_MAP_FULL
+    void handleMapFull();
+    // Resizes the map, keeping the background sync from using it meanwhile
+    int setMapSize(mdb_size_t size);
+    // Replaces the data file with a copy, keeping the background sync from using it meanwhile
+    int replaceFile(const char *path, mdb_size_t txnId);
+    // Number of Env objects of this process that use the environment
+    int openCount();
+    // Number of slots of the reader lock table that aren't in use
+    unsigned int freeReaders();
+    // Finds a Dbi handle that env.share made available
+    bool findSharedDbi(MDB_dbi dbi, shared_dbi_t *result);
+    // Stops sharing a Dbi handle that was dropped, so that it can't be attached anymore
+    void unshareDbi(MDB_dbi dbi);
+    // Stops the periodic check for stale readers
+    void stopReaderCheck();
+    // Reads an array of open Dbis of this environment, returns false if it's something else
+    bool dbisArgument(Local<Value> value, std::vector<MDB_dbi> &dbis);
+    // Renews a read transaction of background work once no Dbi can be closed, until unlockDbis is called
+    int lockDbis(MDB_txn *txn);
+    void unlockDbis();
+    // Runs a walk of the Dbis between lockDbis and unlockDbis, again from the start each time it let a Dbi be closed
+    int retryWalk(MDB_txn *txn, std::function<int()> walk);
+    // Called around closing a Dbi handle on the main thread, which waits at most for the page that a walk is reading
+    void beginCloseDbi();
+    void endCloseDbi();
+    // Called after each successful commit of a write transaction
+    void committed();
 
     friend class TxnWrap;
     friend class DbiWrap;
+    friend class CursorWrap;
+    friend class ScanWorker;
+    friend class BatchWorker;
+    friend class CopyStream;
+    friend class IncrementalCopyWorker;
+    friend class CompactWorker;
+    friend class WarmupWorker;
+    friend class ResidencyWorker;
+    friend class AdviseWorker;
+    friend class BranchLocker;
+    friend class BranchLockWorker;
+    friend class CommitWorker;
 
 public:
     EnvWrap();
@@ -159,6 +546,116 @@ public:
     */
     static NAN_METHOD(info);
 
+    /*
+        Gets the statistics of the background sync enabled by the syncInterval and syncEveryBytes options, or null.
+    */
+    static NAN_METHOD(syncStats);
+
+    /*
+        Lists the slots of the reader lock table that are in use, by any process.
+        (Wrapper for `mdb_reader_list`)
+
+        Returns an array of `{ pid, thread, txnId }`, where `thread` is the thread ID in hexadecimal
+        and `txnId` is the snapshot the reader uses, or null if the slot is reserved but no transaction is active.
+    */
+    static NAN_METHOD(readers);
+
+    /*
+        Clears the slots of the reader lock table that belong to processes that no longer exist, and returns their number.
+        (Wrapper for `mdb_reader_check`)
+    */
+    static NAN_METHOD(readerCheck);
+
+    /*
+        Gets statistics of the free pages of the environment, by walking the free DB.
+
+        Returns `{ totalPages, freePages, reusablePages, pinnedPages, oldestTxnId, entries, runs, largestRun, txn }`, where
+        `pinnedPages` are free pages that can't be reused yet because of the reader of `oldestTxnId`,
+        `runs` is the number of runs of contiguous free pages and `largestRun` the number of pages of the largest one,
+        and `txn` has the `dirtyPages`, `spilledPages`, `dirtyRoom` and `spilledRatio` of the current write transaction, or is null.
+    */
+    static NAN_METHOD(freeStats);
+
+    /*
+        Gets the counters and latency histograms of the operations, when the environment was opened with the metrics option.
+
+        Returns an object with the `count`, `totalTime`, `maxTime`, `p50`, `p90`, `p99` and `p999` (in milliseconds)
+        of `get`, `put`, `del`, `cursor`, `txnBegin`, `commit` (split into `commitWrite` and `commitSync`),
+        `batchQueueWait` and `batch`, and the `bytesRead` and `bytesWritten`.
+
+        Parameters:
+
+        * Options object (optional)
+
+        Possible options are:
+
+        * format: 'prometheus' to get the text format of Prometheus instead
+        * labels: object of labels added to every sample of the Prometheus format
+        * reset: if true, the metrics start again from zero after this call
+    */
+    static NAN_METHOD(metrics);
+
+    /*
+        Returns the spans recorded since the last call when the environment was opened with the trace option,
+        as trace events in the format of Chrome and of the trace events of Node.js, and empties the buffer.
+    */
+    static NAN_METHOD(traceEvents);
+
+    /*
+        Faults the pages of the given databases into the page cache in the background, so that a cold process
+        doesn't wait for the disk on its first reads. The branch pages are read in key order, then the leaf pages
+        are faulted in by several threads, in file order. Not supported on Windows.
+
+        Parameters:
+
+        * Options object
+        * Callback, called with `{ branchPages, leafPages, bytes }`; a promise is returned when it's omitted
+
+        Possible options are:
+
+        * dbis: array of the Dbis to warm up
+        * leaves: if true, the leaf pages are warmed up too, not only the branch pages
+        * maxBytes: no more leaf pages are warmed up once this many bytes are, the branch pages of all the Dbis are always read first
+        * parallel: number of threads that fault the leaf pages in, defaults to the number of CPUs
+    */
+    static NAN_METHOD(warmup);
+
+    /*
+        Checks which pages of the environment are in the page cache, in the background. Not supported on Windows.
+
+        Parameters:
+
+        * Options object (optional) with the `dbis` to check one by one
+        * Callback, called with `{ totalPages, residentPages, ratio, dbis }`, where `dbis` has the
+          `branchPages`, `residentBranchPages`, `leafPages`, `residentLeafPages` and `ratio` of each Dbi;
+          a promise is returned when it's omitted
+    */
+    static NAN_METHOD(residency);
+
+    /*
+        Tells the OS how the pages of the map are going to be used.
+        (Wrapper for `mdb_env_advise`)
+
+        Parameters:
+
+        * Range (optional): a Dbi, or `{ offset, length }` in bytes; the whole map when omitted
+        * Advice: 'normal', 'random', 'sequential', 'willneed' or 'dontneed'
+        * Callback (optional) for a Dbi, whose pages are found in the background; a promise is returned when it's omitted
+    */
+    static NAN_METHOD(advise);
+
+    /*
+        Compacts the environment without closing it: a compacted copy is made in the background,
+        and it replaces the data file once no transaction is active. The copy is made again if something is committed meanwhile.
+        Not supported on Windows, nor while the environment is opened by another Env or process.
+
+        Parameters:
+
+        * Options object that contains the optional `tmpPath` where the copy is made, on the same file system as the data file
+        * Callback, called with `{ pagesBefore, pagesAfter }`; a promise is returned when it's omitted
+    */
+    static NAN_METHOD(compact);
+
     /*
         Opens the database environment with the specified options. The options will be used to configure the environment before opening it.
         (Wrapper for `mdb_env_open`)
@@ -172,6 +669,10 @@ public:
         * maxDbs: the maximum number of named databases you can have in the environment (default is 1)
         * maxReaders: the maximum number of concurrent readers of the environment (default is 126)
         * mapSize: maximal size of the memory map (the full environment) in bytes (default is 10485760 bytes)
+        * autoGrow: { step, max } to grow the map by `step` bytes, up to `max` bytes, when it is full
+        * syncInterval: sync the environment in the background every this many milliseconds, if something was committed (meant for noSync)
+        * syncEveryBytes: sync the environment in the background when commits have written this many bytes since the last sync
+        * readerCheckInterval: clear the stale readers left by crashed processes every this many milliseconds
         * path: path to the database environment
     */
     static NAN_METHOD(open);
@@ -198,6 +699,47 @@ public:
     */
     static NAN_METHOD(copy);    
 
+    /*
+        Copies the database environment into a writable stream, while the environment is in use.
+        (Wrapper for `mdb_env_copyfd2`)
+
+        Parameters:
+
+        * stream - Writable stream (anything with `write(chunk, callback)` and `end()`)
+        * options (optional):
+            * compact: copy using compact setting
+            * bytesPerSecond: don't copy faster than this
+            * end: end the stream when the copy is finished (default is true)
+        * callback - Callback when finished (this is performed asynchronously)
+    */
+    static NAN_METHOD(copyToStream);
+
+    /*
+        Makes an incremental backup: copies the pages that changed since a previous backup into a delta file.
+        (Built on `mdb_env_walk_pages`)
+
+        Parameters:
+
+        * path - Path to the delta file
+        * options:
+            * signature: path to write the signature of this backup to (the hash of every page)
+            * since (optional): path to the signature of the previous backup, without it every page is copied
+        * callback - Callback when finished (this is performed asynchronously), with `{ txnId, baseTxnId, pages, changedPages }`
+    */
+    static NAN_METHOD(copyIncremental);
+
+    /*
+        Applies a delta made by `copyIncremental` onto a copy of the environment. Exported as `applyDelta` by the module.
+
+        Parameters:
+
+        * path - Path to the copy (a data file), it must be at the transaction the delta was made after,
+          or not exist when the delta has every page
+        * deltaPath - Path to the delta file
+        * callback - Callback when finished (this is performed asynchronously), with `{ txnId }`
+    */
+    static NAN_METHOD(applyDelta);
+
     /*
         Closes the database environment.
         (Wrapper for `mdb_env_close`)
@@ -239,6 +781,26 @@ public:
     */
     static NAN_METHOD(openDbi);
 
+    /*
+        Returns a handle to the environment and some of its Dbis that can be posted to a worker thread, where `env.attach` uses it.
+        The handle is a plain object that refers to the environment by its path, so this Env must stay open until it's attached.
+
+        Parameters:
+
+        * Array of open Dbis of this environment (optional)
+    */
+    static NAN_METHOD(share);
+
+    /*
+        Opens this Env on an environment that another Env of the process shares, without opening it again,
+        and returns the shared Dbis in the order they were given to `env.share`, without opening a transaction.
+
+        Parameters:
+
+        * Handle returned by `env.share`
+    */
+    static NAN_METHOD(attach);
+
     /*
         Flushes all data to the disk asynchronously.
         (Asynchronous wrapper for `mdb_env_sync`)
@@ -277,6 +839,12 @@ private:
     
     // Flags used with mdb_txn_begin
     unsigned int flags;
+
+    // Whether the transaction is being committed by `commitAsync`
+    bool committing;
+
+    // Statistics collected by a write transaction for its commit
+    MDB_commit_stat commitStat;
     
     // Remove the current TxnWrap from its EnvWrap
     void removeFromEnvWrap();
@@ -284,6 +852,7 @@ private:
     friend class CursorWrap;
     friend class DbiWrap;
     friend class EnvWrap;
+    friend class CommitWorker;
 
 public:
     TxnWrap(MDB_env *env, MDB_txn *txn);
@@ -301,9 +870,29 @@ public:
     /*
         Commits the transaction.
         (Wrapper for `mdb_txn_commit`)
+
+        Parameters:
+
+        * Options object that contains possible configuration options (optional).
+
+        Possible options are:
+
+        * stats: if true, returns the statistics of the commit of a write transaction: the dirty pages, the pages
+          spilled before the commit, the pages written and the write system calls, and the time of each step in ms
     */
     static NAN_METHOD(commit);
 
+    /*
+        Commits a write transaction, syncing it to disk on a background thread.
+        The transaction can't be used anymore once this is called, and no other write transaction can begin until the callback is called.
+        (Wrapper for `mdb_txn_commit_prepare`, `mdb_txn_commit_sync` and `mdb_txn_commit_finish`)
+
+        Parameters:
+
+        * Callback to be executed after the commit is complete, with an error or null.
+    */
+    static NAN_METHOD(commitAsync);
+
     /*
         Aborts the transaction.
         (Wrapper for `mdb_txn_abort`)
@@ -471,6 +1060,16 @@ private:
     EnvWrap *ew;
     // Whether the Dbi was opened successfully
     bool isOpen;
+    // Whether the handle is also used by other Envs (see env.share), so that closing this Dbi doesn't close the handle
+    bool isShared;
+    // Closed cursors of read-only transactions, kept so that new cursors can reuse them
+    std::vector<MDB_cursor*> cursorCache;
+
+    // Closes the cursors kept in the cursor cache
+    void clearCursorCache();
+
+    // Common code for the set operations over the values of keys of a dupFixed Dbi
+    static Nan::NAN_METHOD_RETURN_TYPE dupsCommon(Nan::NAN_METHOD_ARGS_TYPE info, int operation, const char *name);
 
     friend class TxnWrap;
     friend class CursorWrap;
@@ -504,6 +1103,105 @@ public:
     static NAN_METHOD(drop);
 
     static NAN_METHOD(stat);
+
+    /*
+        Counts the entries whose keys fall between two keys.
+        By default the count is estimated from the positions of the two keys in the B-tree, which takes O(log n) time.
+        (Uses `mdb_cursor_pos`, walks the range with `mdb_cursor_get` and `mdb_cursor_count` when exact)
+
+        Parameters:
+
+        * Transaction object
+        * First key of the range, inclusive (null to start at the first key)
+        * End of the range, exclusive (null to go up to the last key)
+        * Options object (optional)
+
+        Possible options are:
+
+        * exact - walk the range and count every entry instead of estimating
+        * and the key type options
+    */
+    static NAN_METHOD(countRange);
+
+    /*
+        Estimates the number of entries and the number of bytes of database pages between two keys, in O(log n) time.
+        Returns an object with `entries` and `bytes` properties.
+        (Uses `mdb_cursor_pos` and `mdb_stat`)
+
+        Parameters:
+
+        * Transaction object
+        * First key of the range, inclusive (null to start at the first key)
+        * End of the range, exclusive (null to go up to the last key)
+        * Options object with the key type options (optional)
+    */
+    static NAN_METHOD(estimateSize);
+
+    /*
+        Returns keys that split the database into the given number of parts of roughly equal size, without scanning it.
+        The first part starts at the first key and each other part at one of the returned keys.
+        Fewer keys are returned if the database doesn't have enough distinct keys.
+        (Uses `mdb_cursor_set_pos`)
+
+        Parameters:
+
+        * Transaction object
+        * Number of parts
+        * Options object with the key type options (optional)
+    */
+    static NAN_METHOD(splitPoints);
+
+    /*
+        Scans the database (or a key range of it) on multiple threads and reduces the key/data pairs natively.
+        The range is split into parts of about equal size, which the threads scan in read-only transactions of the same snapshot.
+
+        Parameters:
+
+        * Options object
+        * Callback that receives an error (or null) and an object with the results of the reducers
+
+        Possible options are:
+
+        * threads - number of threads to use, defaults to the number of CPUs,
+          each of them takes a slot of the reader lock table
+        * reduce - array of reducers to run: count (the default), sum, min, max, keyRange and sizeHistogram
+        * field - the numeric field that sum, min and max read from the data: { offset, type },
+          where type is double (default), float, int32 or uint32
+        * start - first key of the range, inclusive (optional)
+        * end - end of the range, exclusive (optional)
+        * and the key type options
+    */
+    static NAN_METHOD(parallelScan);
+
+    /*
+        Intersects the sorted values of the given keys of a dupSort and dupFixed Dbi natively.
+        The values are read a page at a time, and each list skips ahead to the value that the others are at,
+        by galloping on the page or by searching the B-tree.
+        Returns a Uint32Array or a BigUint64Array for integerDup values, or else a Buffer of the values one after the other.
+        (Uses `mdb_cursor_get` with `MDB_GET_MULTIPLE`, `MDB_NEXT_MULTIPLE` and `MDB_GET_BOTH_RANGE`)
+
+        Parameters:
+
+        * Transaction object
+        * Array of keys
+        * Options object (optional)
+
+        Possible options are:
+
+        * limit - the most values to return
+        * and the key type options
+    */
+    static NAN_METHOD(intersectDups);
+
+    /*
+        Returns the union of the sorted values of the given keys of a dupSort and dupFixed Dbi, like dbi.intersectDups.
+    */
+    static NAN_METHOD(unionDups);
+
+    /*
+        Returns the values of the first key that none of the other keys have, like dbi.intersectDups.
+    */
+    static NAN_METHOD(differenceDups);
 };
 
 /*
@@ -550,6 +1248,7 @@ public:
 
     /*
         Closes the cursor.
+        Cursors of read-only transactions are kept by the database instance and reused by the next cursor opened on it.
         (Wrapper for `mdb_cursor_close`)
 
         Parameters:
@@ -559,6 +1258,16 @@ public:
     */
     static NAN_METHOD(close);
 
+    /*
+        Binds the cursor to a new read-only transaction, so that it can be reused without being closed and opened again.
+        (Wrapper for `mdb_cursor_renew`)
+
+        Parameters:
+
+        * Read-only transaction object
+    */
+    static NAN_METHOD(renew);
+
     // Helper method for getters (not exposed)
     static Nan::NAN_METHOD_RETURN_TYPE getCommon(
         Nan::NAN_METHOD_ARGS_TYPE info, MDB_cursor_op op,
@@ -711,6 +1420,47 @@ public:
         (Wrapper for `mdb_cursor_del`)
     */
     static NAN_METHOD(del);
+
+    /*
+        Stores a key/data pair through the cursor and leaves the cursor positioned at it.
+        Unlike the put methods of the transaction, this can update the item the cursor is already at without searching the tree again.
+        (Wrapper for `mdb_cursor_put`)
+
+        Parameters:
+
+        * key to store
+        * data to store (string, Buffer, number or boolean)
+        * options (optional): noDupData, noOverwrite, append, appendDup, current and the key type
+    */
+    static NAN_METHOD(put);
+
+    /*
+        Reserves space for data of the given size at the given key and returns a Buffer pointing to it, which should be filled before the next write operation.
+        (Wrapper for `mdb_cursor_put` with `MDB_RESERVE`)
+
+        Parameters:
+
+        * key to store
+        * size of the data in bytes
+        * options (optional): same as for `put`
+    */
+    static NAN_METHOD(putReserve);
+
+    /*
+        Replaces the data of the key/data pair the cursor is pointing to.
+        (Wrapper for `mdb_cursor_put` with `MDB_CURRENT`)
+
+        Parameters:
+
+        * data to store (string, Buffer, number or boolean)
+    */
+    static NAN_METHOD(replace);
+
+    /*
+        Returns the number of data items stored for the current key. Only valid for `dupSort` databases.
+        (Wrapper for `mdb_cursor_count`)
+    */
+    static NAN_METHOD(countDups);
 };
 
 // External string resource that glues MDB_val and v8::String
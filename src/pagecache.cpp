@@ -0,0 +1,975 @@
+
+// This file is part of node-lmdb, the Node.js binding for lmdb
+// Copyright (c) 2013-2017 Timur Kristóf
+// Licensed to you under the terms of the MIT license
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "node-lmdb.h"
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+using namespace v8;
+using namespace node;
+
+// Bytes between the addresses touched by the warmup, the smallest page size of the OS
+#define WARMUP_TOUCH_STRIDE (4096)
+// Value returned by the page functions to stop a walk early
+#define WALK_STOPPED (-30000)
+// Value returned by the page functions when a Dbi is waiting to be closed, the walk lets go of the Dbis and begins again
+#define WALK_YIELDED (-30001)
+// Milliseconds between a commit and the refresh of the locked branch pages, the commits meanwhile share the refresh
+#define BRANCH_LOCK_DELAY (100)
+// Pages whose residency is checked at once, so that the buffer doesn't grow with the map
+#define RESIDENCY_CHUNK_PAGES (64 * 1024)
+
+// A page of a database and its address in the map
+struct page_ref_t {
+    mdb_size_t pgno;
+    const char *address;
+};
+
+struct walk_pages_t {
+    std::vector<page_ref_t> *pages;
+    size_t maxPages;
+    const std::atomic<int> *closingDbis;
+};
+
+static int collectPage(void *ctx, mdb_size_t pgno, const void *address, mdb_size_t) {
+    walk_pages_t *walk = (walk_pages_t*) ctx;
+    if (*walk->closingDbis) {
+        return WALK_YIELDED;
+    }
+    if (walk->pages->size() >= walk->maxPages) {
+        return WALK_STOPPED;
+    }
+    walk->pages->push_back({ pgno, (const char*) address });
+    return 0;
+}
+
+// Collects the branch pages of a database, and its leaf pages up to maxLeaves if leaves is set
+static int walkDbi(MDB_txn *txn, MDB_dbi dbi, bool leaves, size_t maxLeaves, const std::atomic<int> *closingDbis,
+    std::vector<page_ref_t> &branchPages, std::vector<page_ref_t> &leafPages) {
+    walk_pages_t walk = { &branchPages, SIZE_MAX, closingDbis };
+    int rc = mdb_dbi_walk(txn, dbi, 0, collectPage, &walk);
+    if (rc != 0 || !leaves || !maxLeaves) {
+        return rc;
+    }
+
+    // The callback can't tell the branch pages from the leaves without reading them, which would fault the leaves in
+    std::vector<page_ref_t> pages;
+    walk = { &pages, maxLeaves < SIZE_MAX - branchPages.size() ? branchPages.size() + maxLeaves : SIZE_MAX, closingDbis };
+    rc = mdb_dbi_walk(txn, dbi, MDB_WALK_LEAVES, collectPage, &walk);
+    if (rc != 0 && rc != WALK_STOPPED) {
+        return rc;
+    }
+    std::vector<mdb_size_t> branches;
+    for (page_ref_t &page : branchPages) {
+        branches.push_back(page.pgno);
+    }
+    std::sort(branches.begin(), branches.end());
+    for (page_ref_t &page : pages) {
+        if (leafPages.size() < maxLeaves && !std::binary_search(branches.begin(), branches.end(), page.pgno)) {
+            leafPages.push_back(page);
+        }
+    }
+    return 0;
+}
+
+static mdb_size_t pgnoOf(const page_ref_t &page) {
+    return page.pgno;
+}
+
+static mdb_size_t pgnoOf(mdb_size_t pgno) {
+    return pgno;
+}
+
+// Calls the function with each run of contiguous pages, the pages must be sorted
+template<typename T, typename F>
+static int forEachRun(const std::vector<T> &pages, F func) {
+    size_t start = 0;
+    for (size_t i = 1; i <= pages.size(); i++) {
+        if (i == pages.size() || pgnoOf(pages[i]) != pgnoOf(pages[i - 1]) + 1) {
+            int rc = func(pgnoOf(pages[start]), (mdb_size_t) (i - start));
+            if (rc != 0) {
+                return rc;
+            }
+            start = i;
+        }
+    }
+    return 0;
+}
+
+static bool byPgno(const page_ref_t &a, const page_ref_t &b) {
+    return a.pgno < b.pgno;
+}
+
+static int adviceFromString(Local<Value> value) {
+    Nan::Utf8String name(value);
+    if (!value->IsString() || !*name) {
+        return -1;
+    }
+    if (!strcmp(*name, "normal")) {
+        return MDB_ADVICE_NORMAL;
+    }
+    if (!strcmp(*name, "random")) {
+        return MDB_ADVICE_RANDOM;
+    }
+    if (!strcmp(*name, "sequential")) {
+        return MDB_ADVICE_SEQUENTIAL;
+    }
+    if (!strcmp(*name, "willneed")) {
+        return MDB_ADVICE_WILLNEED;
+    }
+    if (!strcmp(*name, "dontneed")) {
+        return MDB_ADVICE_DONTNEED;
+    }
+    return -1;
+}
+
+#ifndef _WIN32
+class WarmupWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    WarmupWorker(Nan::Callback *callback, EnvWrap *ew, std::vector<MDB_dbi> dbis, bool leaves, double maxBytes, unsigned int parallel)
+      : PromiseWorker(callback, "node-lmdb:Warmup"), ew(ew), txn(nullptr), dbis(dbis), leaves(leaves), maxBytes(maxBytes), parallel(parallel), bytes(0) {}
+
+    ~WarmupWorker() {
+        // In case the warmup was never started
+        if (txn) {
+            mdb_txn_abort(txn);
+            ew->backgroundReaders--;
+            ew->runIdleCallbacks();
+        }
+    }
+
+    int beginTxn() {
+        int rc = mdb_txn_begin(ew->env, nullptr, MDB_RDONLY, &txn);
+        if (rc == 0) {
+            ew->backgroundReaders++;
+        }
+        return rc;
+    }
+
+    void Execute() {
+        MDB_stat stat;
+        mdb_env_stat(ew->env, &stat);
+        size_t psize = stat.ms_psize;
+        size_t budget = maxBytes > 0 ? (size_t) (maxBytes / psize) : SIZE_MAX;
+
+        // Walking the branch pages reads them, which is their warmup
+        int rc = ew->lockDbis(txn);
+        for (size_t i = 0; rc == 0 && i < dbis.size(); i++) {
+            size_t walked = branchPages.size();
+            rc = ew->retryWalk(txn, [&]() -> int {
+                branchPages.resize(walked);
+                return walkDbi(txn, dbis[i], false, 0, &ew->closingDbis, branchPages, leafPages);
+            });
+        }
+        for (size_t i = 0; rc == 0 && leaves && i < dbis.size(); i++) {
+            std::vector<page_ref_t> dbiBranchPages;
+            size_t used = branchPages.size() + leafPages.size();
+            size_t walked = leafPages.size();
+            rc = ew->retryWalk(txn, [&]() -> int {
+                dbiBranchPages.clear();
+                leafPages.resize(walked);
+                return walkDbi(txn, dbis[i], true, used < budget ? budget - used : 0, &ew->closingDbis, dbiBranchPages, leafPages);
+            });
+        }
+        ew->unlockDbis();
+
+        if (rc == 0 && !leafPages.empty()) {
+            // In file order, with the kernel reading each run ahead while the threads fault the pages in
+            std::sort(leafPages.begin(), leafPages.end(), byPgno);
+            forEachRun(leafPages, [this](mdb_size_t pgno, mdb_size_t count) -> int {
+                mdb_env_advise(ew->env, pgno, count, MDB_ADVICE_WILLNEED);
+                return 0;
+            });
+
+            std::vector<std::thread> threads;
+            size_t share = (leafPages.size() + parallel - 1) / parallel;
+            for (size_t start = share; start < leafPages.size(); start += share) {
+                threads.emplace_back(&WarmupWorker::touch, this, start, std::min(start + share, leafPages.size()), psize);
+            }
+            touch(0, std::min(share, leafPages.size()), psize);
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+        bytes = (double) (branchPages.size() + leafPages.size()) * psize;
+
+        // The transaction is not bound to this thread because of MDB_NOTLS
+        mdb_txn_abort(txn);
+        txn = nullptr;
+
+        if (rc != 0) {
+            SetErrorMessage(mdb_strerror(rc));
+        }
+    }
+
+    void WorkComplete() {
+        ew->backgroundReaders--;
+        Nan::AsyncWorker::WorkComplete();
+        // Growing the map may have been waiting for the warmup to finish
+        ew->runIdleCallbacks();
+    }
+
+    Local<Value> result() {
+        Local<Context> context = Nan::GetCurrentContext();
+
+        Local<Object> obj = Nan::New<Object>();
+        (void)obj->Set(context, Nan::New<String>("branchPages").ToLocalChecked(), Nan::New<Number>((double) branchPages.size()));
+        (void)obj->Set(context, Nan::New<String>("leafPages").ToLocalChecked(), Nan::New<Number>((double) leafPages.size()));
+        (void)obj->Set(context, Nan::New<String>("bytes").ToLocalChecked(), Nan::New<Number>(bytes));
+        return obj;
+    }
+
+  private:
+    // Reads a byte of every page of the OS in the given leaf pages
+    void touch(size_t start, size_t end, size_t psize) {
+        volatile char sum = 0;
+        for (size_t i = start; i < end; i++) {
+            for (size_t offset = 0; offset < psize; offset += WARMUP_TOUCH_STRIDE) {
+                sum += leafPages[i].address[offset];
+            }
+        }
+        (void) sum;
+    }
+
+    EnvWrap *ew;
+    MDB_txn *txn;
+    std::vector<MDB_dbi> dbis;
+    bool leaves;
+    double maxBytes;
+    unsigned int parallel;
+    std::vector<page_ref_t> branchPages;
+    std::vector<page_ref_t> leafPages;
+    double bytes;
+};
+
+// The residency of the pages of a database
+struct dbi_residency_t {
+    size_t branchPages;
+    size_t residentBranchPages;
+    size_t leafPages;
+    size_t residentLeafPages;
+};
+
+struct branch_residency_t {
+    MDB_env *env;
+    const std::atomic<int> *closingDbis;
+    size_t pages;
+    size_t residentPages;
+};
+
+// The walk calls this before it reads the branch page, which would fault it in
+static int checkBranchPage(void *ctx, mdb_size_t pgno, const void *, mdb_size_t) {
+    branch_residency_t *walk = (branch_residency_t*) ctx;
+    if (*walk->closingDbis) {
+        return WALK_YIELDED;
+    }
+    unsigned char resident;
+    int rc = mdb_env_resident(walk->env, pgno, 1, &resident);
+    walk->pages++;
+    walk->residentPages += resident;
+    return rc;
+}
+
+// Counts the resident pages among the sorted pages, a chunk of the map at a time
+static int countResident(MDB_env *env, const std::vector<mdb_size_t> &pages, std::vector<unsigned char> &chunk, size_t &count) {
+    for (size_t i = 0; i < pages.size(); ) {
+        mdb_size_t first = pages[i];
+        int rc = mdb_env_resident(env, first, chunk.size(), chunk.data());
+        if (rc != 0) {
+            return rc;
+        }
+        for (; i < pages.size() && pages[i] - first < chunk.size(); i++) {
+            count += chunk[pages[i] - first];
+        }
+    }
+    return 0;
+}
+
+class ResidencyWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    ResidencyWorker(Nan::Callback *callback, EnvWrap *ew, std::vector<MDB_dbi> dbis)
+      : PromiseWorker(callback, "node-lmdb:Residency"), ew(ew), txn(nullptr), dbis(dbis), totalPages(0), residentPages(0) {}
+
+    ~ResidencyWorker() {
+        // In case the check was never started
+        if (txn) {
+            mdb_txn_abort(txn);
+            ew->backgroundReaders--;
+            ew->runIdleCallbacks();
+        }
+    }
+
+    int beginTxn() {
+        int rc = mdb_txn_begin(ew->env, nullptr, MDB_RDONLY, &txn);
+        if (rc == 0) {
+            ew->backgroundReaders++;
+        }
+        return rc;
+    }
+
+    void Execute() {
+        int rc = 0;
+
+        // Before the walks, which fault the branch pages in
+        MDB_envinfo envinfo;
+        mdb_env_info(ew->env, &envinfo);
+        totalPages = envinfo.me_last_pgno + 1;
+        std::vector<unsigned char> chunk(std::min(totalPages, (size_t) RESIDENCY_CHUNK_PAGES));
+        for (size_t pgno = 0; rc == 0 && pgno < totalPages; pgno += chunk.size()) {
+            size_t count = std::min(chunk.size(), totalPages - pgno);
+            rc = mdb_env_resident(ew->env, pgno, count, chunk.data());
+            for (size_t i = 0; rc == 0 && i < count; i++) {
+                residentPages += chunk[i];
+            }
+        }
+
+        // The residency of the leaves is counted after the walks, so that the Dbis can be closed meanwhile
+        std::vector<std::vector<mdb_size_t>> leaves(dbis.size());
+        if (rc == 0) {
+            rc = ew->lockDbis(txn);
+            for (size_t i = 0; rc == 0 && i < dbis.size(); i++) {
+                branch_residency_t branches = { ew->env, &ew->closingDbis, 0, 0 };
+                std::vector<page_ref_t> branchPages, leafPages;
+                rc = ew->retryWalk(txn, [&]() -> int {
+                    branches.pages = branches.residentPages = 0;
+                    branchPages.clear();
+                    leafPages.clear();
+                    int walkRc = mdb_dbi_walk(txn, dbis[i], 0, checkBranchPage, &branches);
+                    // The walk of the leaves doesn't read them
+                    return walkRc != 0 ? walkRc : walkDbi(txn, dbis[i], true, SIZE_MAX, &ew->closingDbis, branchPages, leafPages);
+                });
+                std::transform(leafPages.begin(), leafPages.end(), std::back_inserter(leaves[i]), [](const page_ref_t &page) -> mdb_size_t {
+                    return page.pgno;
+                });
+                results.push_back({ branches.pages, branches.residentPages, leaves[i].size(), 0 });
+            }
+            ew->unlockDbis();
+        }
+        for (size_t i = 0; rc == 0 && i < results.size(); i++) {
+            std::sort(leaves[i].begin(), leaves[i].end());
+            rc = countResident(ew->env, leaves[i], chunk, results[i].residentLeafPages);
+        }
+
+        // The transaction is not bound to this thread because of MDB_NOTLS
+        mdb_txn_abort(txn);
+        txn = nullptr;
+
+        if (rc != 0) {
+            SetErrorMessage(mdb_strerror(rc));
+        }
+    }
+
+    void WorkComplete() {
+        ew->backgroundReaders--;
+        Nan::AsyncWorker::WorkComplete();
+        // Growing the map may have been waiting for the check to finish
+        ew->runIdleCallbacks();
+    }
+
+    Local<Value> result() {
+        Local<Context> context = Nan::GetCurrentContext();
+        auto ratio = [](size_t part, size_t total) -> double {
+            return total ? (double) part / total : 1;
+        };
+
+        Local<Object> residency = Nan::New<Object>();
+        (void)residency->Set(context, Nan::New<String>("totalPages").ToLocalChecked(), Nan::New<Number>((double) totalPages));
+        (void)residency->Set(context, Nan::New<String>("residentPages").ToLocalChecked(), Nan::New<Number>((double) residentPages));
+        (void)residency->Set(context, Nan::New<String>("ratio").ToLocalChecked(), Nan::New<Number>(ratio(residentPages, totalPages)));
+
+        Local<Array> dbiResults = Nan::New<Array>();
+        for (unsigned int i = 0; i < results.size(); i++) {
+            dbi_residency_t &r = results[i];
+            Local<Object> obj = Nan::New<Object>();
+            (void)obj->Set(context, Nan::New<String>("branchPages").ToLocalChecked(), Nan::New<Number>((double) r.branchPages));
+            (void)obj->Set(context, Nan::New<String>("residentBranchPages").ToLocalChecked(), Nan::New<Number>((double) r.residentBranchPages));
+            (void)obj->Set(context, Nan::New<String>("leafPages").ToLocalChecked(), Nan::New<Number>((double) r.leafPages));
+            (void)obj->Set(context, Nan::New<String>("residentLeafPages").ToLocalChecked(), Nan::New<Number>((double) r.residentLeafPages));
+            (void)obj->Set(context, Nan::New<String>("ratio").ToLocalChecked(), Nan::New<Number>(
+                ratio(r.residentBranchPages + r.residentLeafPages, r.branchPages + r.leafPages)));
+            (void)Nan::Set(dbiResults, i, obj);
+        }
+        (void)residency->Set(context, Nan::New<String>("dbis").ToLocalChecked(), dbiResults);
+        return residency;
+    }
+
+  private:
+    EnvWrap *ew;
+    MDB_txn *txn;
+    std::vector<MDB_dbi> dbis;
+    size_t totalPages;
+    size_t residentPages;
+    std::vector<dbi_residency_t> results;
+};
+
+class AdviseWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    AdviseWorker(Nan::Callback *callback, EnvWrap *ew, MDB_dbi dbi, int advice)
+      : PromiseWorker(callback, "node-lmdb:Advise"), ew(ew), txn(nullptr), dbi(dbi), advice(advice) {}
+
+    ~AdviseWorker() {
+        // In case the advice was never started
+        if (txn) {
+            mdb_txn_abort(txn);
+            ew->backgroundReaders--;
+            ew->runIdleCallbacks();
+        }
+    }
+
+    int beginTxn() {
+        int rc = mdb_txn_begin(ew->env, nullptr, MDB_RDONLY, &txn);
+        if (rc == 0) {
+            ew->backgroundReaders++;
+        }
+        return rc;
+    }
+
+    void Execute() {
+        std::vector<page_ref_t> branchPages, leafPages;
+        int rc = ew->lockDbis(txn);
+        if (rc == 0) {
+            rc = ew->retryWalk(txn, [&]() -> int {
+                branchPages.clear();
+                leafPages.clear();
+                return walkDbi(txn, dbi, true, SIZE_MAX, &ew->closingDbis, branchPages, leafPages);
+            });
+        }
+        ew->unlockDbis();
+
+        if (rc == 0) {
+            leafPages.insert(leafPages.end(), branchPages.begin(), branchPages.end());
+            std::sort(leafPages.begin(), leafPages.end(), byPgno);
+            rc = forEachRun(leafPages, [this](mdb_size_t pgno, mdb_size_t count) -> int {
+                return mdb_env_advise(ew->env, pgno, count, advice);
+            });
+        }
+
+        // The transaction is not bound to this thread because of MDB_NOTLS
+        mdb_txn_abort(txn);
+        txn = nullptr;
+
+        if (rc != 0) {
+            SetErrorMessage(mdb_strerror(rc));
+        }
+    }
+
+    void WorkComplete() {
+        ew->backgroundReaders--;
+        Nan::AsyncWorker::WorkComplete();
+        // Growing the map may have been waiting for the advice to finish
+        ew->runIdleCallbacks();
+    }
+
+  private:
+    EnvWrap *ew;
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    int advice;
+};
+#endif
+
+int EnvWrap::lockDbis(MDB_txn *txn) {
+    // A Dbi that is waiting to be closed goes first, without the lock being taken meanwhile
+    for (;;) {
+        while (closingDbis) {
+            std::this_thread::yield();
+        }
+        uv_rwlock_rdlock(&dbiLock);
+        if (!closingDbis) {
+            break;
+        }
+        uv_rwlock_rdunlock(&dbiLock);
+    }
+    // The transaction was begun earlier, it's begun again so that it doesn't see a Dbi that was closed meanwhile
+    mdb_txn_reset(txn);
+    return mdb_txn_renew(txn);
+}
+
+void EnvWrap::unlockDbis() {
+    uv_rwlock_rdunlock(&dbiLock);
+}
+
+int EnvWrap::retryWalk(MDB_txn *txn, std::function<int()> walk) {
+    int rc = walk();
+    while (rc == WALK_YIELDED) {
+        // Lets the Dbi be closed, the walk fails afterwards if it was one of those it walks
+        unlockDbis();
+        rc = lockDbis(txn);
+        if (rc == 0) {
+            rc = walk();
+        }
+    }
+    return rc;
+}
+
+void EnvWrap::beginCloseDbi() {
+    // The walks that hold the lock let go of it at their next page
+    closingDbis++;
+    uv_rwlock_wrlock(&dbiLock);
+}
+
+void EnvWrap::endCloseDbi() {
+    uv_rwlock_wrunlock(&dbiLock);
+    closingDbis--;
+}
+
+bool EnvWrap::dbisArgument(Local<Value> value, std::vector<MDB_dbi> &dbis) {
+    Local<Context> context = Nan::GetCurrentContext();
+    if (!value->IsArray()) {
+        return false;
+    }
+    Local<Array> array = Local<Array>::Cast(value);
+    for (unsigned int i = 0; i < array->Length(); i++) {
+        Local<Value> element = array->Get(context, i).ToLocalChecked();
+        if (!element->IsObject()) {
+            return false;
+        }
+        DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(Local<Object>::Cast(element));
+        if (!dw->isOpen || dw->env != env) {
+            return false;
+        }
+        dbis.push_back(dw->dbi);
+    }
+    return true;
+}
+
+NAN_METHOD(EnvWrap::warmup) {
+    Nan::HandleScope scope;
+
+#ifdef _WIN32
+    return Nan::ThrowError("env.warmup() is not supported on Windows.");
+#else
+    Local<Context> context = Nan::GetCurrentContext();
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+    if (!info[0]->IsObject() || info[0]->IsFunction()) {
+        return Nan::ThrowError("Call env.warmup(options, callback?) with the dbis to warm up.");
+    }
+    Local<Object> options = Local<Object>::Cast(info[0]);
+
+    std::vector<MDB_dbi> dbis;
+    if (!ew->dbisArgument(options->Get(context, Nan::New<String>("dbis").ToLocalChecked()).ToLocalChecked(), dbis)) {
+        return Nan::ThrowError("The dbis option should be an array of open Dbis of this environment.");
+    }
+
+    bool leaves = options->Get(context, Nan::New<String>("leaves").ToLocalChecked()).ToLocalChecked()->IsTrue();
+
+    // No limit by default
+    double maxBytes = 0;
+    Local<Value> maxBytesOption = options->Get(context, Nan::New<String>("maxBytes").ToLocalChecked()).ToLocalChecked();
+    if (maxBytesOption->IsNumber() && maxBytesOption->NumberValue(context).FromJust() > 0) {
+        maxBytes = maxBytesOption->NumberValue(context).FromJust();
+    }
+    else if (!maxBytesOption->IsUndefined()) {
+        return Nan::ThrowError("The maxBytes option should be a positive number.");
+    }
+
+    // Number of threads that fault the leaves in, defaults to the number of CPUs
+    unsigned int parallel = std::max(std::thread::hardware_concurrency(), 1u);
+    Local<Value> parallelOption = options->Get(context, Nan::New<String>("parallel").ToLocalChecked()).ToLocalChecked();
+    if (parallelOption->IsUint32() && parallelOption->Uint32Value(context).FromJust() > 0) {
+        parallel = parallelOption->Uint32Value(context).FromJust();
+    }
+    else if (!parallelOption->IsUndefined()) {
+        return Nan::ThrowError("The parallel option should be a positive integer.");
+    }
+
+    Nan::Callback *callback = callbackArgument(info[1]);
+    WarmupWorker *worker = new WarmupWorker(callback, ew, dbis, leaves, maxBytes, parallel);
+    int rc = worker->beginTxn();
+    if (rc != 0) {
+        delete worker;
+        return throwLmdbError(rc);
+    }
+
+    // Keep the environment alive while the warmup is running
+    worker->SaveToPersistent("env", info.This());
+    worker->promiseUnlessCallback(info);
+    Nan::AsyncQueueWorker(worker);
+#endif
+}
+
+NAN_METHOD(EnvWrap::residency) {
+    Nan::HandleScope scope;
+
+#ifdef _WIN32
+    return Nan::ThrowError("env.residency() is not supported on Windows.");
+#else
+    Local<Context> context = Nan::GetCurrentContext();
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    std::vector<MDB_dbi> dbis;
+    Local<Value> callbackArg = info[0];
+    if (info[0]->IsObject() && !info[0]->IsFunction()) {
+        Local<Object> options = Local<Object>::Cast(info[0]);
+        Local<Value> dbisOption = options->Get(context, Nan::New<String>("dbis").ToLocalChecked()).ToLocalChecked();
+        if (!dbisOption->IsUndefined() && !ew->dbisArgument(dbisOption, dbis)) {
+            return Nan::ThrowError("The dbis option should be an array of open Dbis of this environment.");
+        }
+        callbackArg = info[1];
+    }
+
+    Nan::Callback *callback = callbackArgument(callbackArg);
+    ResidencyWorker *worker = new ResidencyWorker(callback, ew, dbis);
+    int rc = worker->beginTxn();
+    if (rc != 0) {
+        delete worker;
+        return throwLmdbError(rc);
+    }
+
+    // Keep the environment alive while the check is running
+    worker->SaveToPersistent("env", info.This());
+    worker->promiseUnlessCallback(info);
+    Nan::AsyncQueueWorker(worker);
+#endif
+}
+
+NAN_METHOD(EnvWrap::advise) {
+    Nan::HandleScope scope;
+
+#ifdef _WIN32
+    return Nan::ThrowError("env.advise() is not supported on Windows.");
+#else
+    Local<Context> context = Nan::GetCurrentContext();
+
+    // Get the wrapper
+    EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+
+    if (!ew->env) {
+        return Nan::ThrowError("The environment is already closed.");
+    }
+
+    Local<Value> range = info.Length() > 1 ? info[0] : Local<Value>(Nan::Undefined());
+    int advice = adviceFromString(info.Length() > 1 ? info[1] : info[0]);
+    if (advice < 0) {
+        return Nan::ThrowError("Unknown advice. Supported advice is: normal, random, sequential, willneed and dontneed.");
+    }
+
+    MDB_stat stat;
+    mdb_env_stat(ew->env, &stat);
+    int rc;
+    if (range->IsUndefined() || range->IsNull()) {
+        // The whole map, the call clamps the count to its size
+        rc = mdb_env_advise(ew->env, 0, (mdb_size_t) -1, advice);
+    }
+    else if (range->IsObject() && Local<Object>::Cast(range)->InternalFieldCount() > 0) {
+        DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(Local<Object>::Cast(range));
+        if (!dw->isOpen || dw->env != ew->env) {
+            return Nan::ThrowError("Only the open Dbis of this environment can be advised.");
+        }
+
+        // Walking the Dbi reads its branch pages, so it's done in the background
+        Nan::Callback *callback = callbackArgument(info[2]);
+        AdviseWorker *worker = new AdviseWorker(callback, ew, dw->dbi, advice);
+        rc = worker->beginTxn();
+        if (rc != 0) {
+            delete worker;
+            return throwLmdbError(rc);
+        }
+
+        // Keep the environment alive while the advice is running
+        worker->SaveToPersistent("env", info.This());
+        worker->promiseUnlessCallback(info);
+        Nan::AsyncQueueWorker(worker);
+        return;
+    }
+    else if (range->IsObject()) {
+        Local<Object> rangeObj = Local<Object>::Cast(range);
+        Local<Value> offset = rangeObj->Get(context, Nan::New<String>("offset").ToLocalChecked()).ToLocalChecked();
+        Local<Value> length = rangeObj->Get(context, Nan::New<String>("length").ToLocalChecked()).ToLocalChecked();
+        if (!offset->IsNumber() || !length->IsNumber() || offset->NumberValue(context).FromJust() < 0 || length->NumberValue(context).FromJust() < 0) {
+            return Nan::ThrowError("The range should be a Dbi or an object with the offset and length in bytes.");
+        }
+        // Every page that overlaps the range
+        mdb_size_t start = (mdb_size_t) offset->NumberValue(context).FromJust();
+        mdb_size_t end = start + (mdb_size_t) length->NumberValue(context).FromJust();
+        mdb_size_t pgno = start / stat.ms_psize;
+        rc = mdb_env_advise(ew->env, pgno, (end + stat.ms_psize - 1) / stat.ms_psize - pgno, advice);
+    }
+    else {
+        return Nan::ThrowError("The range should be a Dbi or an object with the offset and length in bytes.");
+    }
+
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+#endif
+}
+
+class BranchLockWorker : public Nan::AsyncWorker {
+  public:
+    BranchLockWorker(BranchLocker *locker)
+      : Nan::AsyncWorker(nullptr, "node-lmdb:LockBranchPages"), locker(locker), ew(locker->ew), env(locker->ew->env), txn(nullptr),
+      dbis(locker->dbis), maxPages(locker->maxPages), locked(locker->locked), generation(locker->generation) {
+        // A Dbi that several Dbi objects have open is walked once
+        std::sort(dbis.begin(), dbis.end());
+        dbis.erase(std::unique(dbis.begin(), dbis.end()), dbis.end());
+    }
+
+    void Execute() {
+        // The environment may be closed while the refresh waits in the thread pool, but not while it runs
+        uv_mutex_lock(&locker->closeLock);
+        if (!locker->closed && generation == locker->generation) {
+            refresh();
+        }
+        uv_mutex_unlock(&locker->closeLock);
+    }
+
+    void WorkComplete() {
+        if (!locker->closed && generation == locker->generation) {
+            locker->locked = std::move(locked);
+        }
+        locker->running = false;
+        if (locker->pending) {
+            locker->refresh();
+        }
+        // Growing the map may have been waiting for the refresh to finish
+        ew->runIdleCallbacks();
+    }
+
+  private:
+    // Locks the branch pages that are new, and unlocks those that aren't branch pages anymore
+    void refresh() {
+        std::vector<mdb_size_t> pages;
+        int rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+        if (rc == 0) {
+            rc = ew->lockDbis(txn);
+            if (rc == 0) {
+                rc = branchPages(pages);
+            }
+            ew->unlockDbis();
+            mdb_txn_abort(txn);
+            txn = nullptr;
+        }
+        // Without a transaction, such as when the reader table is full, the pages stay as they are
+        if (rc != 0) {
+            return;
+        }
+
+        std::vector<mdb_size_t> unlock, lock;
+        std::set_difference(locked.begin(), locked.end(), pages.begin(), pages.end(), std::back_inserter(unlock));
+        std::set_difference(pages.begin(), pages.end(), locked.begin(), locked.end(), std::back_inserter(lock));
+        std::vector<mdb_size_t> kept;
+        std::set_intersection(locked.begin(), locked.end(), pages.begin(), pages.end(), std::back_inserter(kept));
+
+        forEachRun(unlock, [this](mdb_size_t pgno, mdb_size_t count) -> int {
+            mdb_env_lock(env, pgno, count, 0);
+            return 0;
+        });
+        // Stops at the first failure, such as reaching RLIMIT_MEMLOCK, the rest stays unlocked
+        std::vector<mdb_size_t> added;
+        forEachRun(lock, [this, &added](mdb_size_t pgno, mdb_size_t count) -> int {
+            int rc = mdb_env_lock(env, pgno, count, 1);
+            for (mdb_size_t i = 0; rc == 0 && i < count; i++) {
+                added.push_back(pgno + i);
+            }
+            return rc;
+        });
+
+        locked.clear();
+        std::merge(kept.begin(), kept.end(), added.begin(), added.end(), std::back_inserter(locked));
+    }
+
+    // Walks a Dbi down to the levels of the flags, a Dbi that was dropped or closed meanwhile has no pages
+    int walkPages(MDB_dbi dbi, unsigned int flags, std::vector<page_ref_t> &walked) {
+        int rc = ew->retryWalk(txn, [&]() -> int {
+            walked.clear();
+            walk_pages_t walk = { &walked, SIZE_MAX, &ew->closingDbis };
+            return mdb_dbi_walk(txn, dbi, flags, collectPage, &walk);
+        });
+        if (rc != 0) {
+            walked.clear();
+        }
+        // The transaction can't be used anymore if it couldn't be renewed after a Dbi was closed
+        return rc == MDB_BAD_TXN ? rc : 0;
+    }
+
+    // Finds the branch pages to lock, level by level so that the top levels of every B-tree come first
+    int branchPages(std::vector<mdb_size_t> &pages) {
+        if (maxPages == SIZE_MAX) {
+            // Every branch page is locked, so a single walk of each Dbi finds them
+            for (MDB_dbi dbi : dbis) {
+                std::vector<page_ref_t> walked;
+                int rc = walkPages(dbi, 0, walked);
+                if (rc != 0) {
+                    return rc;
+                }
+                for (page_ref_t &page : walked) {
+                    pages.push_back(page.pgno);
+                }
+            }
+            std::sort(pages.begin(), pages.end());
+            pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+            return 0;
+        }
+
+        std::vector<std::vector<page_ref_t>> previous(dbis.size());
+        bool deeper = true;
+        for (unsigned int level = 1; deeper && pages.size() < maxPages; level++) {
+            deeper = false;
+            for (size_t i = 0; i < dbis.size() && pages.size() < maxPages; i++) {
+                std::vector<page_ref_t> walked;
+                int rc = walkPages(dbis[i], MDB_WALK_LEVELS(level), walked);
+                if (rc != 0) {
+                    return rc;
+                }
+                if (walked.size() == previous[i].size()) {
+                    continue;
+                }
+                deeper = true;
+
+                // The pages of this level are those that the walk of the levels above didn't find
+                std::sort(previous[i].begin(), previous[i].end(), byPgno);
+                for (page_ref_t &page : walked) {
+                    if (pages.size() < maxPages && !std::binary_search(previous[i].begin(), previous[i].end(), page, byPgno)) {
+                        pages.push_back(page.pgno);
+                    }
+                }
+                previous[i] = std::move(walked);
+            }
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        return 0;
+    }
+
+    BranchLocker *locker;
+    EnvWrap *ew;
+    MDB_env *env;
+    MDB_txn *txn;
+    std::vector<MDB_dbi> dbis;
+    size_t maxPages;
+    std::vector<mdb_size_t> locked;
+    unsigned int generation;
+};
+
+BranchLocker::BranchLocker(EnvWrap *ew, size_t maxPages) : ew(ew), maxPages(maxPages), running(false), pending(false), closed(false), generation(0) {
+    uv_mutex_init(&closeLock);
+    delay = new uv_timer_t;
+    uv_timer_init(Nan::GetCurrentEventLoop(), delay);
+    delay->data = this;
+    // The delay doesn't keep the process alive
+    uv_unref((uv_handle_t*) delay);
+}
+
+BranchLocker::~BranchLocker() {
+    uv_timer_stop(delay);
+    uv_close((uv_handle_t*) delay, [](uv_handle_t *handle) -> void {
+        delete (uv_timer_t*) handle;
+    });
+    uv_mutex_destroy(&closeLock);
+}
+
+void BranchLocker::addDbi(MDB_dbi dbi) {
+    dbis.push_back(dbi);
+    refresh();
+}
+
+void BranchLocker::removeDbi(MDB_dbi dbi) {
+    auto it = std::find(dbis.begin(), dbis.end(), dbi);
+    if (it != dbis.end()) {
+        dbis.erase(it);
+        refresh();
+    }
+}
+
+void BranchLocker::refresh() {
+    // The commits until the delay is over are covered by the same refresh
+    if (closed || uv_is_active((uv_handle_t*) delay)) {
+        return;
+    }
+    uv_timer_start(delay, [](uv_timer_t *timer) -> void {
+        ((BranchLocker*) timer->data)->start();
+    }, BRANCH_LOCK_DELAY, 0);
+}
+
+void BranchLocker::start() {
+    // Commits that happen during a refresh are covered by one more refresh after it
+    if (running) {
+        pending = true;
+        return;
+    }
+    pending = false;
+    if (closed || !ew->env) {
+        return;
+    }
+
+    BranchLockWorker *worker = new BranchLockWorker(this);
+    running = true;
+    // Keep the environment alive while the refresh is running
+    worker->SaveToPersistent("env", ew->handle());
+    Nan::AsyncQueueWorker(worker);
+}
+
+void BranchLocker::reset() {
+    locked.clear();
+}
+
+void BranchLocker::close() {
+    // Waits for a refresh that is running
+    uv_timer_stop(delay);
+    uv_mutex_lock(&closeLock);
+    closed = true;
+    uv_mutex_unlock(&closeLock);
+    locked.clear();
+}
+
+void BranchLocker::reopen(size_t maxPages) {
+    // The Dbis and locks of the environment that was closed are gone, a refresh of it that is still queued does nothing
+    uv_mutex_lock(&closeLock);
+    closed = false;
+    generation++;
+    uv_mutex_unlock(&closeLock);
+    this->maxPages = maxPages;
+    dbis.clear();
+    locked.clear();
+}
+
+bool BranchLocker::isClosed() {
+    return closed;
+}
+
+bool BranchLocker::isRunning() {
+    return running;
+}
+
+size_t BranchLocker::lockedPages() {
+    return locked.size();
+}
+
+void EnvWrap::committed() {
+    if (branchLocker) {
+        branchLocker->refresh();
+    }
+}
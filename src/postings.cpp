@@ -0,0 +1,434 @@
+
+// This file is part of node-lmdb, the Node.js binding for lmdb
+// Copyright (c) 2013-2017 Timur Kristóf
+// Licensed to you under the terms of the MIT license
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "node-lmdb.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace v8;
+using namespace node;
+
+// The set operations that dbi.intersectDups, dbi.unionDups and dbi.differenceDups run
+#define DUPS_INTERSECTION (0)
+#define DUPS_UNION (1)
+#define DUPS_DIFFERENCE (2)
+
+// Orders of the values of a dupFixed Dbi, so that the default ones are compared inline instead of with mdb_dcmp
+struct Uint32Order {
+    int operator()(const char *a, const char *b) const {
+        uint32_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        return x < y ? -1 : x > y;
+    }
+};
+
+struct Uint64Order {
+    int operator()(const char *a, const char *b) const {
+        uint64_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        return x < y ? -1 : x > y;
+    }
+};
+
+struct BytesOrder {
+    size_t size;
+
+    int operator()(const char *a, const char *b) const {
+        return memcmp(a, b, size);
+    }
+};
+
+struct DbiOrder {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    size_t size;
+
+    int operator()(const char *a, const char *b) const {
+        MDB_val x = { size, (void*) a }, y = { size, (void*) b };
+        return mdb_dcmp(txn, dbi, &x, &y);
+    }
+};
+
+// The sorted values of one key of a dupFixed Dbi, read a page at a time with MDB_GET_MULTIPLE
+class PostingList {
+public:
+    // Number of values under the key
+    mdb_size_t total = 0;
+    // Size of each value
+    size_t size = 0;
+    // Whether the values are used up
+    bool done = true;
+
+    ~PostingList() {
+        if (cursor) {
+            mdb_cursor_close(cursor);
+        }
+    }
+
+    // Opens the values of the given key, which are used up at once if it doesn't exist
+    int open(MDB_txn *txn, MDB_dbi dbi, const MDB_val &k) {
+        int rc = mdb_cursor_open(txn, dbi, &cursor);
+        if (rc != 0) {
+            return rc;
+        }
+
+        key = k;
+        MDB_val data;
+        rc = mdb_cursor_get(cursor, &key, &data, MDB_SET);
+        if (rc == MDB_NOTFOUND) {
+            return 0;
+        }
+        if (rc == 0) {
+            rc = mdb_cursor_count(cursor, &total);
+        }
+        if (rc != 0) {
+            return rc;
+        }
+        size = data.mv_size;
+        return fetch(data, MDB_GET_MULTIPLE);
+    }
+
+    const char *current() const {
+        return values + index * size;
+    }
+
+    // Moves to the next value
+    int next() {
+        if (++index < count) {
+            return 0;
+        }
+        MDB_val data;
+        return fetch(data, MDB_NEXT_MULTIPLE);
+    }
+
+    // Moves to the first value that isn't below the target
+    template<class Order>
+    int seek(const char *target, const Order &order) {
+        if (order(current(), target) >= 0) {
+            return 0;
+        }
+
+        if (order(values + (count - 1) * size, target) < 0) {
+            // Posting lists are often dense, so the next page is tried before searching the B-tree
+            MDB_val data;
+            int rc = fetch(data, MDB_NEXT_MULTIPLE);
+            if (rc != 0 || done) {
+                return rc;
+            }
+
+            if (order(values + (count - 1) * size, target) < 0) {
+                data.mv_size = size;
+                data.mv_data = (void*) target;
+                rc = mdb_cursor_get(cursor, &key, &data, MDB_GET_BOTH_RANGE);
+                if (rc == 0) {
+                    rc = fetch(data, MDB_GET_MULTIPLE);
+                }
+                else if (rc == MDB_NOTFOUND) {
+                    done = true;
+                    rc = 0;
+                }
+                if (rc != 0 || done) {
+                    return rc;
+                }
+            }
+            if (order(current(), target) >= 0) {
+                return 0;
+            }
+        }
+
+        // Gallop from the current value, then search between the last two steps.
+        // The target is on this page, since its last value isn't below it.
+        size_t low = index + 1, high = index + 1, step = 1;
+        while (high < count && order(values + high * size, target) < 0) {
+            low = high + 1;
+            high = index + (step <<= 1);
+        }
+        high = std::min(high, count);
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (order(values + middle * size, target) < 0) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        index = low;
+        return 0;
+    }
+
+private:
+    MDB_cursor *cursor = nullptr;
+    MDB_val key;
+    // Values of the current page
+    const char *values = nullptr;
+    size_t count = 0;
+    size_t index = 0;
+
+    // Reads the page of values where the cursor is, or that the given operation moves to.
+    // MDB_GET_MULTIPLE leaves the data of a key with a single value as it is, so that is passed in.
+    int fetch(MDB_val &data, MDB_cursor_op op) {
+        int rc = mdb_cursor_get(cursor, &key, &data, op);
+        if (rc == MDB_NOTFOUND) {
+            done = true;
+            return 0;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+        values = (const char*) data.mv_data;
+        count = data.mv_size / size;
+        index = 0;
+        done = count == 0;
+        return 0;
+    }
+};
+
+// Runs a set operation over posting lists, and appends up to limit values to the result
+template<class Order>
+static int runDupsOperation(int operation, std::vector<PostingList*> &lists, const Order &order, size_t limit, std::vector<char> &result) {
+    size_t size = 0;
+    for (auto list : lists) {
+        size = std::max(size, list->size);
+    }
+    std::vector<char> value(size);
+    size_t found = 0;
+    int rc = 0;
+
+    if (operation == DUPS_INTERSECTION && lists.size() > 1) {
+        for (auto list : lists) {
+            if (list->done) {
+                return 0;
+            }
+        }
+
+        // Leapfrog: every list in turn moves to the candidate, a list that moves past it brings the next candidate.
+        // Starting from the shortest list skips the most values of the others.
+        std::sort(lists.begin(), lists.end(), [](PostingList *a, PostingList *b) { return a->total < b->total; });
+        memcpy(value.data(), lists[0]->current(), size);
+        size_t matched = 1;
+        for (size_t i = 1; found < limit; i = (i + 1) % lists.size()) {
+            PostingList *list = lists[i];
+            if ((rc = list->seek(value.data(), order)) != 0 || list->done) {
+                break;
+            }
+            if (order(list->current(), value.data()) == 0) {
+                if (++matched < lists.size()) {
+                    continue;
+                }
+                result.insert(result.end(), value.begin(), value.end());
+                found++;
+                if ((rc = list->next()) != 0 || list->done) {
+                    break;
+                }
+            }
+            matched = 1;
+            memcpy(value.data(), list->current(), size);
+        }
+    }
+    else if (operation == DUPS_DIFFERENCE) {
+        PostingList *first = lists[0];
+        while (rc == 0 && !first->done && found < limit) {
+            bool excluded = false;
+            for (size_t i = 1; i < lists.size() && !excluded; i++) {
+                PostingList *list = lists[i];
+                if (!list->done && (rc = list->seek(first->current(), order)) == 0) {
+                    excluded = !list->done && order(list->current(), first->current()) == 0;
+                }
+                if (rc != 0) {
+                    return rc;
+                }
+            }
+            if (!excluded) {
+                result.insert(result.end(), first->current(), first->current() + size);
+                found++;
+            }
+            rc = first->next();
+        }
+    }
+    else {
+        // Merges the lists, which are few, so the smallest current value is found by looking at each of them
+        while (rc == 0 && found < limit) {
+            PostingList *smallest = nullptr;
+            for (auto list : lists) {
+                if (!list->done && (!smallest || order(list->current(), smallest->current()) < 0)) {
+                    smallest = list;
+                }
+            }
+            if (!smallest) {
+                break;
+            }
+            memcpy(value.data(), smallest->current(), size);
+            result.insert(result.end(), value.begin(), value.end());
+            found++;
+            for (auto list : lists) {
+                if (!list->done && order(list->current(), value.data()) == 0 && (rc = list->next()) != 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return rc;
+}
+
+Nan::NAN_METHOD_RETURN_TYPE DbiWrap::dupsCommon(Nan::NAN_METHOD_ARGS_TYPE info, int operation, const char *name) {
+    Nan::HandleScope scope;
+
+    if ((info.Length() != 2 && info.Length() != 3) || !info[1]->IsArray()) {
+        return Nan::ThrowError((std::string("dbi.") + name + " should be called with a txn, an array of keys and optionally an options object.").c_str());
+    }
+
+    DbiWrap *dw = Nan::ObjectWrap::Unwrap<DbiWrap>(info.This());
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(Local<Object>::Cast(info[0]));
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (!dw->isOpen) {
+        return Nan::ThrowError("The Dbi is not open, you can't use it.");
+    }
+
+    unsigned int flags;
+    int rc = mdb_dbi_flags(tw->txn, dw->dbi, &flags);
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+    if ((flags & (MDB_DUPSORT | MDB_DUPFIXED)) != (MDB_DUPSORT | MDB_DUPFIXED)) {
+        return Nan::ThrowError((std::string("dbi.") + name + " can only be used on a Dbi opened with dupSort and dupFixed.").c_str());
+    }
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Array> keys = Local<Array>::Cast(info[1]);
+    Local<Value> options = info.Length() > 2 ? info[2] : Local<Value>(Nan::Undefined());
+    if (keys->Length() == 0) {
+        return Nan::ThrowError("The array of keys should not be empty.");
+    }
+
+    size_t limit = SIZE_MAX;
+    if (options->IsObject()) {
+        Local<Value> limitValue = Local<Object>::Cast(options)->Get(context, Nan::New<String>("limit").ToLocalChecked()).ToLocalChecked();
+        if (!limitValue->IsUndefined()) {
+            if (!limitValue->IsUint32() || limitValue->Uint32Value(context).FromJust() == 0) {
+                return Nan::ThrowError("The limit should be a positive integer.");
+            }
+            limit = limitValue->Uint32Value(context).FromJust();
+        }
+    }
+
+    // Converts the keys first, then opens a cursor on each, so that the MDB_vals of the keys stay valid
+    std::vector<MDB_val> mdbKeys(keys->Length());
+    std::vector<argtokey_callback_t> freeKeys(keys->Length(), nullptr);
+    auto freeAll = [&]() {
+        for (size_t i = 0; i < freeKeys.size(); i++) {
+            if (freeKeys[i]) {
+                freeKeys[i](mdbKeys[i]);
+            }
+        }
+    };
+    for (uint32_t i = 0; i < keys->Length(); i++) {
+        Local<Value> key = keys->Get(context, i).ToLocalChecked();
+        bool keyIsValid;
+        auto keyType = inferAndValidateKeyType(key, options, dw->keyType, keyIsValid);
+        if (keyIsValid) {
+            freeKeys[i] = argToKey(key, mdbKeys[i], keyType, keyIsValid);
+        }
+        if (!keyIsValid) {
+            // inferAndValidateKeyType or argToKey already threw an error
+            return freeAll();
+        }
+    }
+
+    std::vector<PostingList> lists(mdbKeys.size());
+    std::vector<PostingList*> pointers;
+    size_t size = 0;
+    bool mixedSizes = false;
+    for (size_t i = 0; rc == 0 && i < lists.size(); i++) {
+        rc = lists[i].open(tw->txn, dw->dbi, mdbKeys[i]);
+        pointers.push_back(&lists[i]);
+        // dupFixed only fixes the size of the values of each key, the lists and the orders assume a single one
+        if (lists[i].size && size && lists[i].size != size) {
+            mixedSizes = true;
+        }
+        size = std::max(size, lists[i].size);
+    }
+    if (rc == 0 && mixedSizes) {
+        freeAll();
+        return Nan::ThrowError((std::string("dbi.") + name + " can only combine keys whose data items have the same size.").c_str());
+    }
+
+    std::vector<char> result;
+    if (rc == 0) {
+        if (flags & MDB_INTEGERDUP && size == sizeof(uint32_t)) {
+            rc = runDupsOperation(operation, pointers, Uint32Order(), limit, result);
+        }
+        else if (flags & MDB_INTEGERDUP && size == sizeof(uint64_t)) {
+            rc = runDupsOperation(operation, pointers, Uint64Order(), limit, result);
+        }
+        else if (!(flags & (MDB_INTEGERDUP | MDB_REVERSEDUP))) {
+            rc = runDupsOperation(operation, pointers, BytesOrder{ size }, limit, result);
+        }
+        else {
+            rc = runDupsOperation(operation, pointers, DbiOrder{ tw->txn, dw->dbi, size }, limit, result);
+        }
+    }
+
+    freeAll();
+    if (rc != 0) {
+        return throwLmdbError(rc);
+    }
+
+    // Integer values are returned in a typed array of their size, other values one after the other in a Buffer
+    if (flags & MDB_INTEGERDUP) {
+        Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), result.size());
+        Local<TypedArray> array;
+        if (size == sizeof(uint64_t)) {
+            array = BigUint64Array::New(buffer, 0, result.size() / sizeof(uint64_t));
+        }
+        else {
+            array = Uint32Array::New(buffer, 0, result.size() / sizeof(uint32_t));
+        }
+        if (result.size()) {
+            Nan::TypedArrayContents<uint8_t> contents(array);
+            memcpy(*contents, result.data(), result.size());
+        }
+        return info.GetReturnValue().Set(array);
+    }
+    info.GetReturnValue().Set(Nan::CopyBuffer(result.data(), result.size()).ToLocalChecked());
+}
+
+NAN_METHOD(DbiWrap::intersectDups) {
+    return dupsCommon(info, DUPS_INTERSECTION, "intersectDups");
+}
+
+NAN_METHOD(DbiWrap::unionDups) {
+    return dupsCommon(info, DUPS_UNION, "unionDups");
+}
+
+NAN_METHOD(DbiWrap::differenceDups) {
+    return dupsCommon(info, DUPS_DIFFERENCE, "differenceDups");
+}
@@ -0,0 +1,155 @@
+
+// This file is part of node-lmdb, the Node.js binding for lmdb
+// Copyright (c) 2013-2017 Timur Kristóf
+// Licensed to you under the terms of the MIT license
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "node-lmdb.h"
+#include <string>
+
+using namespace v8;
+using namespace node;
+
+// Small ids for the threads in the trace events, which don't need the ids of the OS
+static std::atomic<int> nextThreadId(0);
+static thread_local int threadId = 0;
+
+static int currentThreadId() {
+    if (!threadId) {
+        threadId = ++nextThreadId;
+    }
+    return threadId;
+}
+
+TraceBuffer::TraceBuffer(size_t size) : spans(size), next(0), count(0) {
+    uv_mutex_init(&lock);
+}
+
+TraceBuffer::~TraceBuffer() {
+    uv_mutex_destroy(&lock);
+}
+
+void TraceBuffer::add(const TraceSpan &span) {
+    uv_mutex_lock(&lock);
+    // Overwrites the oldest span when the buffer is full
+    spans[next] = span;
+    next = (next + 1) % spans.size();
+    if (count < spans.size()) {
+        count++;
+    }
+    uv_mutex_unlock(&lock);
+}
+
+Local<Array> TraceBuffer::drain() {
+    uv_mutex_lock(&lock);
+    std::vector<TraceSpan> drained;
+    drained.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        drained.push_back(spans[(next + spans.size() - count + i) % spans.size()]);
+    }
+    count = 0;
+    uv_mutex_unlock(&lock);
+
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Array> events = Nan::New<Array>(drained.size());
+#if UV_VERSION_HEX >= 0x011200
+    double pid = uv_os_getpid();
+#else
+    double pid = 0;
+#endif
+    for (size_t i = 0; i < drained.size(); i++) {
+        const TraceSpan &span = drained[i];
+        std::string name = std::string(span.worker) + " " + span.phase;
+        Local<Object> args = Nan::New<Object>();
+        (void)args->Set(context, Nan::New<String>("triggerAsyncId").ToLocalChecked(), Nan::New<Number>(span.triggerAsyncId));
+        if (span.actions >= 0) {
+            (void)args->Set(context, Nan::New<String>("actions").ToLocalChecked(), Nan::New<Number>(span.actions));
+        }
+        if (span.bytes >= 0) {
+            (void)args->Set(context, Nan::New<String>("bytes").ToLocalChecked(), Nan::New<Number>(span.bytes));
+        }
+
+        // A complete event, with the timestamp and the duration in µs
+        Local<Object> event = Nan::New<Object>();
+        (void)event->Set(context, Nan::New<String>("name").ToLocalChecked(), Nan::New<String>(name).ToLocalChecked());
+        (void)event->Set(context, Nan::New<String>("cat").ToLocalChecked(), Nan::New<String>("node-lmdb").ToLocalChecked());
+        (void)event->Set(context, Nan::New<String>("ph").ToLocalChecked(), Nan::New<String>("X").ToLocalChecked());
+        (void)event->Set(context, Nan::New<String>("ts").ToLocalChecked(), Nan::New<Number>(span.start / 1e3));
+        (void)event->Set(context, Nan::New<String>("dur").ToLocalChecked(), Nan::New<Number>(span.duration / 1e3));
+        (void)event->Set(context, Nan::New<String>("pid").ToLocalChecked(), Nan::New<Number>(pid));
+        (void)event->Set(context, Nan::New<String>("tid").ToLocalChecked(), Nan::New<Number>(span.threadId));
+        (void)event->Set(context, Nan::New<String>("args").ToLocalChecked(), args);
+        (void)events->Set(context, i, event);
+    }
+    return events;
+}
+
+WorkTrace::WorkTrace(TraceBuffer *buffer, const char *worker) : buffer(buffer), worker(worker), triggerAsyncId(-1), start(0) {
+    if (!buffer) {
+        return;
+    }
+#if NODE_MODULE_VERSION >= NODE_8_0_MODULE_VERSION
+    triggerAsyncId = (double) node::AsyncHooksGetExecutionAsyncId(Isolate::GetCurrent());
+#endif
+    queued();
+}
+
+void WorkTrace::queued() {
+    if (buffer) {
+        start = uv_hrtime();
+    }
+}
+
+void WorkTrace::executing() {
+    if (buffer) {
+        add("queueWait", start);
+        start = uv_hrtime();
+    }
+}
+
+void WorkTrace::executed(double actions, double bytes) {
+    if (buffer) {
+        add("execute", start, actions, bytes);
+    }
+}
+
+void WorkTrace::callingBack() {
+    if (buffer) {
+        start = uv_hrtime();
+    }
+}
+
+void WorkTrace::calledBack() {
+    if (buffer) {
+        add("callback", start);
+    }
+}
+
+void WorkTrace::add(const char *phase, uint64_t start, double actions, double bytes) {
+    TraceSpan span;
+    span.worker = worker;
+    span.phase = phase;
+    span.start = start;
+    span.duration = uv_hrtime() - start;
+    span.threadId = currentThreadId();
+    span.triggerAsyncId = triggerAsyncId;
+    span.actions = actions;
+    span.bytes = bytes;
+    buffer->add(span);
+}
@@ -30,6 +30,7 @@ TxnWrap::TxnWrap(MDB_env *env, MDB_txn *txn) {
     this->env = env;
     this->txn = txn;
     this->flags = 0;
+    this->committing = false;
 }
 
 TxnWrap::~TxnWrap() {
@@ -51,9 +52,12 @@ void TxnWrap::removeFromEnvWrap() {
                 ew->readTxns.erase(it);
             }
         }
-        
-        this->ew->Unref();
+
+        EnvWrap *ew = this->ew;
         this->ew = nullptr;
+        // Growing the map may have been waiting for this transaction to end
+        ew->runIdleCallbacks();
+        ew->Unref();
     }
 }
 
@@ -76,8 +80,22 @@ NAN_METHOD(TxnWrap::ctor) {
         return Nan::ThrowError("You have already opened a write transaction in the current process, can't open a second one.");
     }
 
+    MetricTimer timer(ew->envMetrics, Metric::TxnBegin);
+
+    // Rather grow the map now than fail in the middle of the transaction
+    if (0 == (flags & MDB_RDONLY)) {
+        ew->growIfAlmostFull();
+    }
+
     MDB_txn *txn;
     int rc = mdb_txn_begin(ew->env, nullptr, flags, &txn);
+    if (rc == MDB_MAP_RESIZED && ew->growStep && ew->isIdle()) {
+        // Another process has grown the map, adopt its new size
+        rc = ew->setMapSize(0);
+        if (rc == 0) {
+            rc = mdb_txn_begin(ew->env, nullptr, flags, &txn);
+        }
+    }
     if (rc != 0) {
         if (rc == EINVAL) {
             return Nan::ThrowError("Invalid parameter, which on MacOS is often due to more transactions than available robust locked semaphors (see node-lmdb docs for more info)");
@@ -94,6 +112,8 @@ NAN_METHOD(TxnWrap::ctor) {
     // Set the current write transaction
     if (0 == (flags & MDB_RDONLY)) {
         ew->currentWriteTxn = tw;
+        // Pages may be spilled before the commit, so the statistics are collected from the start
+        mdb_txn_commit_stat(txn, &tw->commitStat);
     }
     else {
         ew->readTxns.push_back(tw);
@@ -111,13 +131,165 @@ NAN_METHOD(TxnWrap::commit) {
         return Nan::ThrowError("The transaction is already closed.");
     }
 
-    int rc = mdb_txn_commit(tw->txn);
+    bool stats = false;
+    if (info[0]->IsObject()) {
+        Local<Value> statsOption = Local<Object>::Cast(info[0])->Get(Nan::GetCurrentContext(), Nan::New<String>("stats").ToLocalChecked()).ToLocalChecked();
+        stats = statsOption->IsTrue();
+    }
+    if (stats && (tw->flags & MDB_RDONLY)) {
+        return Nan::ThrowError("Only the commit of a write transaction has stats.");
+    }
+
+    int rc;
+    EnvMetrics *metrics = tw->ew ? tw->ew->envMetrics : nullptr;
+    if (metrics && !(tw->flags & MDB_RDONLY)) {
+        // The same as mdb_txn_commit, in steps that are timed separately
+        MetricTimer timer(metrics, Metric::Commit);
+        {
+            MetricTimer writeTimer(metrics, Metric::CommitWrite);
+            rc = mdb_txn_commit_prepare(tw->txn);
+        }
+        if (rc == 0) {
+            {
+                MetricTimer syncTimer(metrics, Metric::CommitSync);
+                rc = mdb_txn_commit_sync(tw->txn);
+            }
+            rc = mdb_txn_commit_finish(tw->txn, rc);
+        }
+    }
+    else {
+        MetricTimer timer(metrics, Metric::Commit);
+        rc = mdb_txn_commit(tw->txn);
+    }
+    if (rc == MDB_MAP_FULL) {
+        tw->ew->handleMapFull();
+    }
+    if (rc == 0 && !(tw->flags & MDB_RDONLY)) {
+        tw->ew->committed();
+    }
     tw->removeFromEnvWrap();
     tw->txn = nullptr;
 
     if (rc != 0) {
         return throwLmdbError(rc);
     }
+    if (stats) {
+        info.GetReturnValue().Set(commitStatToObject(tw->commitStat));
+    }
+}
+
+// Syncs on a thread of its own rather than in the thread pool: the writer lock is held until the commit is finished,
+// and the batch writes queued in the thread pool meanwhile wait for it there, so they could take all of its threads
+class CommitWorker : public PromiseWorker<Nan::AsyncWorker> {
+  public:
+    CommitWorker(Nan::Callback *callback, TxnWrap *tw, MDB_txn *txn, EnvMetrics *metrics, uint64_t start, TraceBuffer *traceBuffer)
+      : PromiseWorker(callback, "node-lmdb:CommitAsync"), tw(tw), txn(txn), metrics(metrics), start(start),
+      trace(traceBuffer, "node-lmdb:CommitAsync") {}
+
+    void queue() {
+        done = new uv_async_t;
+        uv_async_init(Nan::GetCurrentEventLoop(), done, [](uv_async_t *handle) -> void {
+            CommitWorker *worker = (CommitWorker*) handle->data;
+            uv_thread_join(&worker->thread);
+            uv_close((uv_handle_t*) handle, [](uv_handle_t *handle) -> void {
+                delete (uv_async_t*) handle;
+            });
+            worker->WorkComplete();
+            worker->Destroy();
+        });
+        done->data = this;
+        uv_thread_create(&thread, [](void *arg) -> void {
+            CommitWorker *worker = (CommitWorker*) arg;
+            worker->Execute();
+            uv_async_send(worker->done);
+        }, this);
+    }
+
+    void Execute() {
+        // Syncing is the slow part of the commit, and the only one which doesn't need the writer lock
+        MetricTimer timer(metrics, Metric::CommitSync);
+        trace.executing();
+        rc = mdb_txn_commit_sync(txn);
+        trace.executed();
+    }
+
+    void WorkComplete() {
+        // The writer lock is released here, on the thread which took it
+        rc = mdb_txn_commit_finish(txn, rc);
+        if (metrics) {
+            metrics->record(Metric::Commit, uv_hrtime() - start);
+        }
+        if (rc != 0) {
+            SetErrorMessage(mdb_strerror(rc));
+        }
+        else {
+            tw->ew->committed();
+        }
+        tw->committing = false;
+        tw->removeFromEnvWrap();
+
+        trace.callingBack();
+        Nan::AsyncWorker::WorkComplete();
+        trace.calledBack();
+    }
+
+  private:
+    TxnWrap *tw;
+    MDB_txn *txn;
+    EnvMetrics *metrics;
+    // When the commit began, if the metrics are enabled
+    uint64_t start;
+    WorkTrace trace;
+    int rc = 0;
+    uv_thread_t thread;
+    uv_async_t *done;
+};
+
+NAN_METHOD(TxnWrap::commitAsync) {
+    Nan::HandleScope scope;
+
+    if (info.Length() > 1) {
+        return Nan::ThrowError("You called txn.commitAsync with incorrect arguments. Arguments are: callback (optional).");
+    }
+
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(info.This());
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    if (tw->flags & MDB_RDONLY) {
+        return Nan::ThrowError("Only write transactions can be committed asynchronously.");
+    }
+
+    // Writes the pages, the transaction is aborted if this fails
+    MDB_txn *txn = tw->txn;
+    EnvMetrics *metrics = tw->ew ? tw->ew->envMetrics : nullptr;
+    uint64_t start = metrics ? uv_hrtime() : 0;
+    int rc;
+    {
+        MetricTimer timer(metrics, Metric::CommitWrite);
+        rc = mdb_txn_commit_prepare(txn);
+    }
+    tw->txn = nullptr;
+    if (rc != 0) {
+        if (rc == MDB_MAP_FULL) {
+            tw->ew->handleMapFull();
+        }
+        tw->removeFromEnvWrap();
+        return throwLmdbError(rc);
+    }
+
+    // The transaction stays the current write transaction until the commit is finished,
+    // but it looks closed to JS code meanwhile
+    tw->committing = true;
+
+    Nan::Callback *callback = callbackArgument(info[0]);
+    CommitWorker *worker = new CommitWorker(callback, tw, txn, metrics, start, tw->ew->traceBuffer);
+    worker->SaveToPersistent("txn", info.This());
+    // The Env, and its trace buffer, stay alive until the callback returns
+    worker->SaveToPersistent("env", tw->ew->handle());
+    worker->promiseUnlessCallback(info);
+    worker->queue();
 }
 
 NAN_METHOD(TxnWrap::abort) {
@@ -174,6 +346,7 @@ Nan::NAN_METHOD_RETURN_TYPE TxnWrap::getCommon(Nan::NAN_METHOD_ARGS_TYPE info, L
     if (!tw->txn) {
         return Nan::ThrowError("The transaction is already closed.");
     }
+    MetricTimer timer(tw->ew ? tw->ew->envMetrics : nullptr, Metric::Get);
 
     MDB_val key, oldkey, data;
     bool keyIsValid;
@@ -205,6 +378,7 @@ Nan::NAN_METHOD_RETURN_TYPE TxnWrap::getCommon(Nan::NAN_METHOD_ARGS_TYPE info, L
         return throwLmdbError(rc);
     }
     else {
+      timer.read(data.mv_size);
       return info.GetReturnValue().Set(successFunc(data));
     }
 }
@@ -246,6 +420,7 @@ Nan::NAN_METHOD_RETURN_TYPE TxnWrap::putCommon(Nan::NAN_METHOD_ARGS_TYPE info, v
     if (!tw->txn) {
         return Nan::ThrowError("The transaction is already closed.");
     }
+    MetricTimer timer(tw->ew ? tw->ew->envMetrics : nullptr, Metric::Put);
 
     int flags = 0;
     MDB_val key, data;
@@ -289,7 +464,13 @@ Nan::NAN_METHOD_RETURN_TYPE TxnWrap::putCommon(Nan::NAN_METHOD_ARGS_TYPE info, v
     }
 
     // Check result code
-    if (rc != 0) {
+    if (rc == 0) {
+        timer.written(originalKey.mv_size + originalData.mv_size);
+    }
+    else {
+        if (rc == MDB_MAP_FULL) {
+            tw->ew->handleMapFull();
+        }
         return throwLmdbError(rc);
     }
 }
@@ -363,6 +544,7 @@ NAN_METHOD(TxnWrap::del) {
     if (!tw->txn) {
         return Nan::ThrowError("The transaction is already closed.");
     }
+    MetricTimer timer(tw->ew ? tw->ew->envMetrics : nullptr, Metric::Del);
 
     // Take care of options object and data handle
     Local<Value> options;
@@ -458,6 +640,9 @@ NAN_METHOD(TxnWrap::del) {
     }
 
     if (rc != 0) {
+        if (rc == MDB_MAP_FULL) {
+            tw->ew->handleMapFull();
+        }
         return throwLmdbError(rc);
     }
 }
@@ -309,6 +309,123 @@ describe('Node.js LMDB Bindings', function() {
       });
 //      console.log('sent copy')
     });
+    it('will copy the environment to a stream', function (done) {
+      var fs = require('fs');
+      var streamBackupPath = path.resolve(testDirPath, 'streambackup.mdb');
+      env.copyToStream(fs.createWriteStream(streamBackupPath), { bytesPerSecond: 1024 * 1024 }, function(error) {
+        if (error) {
+          return done(error);
+        }
+        var backupEnv = new lmdb.Env();
+        backupEnv.open({
+          path: streamBackupPath,
+          noSubdir: true,
+          readOnly: true,
+          maxDbs: 10
+        });
+        var dbi = backupEnv.openDbi({
+          name: 'backup'
+        });
+        var txn = backupEnv.beginTxn({ readOnly: true });
+        txn.getString(dbi, 'hello').should.equal('world');
+        txn.abort();
+        dbi.close();
+        backupEnv.close();
+        done();
+      });
+    });
+    it('will reject the promise of a copy to a stream that fails', function () {
+      var Writable = require('stream').Writable;
+      var failing = new Writable({
+        write: function(chunk, encoding, callback) {
+          callback(new Error('disk full'));
+        }
+      });
+      failing.on('error', function() {});
+      return env.copyToStream(failing, { compact: true }).then(function() {
+        should.fail('the copy should have failed');
+      }, function(error) {
+        error.message.should.equal('disk full');
+      });
+    });
+    it('will stop a copy when the stream is destroyed', function () {
+      var Writable = require('stream').Writable;
+      var stalled = new Writable({
+        write: function(chunk, encoding, callback) {
+          // Never calls back, until the stream is destroyed
+          setImmediate(function() {
+            stalled.destroy();
+          });
+        }
+      });
+      return env.copyToStream(stalled).then(function() {
+        should.fail('the copy should have failed');
+      }, function(error) {
+        error.message.should.equal('The stream was closed before the copy was finished.');
+      });
+    });
+    it('will make incremental backups and restore them', function () {
+      var signaturePath = path.resolve(testDirPath, 'incremental.sig');
+      var restorePath = path.resolve(testDirPath, 'restore.mdb');
+      var dbi = env.openDbi({
+        name: 'incremental',
+        create: true
+      });
+      var txn = env.beginTxn();
+      for (var i = 0; i < 1000; i++) {
+        txn.putString(dbi, 'key' + i, expand('value' + i));
+      }
+      txn.commit();
+      var full;
+      return env.copyIncremental(path.resolve(testDirPath, 'backup1.delta'), { signature: signaturePath }).then(function(result) {
+        full = result;
+        result.baseTxnId.should.equal(0);
+        result.changedPages.should.equal(result.pages);
+        var txn = env.beginTxn();
+        txn.putString(dbi, 'key1', 'changed');
+        txn.commit();
+        return env.copyIncremental(path.resolve(testDirPath, 'backup2.delta'), { since: signaturePath, signature: signaturePath });
+      }).then(function(result) {
+        result.baseTxnId.should.equal(full.txnId);
+        result.changedPages.should.be.below(result.pages / 2);
+        return lmdb.applyDelta(restorePath, path.resolve(testDirPath, 'backup1.delta'));
+      }).then(function() {
+        return lmdb.applyDelta(restorePath, path.resolve(testDirPath, 'backup2.delta'));
+      }).then(function(result) {
+        result.txnId.should.be.above(full.txnId);
+        return lmdb.applyDelta(restorePath, path.resolve(testDirPath, 'backup2.delta')).then(function() {
+          should.fail('a delta must be applied onto its base');
+        }, function(error) {
+          error.message.should.contain('doesn\'t apply');
+        });
+      }).then(function() {
+        var restoredEnv = new lmdb.Env();
+        restoredEnv.open({
+          path: restorePath,
+          noSubdir: true,
+          readOnly: true,
+          maxDbs: 10
+        });
+        var restoredDbi = restoredEnv.openDbi({
+          name: 'incremental'
+        });
+        var txn = restoredEnv.beginTxn({ readOnly: true });
+        txn.getString(restoredDbi, 'key1').should.equal('changed');
+        txn.getString(restoredDbi, 'key999').should.equal(expand('value999'));
+        txn.abort();
+        restoredDbi.close();
+        restoredEnv.close();
+        dbi.close();
+      });
+    });
+    it('will reject the promise of a copy that fails', function () {
+      // The backup already exists and a copy never overwrites a file
+      return env.copy(testBackupDirPath).then(function() {
+        should.fail('the copy should have failed');
+      }, function(error) {
+        error.should.be.an('error');
+      });
+    });
   });
   describe('Data types', function() {
     this.timeout(10000);
@@ -459,6 +576,87 @@ describe('Node.js LMDB Bindings', function() {
       }).should.throw('Permission denied');
       readTxn.abort();
     });
+    it('will commit a transaction asynchronously', function(done) {
+      var writeTxn = env.beginTxn();
+      writeTxn.putString(dbi, 3, 'Hello3');
+      writeTxn.commitAsync(function(err) {
+        if (err) {
+          return done(err);
+        }
+        var readTxn = env.beginTxn({readOnly: true});
+        should.equal(readTxn.getString(dbi, 3), 'Hello3');
+        readTxn.abort();
+
+        // Now that the commit is finished, another write transaction can begin
+        var nextTxn = env.beginTxn();
+        nextTxn.del(dbi, 3);
+        nextTxn.commit();
+        done();
+      });
+
+      // The transaction can't be used while it's being committed
+      (function() {
+        writeTxn.putString(dbi, 4, 'Hello4');
+      }).should.throw('The transaction is already closed.');
+      (function() {
+        writeTxn.abort();
+      }).should.throw('The transaction is already closed.');
+      (function() {
+        env.beginTxn();
+      }).should.throw();
+    });
+    it('will return a promise from commitAsync when there is no callback', async function() {
+      var writeTxn = env.beginTxn();
+      writeTxn.putString(dbi, 5, 'Hello5');
+      await writeTxn.commitAsync();
+
+      var txn = env.beginTxn();
+      should.equal(txn.getString(dbi, 5), 'Hello5');
+      txn.del(dbi, 5);
+      txn.commit();
+    });
+    it('will commit asynchronously while batch writes wait for the transaction', async function() {
+      var writeTxn = env.beginTxn();
+      writeTxn.putString(dbi, 7, 'Hello7');
+      // More batches than threads in the pool, they all wait there for the writer lock
+      var batches = [];
+      for (var i = 0; i < 8; i++) {
+        batches.push(env.batchWrite([[dbi, 100 + i, Buffer.from('Batch')]]));
+      }
+      await writeTxn.commitAsync();
+      await Promise.all(batches);
+
+      var txn = env.beginTxn();
+      should.equal(txn.getString(dbi, 7), 'Hello7');
+      txn.del(dbi, 7);
+      for (var i = 0; i < 8; i++) {
+        txn.getBinary(dbi, 100 + i).toString().should.equal('Batch');
+        txn.del(dbi, 100 + i);
+      }
+      txn.commit();
+    });
+    it('will return the stats of a commit', async function() {
+      var writeTxn = env.beginTxn();
+      writeTxn.putString(dbi, 6, 'Hello6');
+      var stats = writeTxn.commit({ stats: true });
+      stats.dirtyPages.should.be.above(0);
+      stats.writtenPages.should.be.at.least(stats.dirtyPages);
+      stats.writes.should.be.above(0);
+      stats.spilledPages.should.equal(0);
+      stats.writeTime.should.be.at.least(0);
+      stats.syncTime.should.be.at.least(0);
+      stats.metaTime.should.be.at.least(0);
+
+      var results = await env.batchWrite([[dbi, 6]], { stats: true });
+      results[0].should.equal(0);
+      results.stats.writtenPages.should.be.above(0);
+
+      var readTxn = env.beginTxn({ readOnly: true });
+      (function() {
+        readTxn.commit({ stats: true });
+      }).should.throw('Only the commit of a write transaction has stats.');
+      readTxn.abort();
+    });
   });
   describe('Cursors, basic operation', function() {
     this.timeout(10000);
@@ -659,6 +857,104 @@ describe('Node.js LMDB Bindings', function() {
       cursor.close();
       txn.abort();
     });
+    it('will renew a cursor with a new read-only transaction', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      var cursor = new lmdb.Cursor(txn, dbi);
+      cursor.goToKey(10).should.equal(10);
+      txn.reset();
+      txn.renew();
+      cursor.renew(txn);
+      cursor.goToKey(20).should.equal(20);
+      txn.abort();
+      var txn2 = env.beginTxn({ readOnly: true });
+      cursor.renew(txn2);
+      cursor.goToLast().should.equal(total - 1);
+      cursor.close();
+      txn2.abort();
+    });
+    it('will reuse closed read-only cursors', function() {
+      for (var i = 0; i < 100; i++) {
+        var txn = env.beginTxn({ readOnly: true });
+        var cursor = new lmdb.Cursor(txn, dbi);
+        cursor.goToKey(i).should.equal(i);
+        cursor.getCurrentBinary().readDoubleBE().should.equal(i);
+        cursor.close();
+        txn.abort();
+      }
+    });
+    it('will put and replace values at the cursor position', function() {
+      var txn = env.beginTxn();
+      var cursor = new lmdb.Cursor(txn, dbi);
+      for (var found = cursor.goToKey(500); found !== null && found < 510; found = cursor.goToNext()) {
+        var buffer = Buffer.alloc(8);
+        buffer.writeDoubleBE(found * 2);
+        cursor.replace(buffer);
+      }
+      cursor.put(total + 1, Buffer.from('hello'));
+      cursor.getCurrentBinary().toString().should.equal('hello');
+      (function() {
+        cursor.put(total + 1, Buffer.from('world'), { noOverwrite: true });
+      }).should.throw();
+      var reserved = cursor.putReserve(total + 2, 5);
+      reserved.length.should.equal(5);
+      reserved.write('world');
+      txn.commit();
+
+      txn = env.beginTxn({ readOnly: true });
+      txn.getBinary(dbi, 505).readDoubleBE().should.equal(1010);
+      txn.getBinary(dbi, 510).readDoubleBE().should.equal(510);
+      txn.getBinary(dbi, total + 1).toString().should.equal('hello');
+      txn.getBinary(dbi, total + 2).toString().should.equal('world');
+      txn.abort();
+
+      txn = env.beginTxn();
+      for (var i = 500; i < 510; i++) {
+        var original = Buffer.alloc(8);
+        original.writeDoubleBE(i);
+        txn.putBinary(dbi, i, original);
+      }
+      txn.del(dbi, total + 1);
+      txn.del(dbi, total + 2);
+      txn.commit();
+    });
+    it('will count the keys of a range', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      dbi.countRange(txn, 100, 300, { exact: true }).should.equal(200);
+      dbi.countRange(txn, null, null, { exact: true }).should.equal(total);
+      dbi.countRange(txn, 990, null).should.equal(10);
+      dbi.countRange(txn, 300, 100).should.equal(0);
+      var estimate = dbi.countRange(txn, 0, 800);
+      estimate.should.be.within(600, 1000);
+      txn.abort();
+    });
+    it('will split the keys into ranges of similar size', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      var points = dbi.splitPoints(txn, 4);
+      points.length.should.equal(3);
+      var previous = 0;
+      points.concat([total]).forEach(function(point) {
+        point.should.be.above(previous);
+        dbi.countRange(txn, previous, point, { exact: true }).should.be.within(total / 4 - 100, total / 4 + 100);
+        previous = point;
+      });
+      var size = dbi.estimateSize(txn, null, null);
+      size.entries.should.equal(total);
+      size.bytes.should.be.above(total * 8);
+      dbi.estimateSize(txn, 0, 500).entries.should.be.within(400, 600);
+      dbi.splitPoints(txn, 1).length.should.equal(0);
+      txn.abort();
+    });
+    it('will not renew a cursor of a write transaction', function() {
+      var txn = env.beginTxn();
+      var cursor = new lmdb.Cursor(txn, dbi);
+      var readTxn = env.beginTxn({ readOnly: true });
+      (function() {
+        cursor.renew(readTxn);
+      }).should.throw('Only cursors of read-only transactions can be renewed.');
+      cursor.close();
+      readTxn.abort();
+      txn.abort();
+    });
   });
   describe('Cursors, dupsort', function() {
     this.timeout(10000);
@@ -740,6 +1036,24 @@ describe('Node.js LMDB Bindings', function() {
 
       done();
     });
+    it('will count duplicates', function () {
+      var txn = env.beginTxn({ readOnly: true });
+      var cursor = new lmdb.Cursor(txn, dbi);
+      var allData = 0;
+      var rangeData = 0;
+      for (var key in dataCount) {
+        cursor.goToKey(key);
+        cursor.countDups().should.equal(dataCount[key]);
+        allData += dataCount[key];
+        if (key >= 'hello_1' && key < 'hello_2') {
+          rangeData += dataCount[key];
+        }
+      }
+      cursor.close();
+      dbi.countRange(txn, null, null, { exact: true }).should.equal(allData);
+      dbi.countRange(txn, 'hello_1', 'hello_2').should.equal(rangeData);
+      txn.abort();
+    });
     after(function () {
       dbi.close();
       env.close();
@@ -1024,6 +1338,86 @@ describe('Node.js LMDB Bindings', function() {
         done();
       });
     });
+    it('will attach a worker to a shared environment', function(done) {
+      var Worker = require('worker_threads').Worker;
+      var env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 10,
+        mapSize: MAX_DB_SIZE
+      });
+      var dbi = env.openDbi({
+        name: 'shared',
+        create: true,
+        keyIsUint32: true
+      });
+      var txn = env.beginTxn();
+      txn.putString(dbi, 1, 'shared value');
+      txn.commit();
+
+      var worker = new Worker([
+        'var workerThreads = require("worker_threads");',
+        'var lmdb = require(' + JSON.stringify(path.resolve(__dirname, '..')) + ');',
+        'var env = new lmdb.Env();',
+        'var dbi = env.attach(workerThreads.workerData)[0];',
+        'var txn = env.beginTxn();',
+        'var value = txn.getString(dbi, 1);',
+        'txn.putString(dbi, 2, "from the worker");',
+        'txn.commit();',
+        'dbi.close();',
+        'env.close();',
+        'workerThreads.parentPort.postMessage(value);'
+      ].join('\n'), { eval: true, workerData: env.share([dbi]) });
+      worker.on('error', done);
+      worker.on('message', function(value) {
+        value.should.equal('shared value');
+        var txn = env.beginTxn({ readOnly: true });
+        txn.getString(dbi, 2).should.equal('from the worker');
+        txn.abort();
+        dbi.close();
+        env.close();
+        done();
+      });
+    });
+    it('will not attach to an environment that is closed', function() {
+      var env = new lmdb.Env();
+      env.open({
+        path: path.resolve(testDirPath, 'unshared.mdb'),
+        noSubdir: true
+      });
+      var handle = env.share();
+      env.close();
+      (function() {
+        new lmdb.Env().attach(handle);
+      }).should.throw('The shared environment isn\'t open in this process anymore.');
+    });
+    it('will only attach the Dbis that were shared', function() {
+      var env = new lmdb.Env();
+      env.open({
+        path: path.resolve(testDirPath, 'partlyshared.mdb'),
+        noSubdir: true,
+        maxDbs: 2
+      });
+      var dbi = env.openDbi({
+        name: 'notshared',
+        create: true
+      });
+      var handle = env.share();
+      handle.dbis.push({ dbi: 2 });
+      var other = new lmdb.Env();
+      (function() {
+        other.attach(handle);
+      }).should.throw('The Dbi isn\'t shared by the environment.');
+      var attached = other.attach(env.share([dbi]))[0];
+      attached.close();
+      // Closing the attached Dbi leaves the handle open for the Env that shared it
+      var txn = env.beginTxn();
+      txn.putString(dbi, 'key', 'value');
+      txn.commit();
+      other.close();
+      dbi.close();
+      env.close();
+    });
   });
   describe('Dupsort', function () {
     this.timeout(10000);
@@ -1286,6 +1680,512 @@ describe('Node.js LMDB Bindings', function() {
         timeoutResult = 'Timeout occurred'
       }, 100);
     });
+    it('will sync in the background when something was committed', function(done) {
+      var syncEnv = new lmdb.Env();
+      syncEnv.open({
+        path: path.resolve(testDirPath, 'backgroundsync.mdb'),
+        noSubdir: true,
+        noSync: true,
+        syncInterval: 20
+      });
+      var syncDbi = syncEnv.openDbi({
+        name: null,
+        create: true
+      });
+      var txn = syncEnv.beginTxn();
+      txn.putString(syncDbi, 'hello', 'world');
+      txn.commit();
+      var lastTxnId = syncEnv.info().lastTxnId;
+
+      setTimeout(function() {
+        var stats = syncEnv.syncStats();
+        stats.syncs.should.be.at.least(1);
+        stats.errors.should.equal(0);
+        stats.lastTxnId.should.equal(lastTxnId);
+        stats.maxTime.should.be.at.least(stats.lastTime);
+        should.equal(env.syncStats(), null);
+        syncDbi.close();
+        syncEnv.close();
+        done();
+      }, 200);
+    });
+    it('will return a promise when there is no callback', function(done) {
+      var timeoutResult
+      env.sync().then(() => {
+        done(timeoutResult)
+      }, done);
+      setTimeout(() => {
+        timeoutResult = 'Timeout occurred'
+      }, 100);
+    });
+  });
+  describe('Metrics', function() {
+    this.timeout(10000);
+    var env;
+    var dbi;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 12,
+        mapSize: MAX_DB_SIZE,
+        metrics: true
+      });
+      dbi = env.openDbi({
+        name: 'metrics',
+        create: true
+      });
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will measure the operations', function() {
+      env.metrics({ reset: true });
+      var txn = env.beginTxn();
+      for (var i = 0; i < 100; i++) {
+        txn.putBinary(dbi, 'key' + i, Buffer.alloc(10));
+      }
+      txn.del(dbi, 'key0');
+      txn.commit();
+      txn = env.beginTxn({ readOnly: true });
+      txn.getBinary(dbi, 'key1').length.should.equal(10);
+      var cursor = new lmdb.Cursor(txn, dbi);
+      cursor.goToFirst();
+      cursor.close();
+      txn.abort();
+
+      var metrics = env.metrics();
+      metrics.put.count.should.equal(100);
+      metrics.del.count.should.equal(1);
+      metrics.get.count.should.equal(1);
+      metrics.cursor.count.should.equal(1);
+      metrics.txnBegin.count.should.equal(2);
+      metrics.commit.count.should.equal(1);
+      metrics.commitWrite.count.should.equal(1);
+      metrics.commitSync.count.should.equal(1);
+      metrics.put.p50.should.be.within(0, metrics.put.maxTime);
+      metrics.put.p999.should.be.within(metrics.put.p50, metrics.put.maxTime);
+      metrics.bytesRead.should.equal(10);
+      metrics.bytesWritten.should.be.above(100 * 10);
+    });
+    it('will measure batches and export them to Prometheus', function() {
+      env.metrics({ reset: true });
+      return env.batchWrite([
+        [dbi, 'batch1', Buffer.from('a')],
+        [dbi, 'batch2', Buffer.from('b')]
+      ]).then(function() {
+        var text = env.metrics({ format: 'prometheus', labels: { db: 'test' } });
+        text.should.contain('# TYPE node_lmdb_operation_duration_seconds histogram');
+        text.should.contain('node_lmdb_operation_duration_seconds_count{db="test",op="batch"} 1\n');
+        text.should.contain('node_lmdb_operation_duration_seconds_count{db="test",op="batchQueueWait"} 1\n');
+        text.should.contain('node_lmdb_operation_duration_seconds_bucket{db="test",op="batch",le="+Inf"} 1\n');
+        text.should.match(/node_lmdb_written_bytes_total\{db="test"\} [1-9]/);
+      });
+    });
+    it('will not measure without the metrics option', function() {
+      var otherEnv = new lmdb.Env();
+      otherEnv.open({
+        path: path.resolve(testDirPath, 'nometrics.mdb'),
+        noSubdir: true
+      });
+      (function() {
+        otherEnv.metrics();
+      }).should.throw('The metrics aren\'t enabled, open the environment with the metrics option.');
+      otherEnv.close();
+    });
+  });
+  describe('Tracing', function() {
+    this.timeout(10000);
+    var env;
+    var dbi;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 12,
+        mapSize: MAX_DB_SIZE,
+        trace: { size: 4 }
+      });
+      dbi = env.openDbi({
+        name: 'tracing',
+        create: true
+      });
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will trace the phases of a batch', async function() {
+      env.traceEvents();
+      await env.batchWrite([
+        [dbi, 'trace1', Buffer.from('a')],
+        [dbi, 'trace2', Buffer.from('bc')]
+      ]);
+      var events = env.traceEvents();
+      events.map(function(event) {
+        return event.name;
+      }).should.deep.equal(['node-lmdb:Batch queueWait', 'node-lmdb:Batch execute', 'node-lmdb:Batch callback']);
+      events.forEach(function(event) {
+        event.cat.should.equal('node-lmdb');
+        event.ph.should.equal('X');
+        event.dur.should.be.at.least(0);
+        event.pid.should.equal(process.pid);
+        event.args.triggerAsyncId.should.be.a('number');
+      });
+      events[1].ts.should.be.at.least(events[0].ts);
+      events[1].args.actions.should.equal(2);
+      // The string keys are UTF-16 with a terminating zero
+      events[1].args.bytes.should.equal(14 + 1 + 14 + 2);
+      // The callback runs on the main thread, and the execution on the thread pool
+      events[2].tid.should.not.equal(events[1].tid);
+      env.traceEvents().length.should.equal(0);
+    });
+    it('will keep the most recent spans', async function() {
+      await env.sync();
+      await env.batchWrite([[dbi, 'trace1']]);
+      var events = env.traceEvents();
+      events.length.should.equal(4);
+      // The 3 spans of the sync and the 3 of the batch don't fit
+      events[0].name.should.equal('node-lmdb:Sync callback');
+      events[3].name.should.equal('node-lmdb:Batch callback');
+    });
+    it('will not trace without the trace option', function() {
+      var otherEnv = new lmdb.Env();
+      otherEnv.open({
+        path: path.resolve(testDirPath, 'notrace.mdb'),
+        noSubdir: true
+      });
+      (function() {
+        otherEnv.traceEvents();
+      }).should.throw('The tracing isn\'t enabled, open the environment with the trace option.');
+      otherEnv.close();
+    });
+  });
+  describe('Page cache', function() {
+    this.timeout(10000);
+    // Waits for the branch pages to be locked in the background
+    async function lockedPagesAfterRefresh(env, expected) {
+      for (var i = 0; i < 100 && env.info().lockedPages !== expected; i++) {
+        await new Promise(function(resolve) {
+          setTimeout(resolve, 10);
+        });
+      }
+      return env.info().lockedPages;
+    }
+    var env;
+    var dbi;
+    var stat;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 12,
+        mapSize: MAX_DB_SIZE
+      });
+      dbi = env.openDbi({
+        name: 'pagecache',
+        create: true
+      });
+      var txn = env.beginTxn();
+      for (var i = 0; i < 20000; i++) {
+        txn.putBinary(dbi, 'key' + i, Buffer.alloc(100, i));
+      }
+      stat = dbi.stat(txn);
+      txn.commit();
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will warm up and report the residency of a dbi', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var warmed = await env.warmup({ dbis: [dbi], leaves: true, parallel: 2 });
+      warmed.branchPages.should.equal(stat.treeBranchPageCount);
+      warmed.leafPages.should.equal(stat.treeLeafPageCount);
+      warmed.bytes.should.equal((stat.treeBranchPageCount + stat.treeLeafPageCount) * stat.pageSize);
+
+      var limited = await env.warmup({ dbis: [dbi], leaves: true, maxBytes: stat.pageSize * 10 });
+      (limited.branchPages + limited.leafPages).should.equal(10);
+
+      var residency = await env.residency({ dbis: [dbi] });
+      residency.residentPages.should.be.within(1, residency.totalPages);
+      residency.dbis[0].branchPages.should.equal(stat.treeBranchPageCount);
+      residency.dbis[0].leafPages.should.equal(stat.treeLeafPageCount);
+      residency.dbis[0].residentLeafPages.should.be.within(0, stat.treeLeafPageCount);
+      residency.dbis[0].ratio.should.be.within(0, 1);
+    });
+    it('will close and drop dbis while the pages are walked', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var closed = env.openDbi({
+        name: 'pagecache-closed',
+        create: true
+      });
+      var dropped = env.openDbi({
+        name: 'pagecache-dropped',
+        create: true
+      });
+      var warming = env.warmup({ dbis: [dbi], leaves: true });
+      var checking = env.residency({ dbis: [dbi] });
+      closed.close();
+      dropped.drop();
+      var warmed = await warming;
+      warmed.branchPages.should.equal(stat.treeBranchPageCount);
+      warmed.leafPages.should.equal(stat.treeLeafPageCount);
+      (await checking).dbis[0].leafPages.should.equal(stat.treeLeafPageCount);
+    });
+    it('will advise the OS on the pages of the map', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      env.advise('random');
+      await env.advise(dbi, 'willneed');
+      await new Promise((resolve, reject) => env.advise(dbi, 'normal', (err) => err ? reject(err) : resolve()));
+      env.advise({ offset: 0, length: 8192 }, 'normal');
+      (function() {
+        env.advise(dbi, 'soon');
+      }).should.throw('Unknown advice');
+    });
+    it('will map the file with the options of the memory map', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var mapEnv = new lmdb.Env();
+      mapEnv.open({
+        path: path.resolve(testDirPath, 'mapping.mdb'),
+        noSubdir: true,
+        maxDbs: 2,
+        mapSize: 64 * 1024 * 1024,
+        mapPopulate: true,
+        hugePages: true,
+        lockBranchPages: true
+      });
+      var mapDbi = mapEnv.openDbi({
+        name: 'mapping',
+        create: true
+      });
+      mapEnv.info().lockedPages.should.equal(0);
+      var txn = mapEnv.beginTxn();
+      for (var i = 0; i < 20000; i++) {
+        txn.putBinary(mapDbi, 'key' + i, Buffer.alloc(100, i));
+      }
+      var mapStat = mapDbi.stat(txn);
+      txn.commit();
+      // The branch pages are locked in the background after the commit
+      (await lockedPagesAfterRefresh(mapEnv, mapStat.treeBranchPageCount)).should.equal(mapStat.treeBranchPageCount);
+      mapDbi.close();
+      (await lockedPagesAfterRefresh(mapEnv, 0)).should.equal(0);
+      mapEnv.close();
+    });
+    it('will lock the top levels of the branch pages within the budget', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var lockEnv = new lmdb.Env();
+      lockEnv.open({
+        path: path.resolve(testDirPath, 'locking.mdb'),
+        noSubdir: true,
+        maxDbs: 2,
+        mapSize: 64 * 1024 * 1024,
+        lockBranchPages: { maxBytes: 65536 }
+      });
+      var lockDbi = lockEnv.openDbi({
+        name: 'locking',
+        create: true
+      });
+      var txn = lockEnv.beginTxn();
+      // Long keys, so that there are more branch pages than the budget
+      for (var i = 0; i < 20000; i++) {
+        txn.putBinary(lockDbi, ('key' + i).padEnd(200, '-'), Buffer.alloc(100, i));
+      }
+      var lockStat = lockDbi.stat(txn);
+      txn.commit();
+      var budget = Math.floor(65536 / lockStat.pageSize);
+      lockStat.treeBranchPageCount.should.be.above(budget);
+      (await lockedPagesAfterRefresh(lockEnv, budget)).should.equal(budget);
+      lockDbi.close();
+      lockEnv.close();
+    });
+    it('will close the environment while the branch pages are being locked', async function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var closeEnv = new lmdb.Env();
+      var options = {
+        path: path.resolve(testDirPath, 'closing.mdb'),
+        noSubdir: true,
+        maxDbs: 2,
+        mapSize: 64 * 1024 * 1024,
+        lockBranchPages: true
+      };
+      closeEnv.open(options);
+      var closeDbi = closeEnv.openDbi({
+        name: 'closing',
+        create: true
+      });
+      var txn = closeEnv.beginTxn();
+      for (var i = 0; i < 20000; i++) {
+        txn.putBinary(closeDbi, 'key' + i, Buffer.alloc(100, i));
+      }
+      var closeStat = closeDbi.stat(txn);
+      txn.commit();
+      // The refresh starts once the delay after the commit is over
+      await new Promise(function(resolve) {
+        setTimeout(resolve, 100);
+      });
+      closeEnv.close();
+
+      // A refresh of the environment that was closed doesn't lock the pages of the one opened again
+      closeEnv.open(options);
+      closeEnv.info().lockedPages.should.equal(0);
+      closeDbi = closeEnv.openDbi({
+        name: 'closing'
+      });
+      (await lockedPagesAfterRefresh(closeEnv, closeStat.treeBranchPageCount)).should.equal(closeStat.treeBranchPageCount);
+      closeDbi.close();
+      closeEnv.close();
+    });
+  });
+  describe('Readers', function() {
+    this.timeout(10000);
+    var env;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 12,
+        mapSize: MAX_DB_SIZE
+      });
+    });
+    after(function() {
+      env.close();
+    });
+    // Runs a process that crashes while it has a read transaction
+    function crashReader(callback) {
+      var script = 'var lmdb = require(' + JSON.stringify(path.resolve(__dirname, '..')) + ');' +
+        'var env = new lmdb.Env();' +
+        'env.open({ path: ' + JSON.stringify(testDirPath) + ', maxDbs: 12, mapSize: ' + MAX_DB_SIZE + ' });' +
+        'env.beginTxn({ readOnly: true });' +
+        'process.kill(process.pid, "SIGKILL");';
+      var child = spawn('node', ['-e', script]);
+      child.stderr.on('data', function(data) {
+        console.error(data.toString());
+      });
+      child.on('close', function() {
+        callback(function(reader) {
+          return reader.pid === child.pid;
+        });
+      });
+    }
+    it('will list the readers', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      var lastTxnId = env.info().lastTxnId;
+      var mine = env.readers().filter(function(reader) {
+        return reader.pid === process.pid && reader.txnId === lastTxnId;
+      });
+      mine.length.should.be.at.least(1);
+      mine[0].thread.should.be.a('string');
+      txn.abort();
+    });
+    it('will clear the readers of a crashed process', function(done) {
+      crashReader(function(isStale) {
+        env.readers().some(isStale).should.equal(true);
+        env.readerCheck().should.be.at.least(1);
+        env.readers().some(isStale).should.equal(false);
+        done();
+      });
+    });
+    it('will clear the readers of a crashed process periodically', function(done) {
+      var checkedEnv = new lmdb.Env();
+      checkedEnv.open({
+        path: testDirPath,
+        maxDbs: 12,
+        mapSize: MAX_DB_SIZE,
+        readerCheckInterval: 50
+      });
+      crashReader(function(isStale) {
+        setTimeout(function() {
+          env.readers().some(isStale).should.equal(false);
+          checkedEnv.close();
+          done();
+        }, 300);
+      });
+    });
+    it('will count the free pages that a reader pins', function() {
+      var dbi = env.openDbi({
+        name: 'freestats',
+        create: true
+      });
+      var txn = env.beginTxn();
+      for (var i = 0; i < 1000; i++) {
+        txn.putString(dbi, 'key' + i, expand('value' + i));
+      }
+      txn.commit();
+      var reader = env.beginTxn({ readOnly: true });
+      txn = env.beginTxn();
+      for (var i = 0; i < 1000; i++) {
+        txn.del(dbi, 'key' + i);
+      }
+      var txnStats = env.freeStats().txn;
+      txnStats.dirtyPages.should.be.above(0);
+      txnStats.spilledRatio.should.be.within(0, 1);
+      txn.commit();
+
+      var stats = env.freeStats();
+      should.equal(stats.txn, null);
+      stats.freePages.should.be.above(0);
+      stats.freePages.should.be.below(stats.totalPages);
+      (stats.reusablePages + stats.pinnedPages).should.equal(stats.freePages);
+      stats.pinnedPages.should.be.above(0);
+      stats.largestRun.should.be.within(1, stats.freePages);
+      stats.runs.should.be.within(1, stats.freePages);
+      reader.abort();
+      env.freeStats().pinnedPages.should.be.below(stats.pinnedPages);
+      dbi.close();
+    });
+    it('will compact the environment while it is open', function() {
+      if (process.platform === 'win32') {
+        return this.skip();
+      }
+      var compactEnv = new lmdb.Env();
+      compactEnv.open({
+        path: path.resolve(testDirPath, 'compact.mdb'),
+        noSubdir: true,
+        maxDbs: 2,
+        mapSize: 64 * 1024 * 1024
+      });
+      var dbi = compactEnv.openDbi({
+        name: 'compact',
+        create: true
+      });
+      var txn = compactEnv.beginTxn();
+      for (var i = 0; i < 5000; i++) {
+        txn.putString(dbi, 'key' + i, expand('value' + i));
+      }
+      txn.commit();
+      txn = compactEnv.beginTxn();
+      for (var i = 100; i < 5000; i++) {
+        txn.del(dbi, 'key' + i);
+      }
+      txn.commit();
+      return compactEnv.compact().then(function(result) {
+        result.pagesAfter.should.be.below(result.pagesBefore);
+        compactEnv.freeStats().totalPages.should.equal(result.pagesAfter);
+        var txn = compactEnv.beginTxn();
+        txn.getString(dbi, 'key99').should.equal(expand('value99'));
+        should.equal(txn.getString(dbi, 'key100'), null);
+        txn.putString(dbi, 'key100', 'after');
+        txn.commit();
+        txn = compactEnv.beginTxn({ readOnly: true });
+        txn.getString(dbi, 'key100').should.equal('after');
+        txn.abort();
+        compactEnv.close();
+      });
+    });
   });
   describe('batch', function() {
     this.timeout(10000);
@@ -1387,5 +2287,269 @@ describe('Node.js LMDB Bindings', function() {
         done();
       });
     });
+    it('will return a promise from batchWrite when there is no callback', async function() {
+      var dbi = env.openDbi({
+        name: 'mydb8',
+        create: true
+      });
+      var results = await env.batchWrite([
+        [ dbi, Buffer.from([10]), Buffer.from([1]) ],
+        [ dbi, Buffer.from([10]), Buffer.from([2]), Buffer.from([9]) ]
+      ], { keyIsBuffer: true });
+      results.should.deep.equal([0, 1]);
+      dbi.close();
+    });
+  });
+  describe('Auto grow', function() {
+    this.timeout(10000);
+    var env;
+    var dbi;
+    var step = 1024 * 1024;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: path.resolve(testDirPath, 'autogrow.mdb'),
+        noSubdir: true,
+        mapSize: 128 * 1024,
+        autoGrow: { step: step, max: 8 * step }
+      });
+      dbi = env.openDbi({
+        name: null,
+        create: true
+      });
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will grow the map when a batch does not fit', function(done) {
+      var value = Buffer.alloc(1000, 7);
+      var data = [];
+      for (var i = 0; i < 2000; i++) {
+        data.push([ dbi, Buffer.from('key' + i), value ]);
+      }
+      env.batchWrite(data, { keyIsBuffer: true }, function(error, results) {
+        if (error) {
+          return done(error);
+        }
+        results.length.should.equal(data.length);
+        env.info().mapSize.should.be.above(128 * 1024);
+        var txn = env.beginTxn({ readOnly: true });
+        txn.getBinary(dbi, Buffer.from('key1999')).equals(value).should.equal(true);
+        txn.abort();
+        done();
+      });
+    });
+    it('will grow the map after a transaction failed, so it can be retried', function() {
+      var value = Buffer.alloc(1000, 8);
+      var mapSize = env.info().mapSize;
+      var written = 0;
+      var txn = env.beginTxn();
+      try {
+        for (; written < 100000; written++) {
+          txn.putBinary(dbi, 'txn' + written, value);
+        }
+        should.fail('the map should have been full');
+      } catch (error) {
+        error.code.should.equal(-30792); // MDB_MAP_FULL
+      }
+      txn.abort();
+      env.info().mapSize.should.be.above(mapSize);
+
+      txn = env.beginTxn();
+      for (var i = 0; i < written; i++) {
+        txn.putBinary(dbi, 'txn' + i, value);
+      }
+      txn.commit();
+    });
+    it('will not grow the map beyond the maximum', function() {
+      var value = Buffer.alloc(1000, 9);
+      function writeChunk(chunk) {
+        var txn = env.beginTxn();
+        try {
+          for (var i = 0; i < 200; i++) {
+            txn.putBinary(dbi, 'max' + chunk + '-' + i, value);
+          }
+        } catch (error) {
+          txn.abort();
+          throw error;
+        }
+        txn.commit();
+      }
+      var error;
+      for (var chunk = 0; chunk < 100 && !error; chunk++) {
+        try {
+          writeChunk(chunk);
+        } catch (firstError) {
+          // The map has grown in the meantime, unless it reached the maximum
+          try {
+            writeChunk(chunk);
+          } catch (secondError) {
+            error = secondError;
+          }
+        }
+      }
+      should.exist(error);
+      error.code.should.equal(-30792); // MDB_MAP_FULL
+      env.info().mapSize.should.be.at.most(8 * step);
+    });
+  });
+  describe('Parallel scan', function() {
+    this.timeout(10000);
+    var env;
+    var dbi;
+    var total = 5000;
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 10,
+        mapSize: MAX_DB_SIZE
+      });
+      dbi = env.openDbi({
+        name: 'parallelscan',
+        create: true,
+        keyIsUint32: true
+      });
+      var txn = env.beginTxn();
+      for (var i = 0; i < total; i++) {
+        txn.putNumber(dbi, i, i);
+      }
+      txn.commit();
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will reduce the whole database on multiple threads', function(done) {
+      dbi.parallelScan({ threads: 4, reduce: ['count', 'sum', 'min', 'max', 'keyRange', 'sizeHistogram'] }, function(err, result) {
+        if (err) {
+          return done(err);
+        }
+        result.count.should.equal(total);
+        result.sum.should.equal(total * (total - 1) / 2);
+        result.min.should.equal(0);
+        result.max.should.equal(total - 1);
+        result.firstKey.should.equal(0);
+        result.lastKey.should.equal(total - 1);
+        // Numbers are stored in 8 bytes
+        result.sizeHistogram[4].should.equal(total);
+        done();
+      });
+    });
+    it('will reduce a key range', function(done) {
+      dbi.parallelScan({ threads: 3, reduce: ['count', 'keyRange'], start: 1000, end: 2000 }, function(err, result) {
+        if (err) {
+          return done(err);
+        }
+        result.count.should.equal(1000);
+        result.firstKey.should.equal(1000);
+        result.lastKey.should.equal(1999);
+        done();
+      });
+    });
+    it('will not close the environment during a scan', function(done) {
+      dbi.parallelScan({}, function(err, result) {
+        result.count.should.equal(total);
+        done(err);
+      });
+      (function() {
+        env.close();
+      }).should.throw('The environment can\'t be closed while a parallel scan or a copy is running.');
+    });
+    it('will return a promise when there is no callback', async function() {
+      var result = await dbi.parallelScan({ reduce: ['count'] });
+      result.count.should.equal(total);
+    });
+  });
+  describe('Posting lists', function() {
+    this.timeout(10000);
+    var env;
+    var dbi;
+    var lists = {
+      // Long enough to span several pages
+      even: [],
+      triple: [],
+      small: [3, 6, 7, 12, 9000, 30000]
+    };
+    before(function() {
+      env = new lmdb.Env();
+      env.open({
+        path: testDirPath,
+        maxDbs: 10,
+        mapSize: MAX_DB_SIZE
+      });
+      dbi = env.openDbi({
+        name: 'postings',
+        create: true,
+        dupSort: true,
+        dupFixed: true,
+        integerDup: true
+      });
+      for (var i = 0; i < 20000; i++) {
+        lists.even.push(i * 2);
+        lists.triple.push(i * 3);
+      }
+      var txn = env.beginTxn();
+      Object.keys(lists).forEach(function(key) {
+        lists[key].forEach(function(value) {
+          txn.putBinary(dbi, key, Buffer.from(new Uint32Array([value]).buffer));
+        });
+      });
+      txn.commit();
+    });
+    after(function() {
+      dbi.close();
+      env.close();
+    });
+    it('will intersect the data items of several keys', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      var result = dbi.intersectDups(txn, ['even', 'triple']);
+      result.should.be.an.instanceof(Uint32Array);
+      result.length.should.equal(6667);
+      result[1].should.equal(6);
+      result[6666].should.equal(39996);
+      Array.from(dbi.intersectDups(txn, ['small', 'triple', 'even'])).should.deep.equal([6, 12, 9000, 30000]);
+      dbi.intersectDups(txn, ['small', 'missing']).length.should.equal(0);
+      txn.abort();
+    });
+    it('will merge and subtract the data items of several keys', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      var union = dbi.unionDups(txn, ['small', 'even']);
+      union.length.should.equal(20002);
+      Array.from(union.subarray(0, 6)).should.deep.equal([0, 2, 3, 4, 6, 7]);
+      Array.from(dbi.differenceDups(txn, ['small', 'even'])).should.deep.equal([3, 7]);
+      Array.from(dbi.differenceDups(txn, ['small', 'triple', 'even'])).should.deep.equal([7]);
+      txn.abort();
+    });
+    it('will stop at the limit', function() {
+      var txn = env.beginTxn({ readOnly: true });
+      Array.from(dbi.unionDups(txn, ['even', 'triple'], { limit: 5 })).should.deep.equal([0, 2, 3, 4, 6]);
+      (function() {
+        dbi.unionDups(txn, ['even'], { limit: 0 });
+      }).should.throw('The limit should be a positive integer.');
+      txn.abort();
+    });
+    it('will not combine data items of different sizes', function() {
+      var txn = env.beginTxn();
+      txn.putBinary(dbi, 'wide', Buffer.from(new BigUint64Array([BigInt(6)]).buffer));
+      (function() {
+        dbi.intersectDups(txn, ['small', 'wide']);
+      }).should.throw('dbi.intersectDups can only combine keys whose data items have the same size.');
+      txn.abort();
+    });
+    it('will only work on a dupFixed Dbi', function() {
+      var other = env.openDbi({
+        name: 'postings2',
+        create: true,
+        dupSort: true
+      });
+      var txn = env.beginTxn({ readOnly: true });
+      (function() {
+        other.intersectDups(txn, ['even']);
+      }).should.throw('dbi.intersectDups can only be used on a Dbi opened with dupSort and dupFixed.');
+      txn.abort();
+      other.close();
+    });
   });
 });